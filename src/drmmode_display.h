@@ -53,12 +53,42 @@ typedef struct {
     Bool hwcursor;
 } drmmode_rec, *drmmode_ptr;
 
+/*
+ * Size of one 64x64 ARGB hardware cursor image, and the number of images
+ * each CRTC keeps resident in video memory under UMS.
+ */
+#define VIA_CURSOR_SIZE         (64 * 64 * 4)
+#define VIA_CURSOR_CACHE_SLOTS  4
+
+typedef struct {
+    uint64_t hash[VIA_CURSOR_CACHE_SLOTS];
+    CARD32 age[VIA_CURSOR_CACHE_SLOTS];
+    Bool valid[VIA_CURSOR_CACHE_SLOTS];
+    CARD32 clock;
+    int slot;
+    Bool hiInitialized;
+    unsigned long hits;
+    unsigned long misses;
+} via_cursor_cache_rec;
+
+/*
+ * Copy of the palette LUT contents last written for a CRTC under UMS,
+ * so that only changed entries need to go through the DAC ports.
+ */
+typedef struct {
+    CARD8 rgb[256][3];
+    Bool valid[256];
+} via_lut_shadow_rec;
+
 typedef struct {
     drmmode_ptr drmmode;
 #ifdef OPENCHROMEDRI
     drmModeCrtcPtr mode_crtc;
 #endif
     struct buffer_object *cursor_bo;
+    unsigned long cursor_offset;    /* This CRTC's slots in cursor_bo. */
+    via_cursor_cache_rec cursor_cache;
+    via_lut_shadow_rec lut_shadow;
     unsigned rotate_fb_id;
     int index;
 } drmmode_crtc_private_rec, *drmmode_crtc_private_ptr;
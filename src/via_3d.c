@@ -85,11 +85,16 @@ static const CARD32 viaFormats[VIA_NUM_3D_FORMATS][5] = {
     {PICT_a8r8g8b8, HC_HDBFM_ARGB8888, HC_HTXnFM_ARGB8888, 1, 1},
     {PICT_x8b8g8r8, HC_HDBFM_ABGR0888, HC_HTXnFM_ABGR0888, 1, 1},
     {PICT_a8b8g8r8, HC_HDBFM_ABGR8888, HC_HTXnFM_ABGR8888, 1, 1},
-    {PICT_a8, 0x00, HC_HTXnFM_A8, 0, 1},
+    {PICT_a8, HC_HDBFM_ARGB8888, HC_HTXnFM_A8, 1, 1},
     {PICT_a4, 0x00, HC_HTXnFM_A4, 0, 1},
     {PICT_a1, 0x00, HC_HTXnFM_A1, 0, 1}
 };
 
+/*
+ * There is no 8 bit render target. A8 destinations are drawn as an
+ * ARGB8888 alias a quarter as wide, one byte lane at a time through the
+ * plane mask, see viaExaCompositeA8.
+ */
 static CARD32
 via3DDstFormat(int format)
 {
@@ -131,6 +136,7 @@ viaSet3DDestination(Via3DState * v3d, CARD32 offset, CARD32 pitch, int format)
     v3d->destPitch = pitch;
     v3d->destFormat = via3DDstFormat(format);
     v3d->destDepth = (v3d->destFormat < HC_HDBFM_ARGB0888) ? 16 : 32;
+    v3d->destA8 = (format == PICT_a8);
 }
 
 static void
@@ -141,6 +147,9 @@ viaSet3DDrawing(Via3DState * v3d, int rop,
     v3d->rop = rop;
     v3d->planeMask = planeMask;
     v3d->solidColor = solidColor;
+    /* Each color lane of an A8 alias holds alpha. */
+    if (v3d->destA8)
+        v3d->solidColor = (solidAlpha & 0xFF) * 0x00010101;
     v3d->solidAlpha = solidAlpha;
 }
 
@@ -167,29 +176,9 @@ viaOrder(CARD32 val, CARD32 * shift)
 }
 
 static Bool
-viaSet3DTexture(Via3DState * v3d, int tex, CARD32 offset,
-                CARD32 pitch, Bool npot, CARD32 width, CARD32 height,
-                int format, ViaTextureModes sMode, ViaTextureModes tMode,
-                ViaTexBlendingModes blendingMode, Bool agpTexture)
+viaSet3DTexBlending(ViaTextureUnit * vTex, int format,
+                    ViaTexBlendingModes blendingMode)
 {
-    ViaTextureUnit *vTex = v3d->tex + tex;
-
-    vTex->textureLevel0Offset = offset;
-    vTex->npot = npot;
-    if (!viaOrder(pitch, &vTex->textureLevel0Exp) && !vTex->npot)
-        return FALSE;
-    vTex->textureLevel0Pitch = pitch;
-    if (!viaOrder(width, &vTex->textureLevel0WExp))
-        return FALSE;
-    if (!viaOrder(height, &vTex->textureLevel0HExp))
-        return FALSE;
-
-    if (pitch <= 4) {
-        ErrorF("Warning: texture pitch <= 4 !\n");
-    }
-
-    vTex->textureFormat = via3DTexFormat(format);
-
     switch (blendingMode) {
         case via_src:
             vTex->texCsat = (0x01 << 23) | (0x10 << 14) | (0x03 << 7) | 0x00;
@@ -220,9 +209,54 @@ viaSet3DTexture(Via3DState * v3d, int tex, CARD32 offset,
             vTex->texCsat = (0x01 << 23) | (0x03 << 14) | (0x04 << 7) | 0x00;
             vTex->texAsat = (0x01 << 23) | (0x04 << 14) | (0x02 << 7) | 0x03;
             break;
+        case via_comp_mask_srcalpha:
+            /* Mask color times the alpha, rather than color, of the src. */
+            vTex->texCsat = (0x01 << 23) | (0x03 << 14) | (0x08 << 7) | 0x00;
+            vTex->texAsat = (0x01 << 23) | (0x04 << 14) | (0x02 << 7) | 0x03;
+            break;
         default:
             return FALSE;
     }
+    return TRUE;
+}
+
+static Bool
+viaSet3DTexture(Via3DState * v3d, int tex, CARD32 offset,
+                CARD32 pitch, Bool npot, CARD32 width, CARD32 height,
+                int format, ViaTextureModes sMode, ViaTextureModes tMode,
+                ViaTexBlendingModes blendingMode, Bool agpTexture)
+{
+    ViaTextureUnit *vTex = v3d->tex + tex;
+
+    vTex->textureLevel0Offset = offset;
+    vTex->npot = npot;
+    if (!viaOrder(pitch, &vTex->textureLevel0Exp) && !vTex->npot)
+        return FALSE;
+    vTex->textureLevel0Pitch = pitch;
+    if (!viaOrder(width, &vTex->textureLevel0WExp))
+        return FALSE;
+    if (!viaOrder(height, &vTex->textureLevel0HExp))
+        return FALSE;
+
+    if (pitch <= 4) {
+        ErrorF("Warning: texture pitch <= 4 !\n");
+    }
+
+    vTex->textureFormat = via3DTexFormat(format);
+    vTex->textureFilter = 0x00;
+    vTex->transform = FALSE;
+    vTex->projective = FALSE;
+
+    if (!viaSet3DTexBlending(vTex, format, blendingMode))
+        return FALSE;
+
+    /*
+     * For A8 destinations, feed the source alpha to the color channels
+     * too, as they are lanes of the same alpha destination.
+     */
+    if (v3d->destA8 &&
+        (blendingMode == via_src || blendingMode == via_src_onepix_mask))
+        vTex->texCsat = (vTex->texCsat & ~(0x7F << 7)) | (0x07 << 7);
 
     vTex->textureDirty = TRUE;
     vTex->textureModesS = sMode - via_single;
@@ -232,6 +266,79 @@ viaSet3DTexture(Via3DState * v3d, int tex, CARD32 offset,
     return TRUE;
 }
 
+/*
+ * Change only the blending equation of an already set up texture unit.
+ * Used to switch between the passes of a component alpha composite.
+ */
+static Bool
+viaSet3DTexBlendMode(Via3DState * v3d, int tex, int format,
+                     ViaTexBlendingModes blendingMode)
+{
+    ViaTextureUnit *vTex = v3d->tex + tex;
+
+    if (!viaSet3DTexBlending(vTex, format, blendingMode))
+        return FALSE;
+
+    /*
+     * For A8 destinations, feed the source alpha to the color channels
+     * too, as they are lanes of the same alpha destination.
+     */
+    if (v3d->destA8 &&
+        (blendingMode == via_src || blendingMode == via_src_onepix_mask))
+        vTex->texCsat = (vTex->texCsat & ~(0x7F << 7)) | (0x07 << 7);
+
+    vTex->textureDirty = TRUE;
+    return TRUE;
+}
+
+/*
+ * Texture coordinate transformation and filtering. Must be called after
+ * setTexture, which resets both to untransformed nearest sampling.
+ */
+static void
+viaSet3DTexSampling(Via3DState * v3d, int tex, PictTransformPtr transform,
+                    Bool bilinear)
+{
+    ViaTextureUnit *vTex = v3d->tex + tex;
+    int i, j;
+
+    vTex->textureFilter = (bilinear) ? (HC_HTXnFLSe_Linear |
+                                        HC_HTXnFLSs_Linear |
+                                        HC_HTXnFLTe_Linear |
+                                        HC_HTXnFLTs_Linear) : 0x00;
+    vTex->transform = (transform != NULL);
+    vTex->projective = FALSE;
+    if (transform) {
+        for (i = 0; i < 3; ++i)
+            for (j = 0; j < 3; ++j)
+                vTex->matrix[i][j] =
+                    pixman_fixed_to_double(transform->matrix[i][j]);
+        vTex->projective = (transform->matrix[2][0] != 0 ||
+                            transform->matrix[2][1] != 0 ||
+                            transform->matrix[2][2] != pixman_fixed_1);
+    }
+    vTex->textureDirty = TRUE;
+}
+
+/*
+ * Set a texture coordinate matrix directly, for textures that are
+ * generated rather than sampled from a picture.
+ */
+static void
+viaSet3DTexMatrix(Via3DState * v3d, int tex, double matrix[3][3])
+{
+    ViaTextureUnit *vTex = v3d->tex + tex;
+    int i, j;
+
+    for (i = 0; i < 3; ++i)
+        for (j = 0; j < 3; ++j)
+            vTex->matrix[i][j] = matrix[i][j];
+    vTex->transform = TRUE;
+    vTex->projective = (matrix[2][0] != 0. || matrix[2][1] != 0. ||
+                        matrix[2][2] != 1.);
+    vTex->textureDirty = TRUE;
+}
+
 static void
 viaSet3DTexBlendCol(Via3DState * v3d, int tex, Bool component, CARD32 color)
 {
@@ -270,6 +377,21 @@ viaSet3DCompositeOperator(Via3DState * v3d, CARD8 op)
     }
 }
 
+/*
+ * Same as above, but for component alpha passes where the texture stage
+ * delivers src alpha times mask color as the source color. Destination
+ * factors that use the source alpha then use the source color instead.
+ */
+static void
+viaSet3DCompositeOperatorCA(Via3DState * v3d, CARD8 op)
+{
+    viaSet3DCompositeOperator(v3d, op);
+
+    if (v3d && (v3d->blendCol1 & HC_HABLFCb_OPC_MASK) == HC_HABLFCb_Asrc)
+        v3d->blendCol1 = ((v3d->blendCol1 & ~HC_HABLFCb_OPC_MASK)
+                          | HC_HABLFCb_Csrc);
+}
+
 static Bool
 via3DOpSupported(CARD8 op)
 {
@@ -281,37 +403,59 @@ via3DEmitQuad(VIAPtr pVia,
                 Via3DState * v3d, ViaCommandBuffer * cb, int dstX, int dstY,
                 int src0X, int src0Y, int src1X, int src1Y, int w, int h)
 {
+    static const int order[6] = { 0, 1, 2, 2, 1, 3 };
     CARD32 acmd;
-    float dx1, dx2, dy1, dy2, sx1[2], sx2[2], sy1[2], sy2[2], wf;
-    double scalex, scaley;
-    int i, numTex;
+    float dx[4], dy[4], wf[4];
+    float sx[4][VIA_NUM_TEXUNITS], sy[4][VIA_NUM_TEXUNITS];
+    double scalex, scaley, x, y, tx, ty, tw;
+    int i, c, v, numTex;
     ViaTextureUnit *vTex;
 
     numTex = v3d->numTextures;
-    dx1 = dstX;
-    dx2 = dstX + w;
-    dy1 = dstY;
-    dy2 = dstY + h;
-
-    if (numTex) {
-        sx1[0] = src0X;
-        sx1[1] = src1X;
-        sy1[0] = src0Y;
-        sy1[1] = src1Y;
-        for (i = 0; i < numTex; ++i) {
-            vTex = v3d->tex + i;
-            scalex = 1. / (double)((1 << vTex->textureLevel0WExp));
-            scaley = 1. / (double)((1 << vTex->textureLevel0HExp));
-            sx2[i] = sx1[i] + w;
-            sy2[i] = sy1[i] + h;
-            sx1[i] *= scalex;
-            sy1[i] *= scaley;
-            sx2[i] *= scalex;
-            sy2[i] *= scaley;
-        }
+
+    /* Corners in the order top-left, top-right, bottom-left, bottom-right. */
+    for (c = 0; c < 4; ++c) {
+        dx[c] = dstX + ((c & 1) ? w : 0);
+        dy[c] = dstY + ((c & 2) ? h : 0);
+        wf[c] = 0.05;
     }
 
-    wf = 0.05;
+    for (i = 0; i < numTex; ++i) {
+        vTex = v3d->tex + i;
+        scalex = 1. / (double)((1 << vTex->textureLevel0WExp));
+        scaley = 1. / (double)((1 << vTex->textureLevel0HExp));
+
+        for (c = 0; c < 4; ++c) {
+            x = ((i) ? src1X : src0X) + ((c & 1) ? w : 0);
+            y = ((i) ? src1Y : src0Y) + ((c & 2) ? h : 0);
+
+            /*
+             * Transformed textures get their coordinates per vertex. For
+             * a projective transform, scale W by the homogeneous
+             * coordinate so that the perspective correct interpolation
+             * divides it back out across the quad.
+             */
+            if (vTex->transform) {
+                tx = vTex->matrix[0][0] * x + vTex->matrix[0][1] * y
+                    + vTex->matrix[0][2];
+                ty = vTex->matrix[1][0] * x + vTex->matrix[1][1] * y
+                    + vTex->matrix[1][2];
+                if (vTex->projective) {
+                    tw = vTex->matrix[2][0] * x + vTex->matrix[2][1] * y
+                        + vTex->matrix[2][2];
+                    if (tw == 0.)
+                        tw = 1.;
+                    tx /= tw;
+                    ty /= tw;
+                    wf[c] *= tw;
+                }
+                x = tx;
+                y = ty;
+            }
+            sx[c][i] = x * scalex;
+            sy[c][i] = y * scaley;
+        }
+    }
 
     /*
      * Vertex buffer. Emit two 3-point triangles. The W or Z coordinate
@@ -329,53 +473,17 @@ via3DEmitQuad(VIAPtr pVia,
     acmd = 2 << 16;
     OUT_RING_SubA(0xEE, acmd);
 
-    OUT_RING(*((CARD32 *) (&dx1)));
-    OUT_RING(*((CARD32 *) (&dy1)));
-    OUT_RING(*((CARD32 *) (&wf)));
-    for (i = 0; i < numTex; ++i) {
-        OUT_RING(*((CARD32 *) (sx1 + i)));
-        OUT_RING(*((CARD32 *) (sy1 + i)));
-    }
-
-    OUT_RING(*((CARD32 *) (&dx2)));
-    OUT_RING(*((CARD32 *) (&dy1)));
-    OUT_RING(*((CARD32 *) (&wf)));
-    for (i = 0; i < numTex; ++i) {
-        OUT_RING(*((CARD32 *) (sx2 + i)));
-        OUT_RING(*((CARD32 *) (sy1 + i)));
-    }
-
-    OUT_RING(*((CARD32 *) (&dx1)));
-    OUT_RING(*((CARD32 *) (&dy2)));
-    OUT_RING(*((CARD32 *) (&wf)));
-    for (i = 0; i < numTex; ++i) {
-        OUT_RING(*((CARD32 *) (sx1 + i)));
-        OUT_RING(*((CARD32 *) (sy2 + i)));
-    }
-
-    OUT_RING(*((CARD32 *) (&dx1)));
-    OUT_RING(*((CARD32 *) (&dy2)));
-    OUT_RING(*((CARD32 *) (&wf)));
-    for (i = 0; i < numTex; ++i) {
-        OUT_RING(*((CARD32 *) (sx1 + i)));
-        OUT_RING(*((CARD32 *) (sy2 + i)));
-    }
-
-    OUT_RING(*((CARD32 *) (&dx2)));
-    OUT_RING(*((CARD32 *) (&dy1)));
-    OUT_RING(*((CARD32 *) (&wf)));
-    for (i = 0; i < numTex; ++i) {
-        OUT_RING(*((CARD32 *) (sx2 + i)));
-        OUT_RING(*((CARD32 *) (sy1 + i)));
+    for (v = 0; v < 6; ++v) {
+        c = order[v];
+        OUT_RING(*((CARD32 *) (dx + c)));
+        OUT_RING(*((CARD32 *) (dy + c)));
+        OUT_RING(*((CARD32 *) (wf + c)));
+        for (i = 0; i < numTex; ++i) {
+            OUT_RING(*((CARD32 *) (&sx[c][i])));
+            OUT_RING(*((CARD32 *) (&sy[c][i])));
+        }
     }
 
-    OUT_RING(*((CARD32 *) (&dx2)));
-    OUT_RING(*((CARD32 *) (&dy2)));
-    OUT_RING(*((CARD32 *) (&wf)));
-    for (i = 0; i < numTex; ++i) {
-        OUT_RING(*((CARD32 *) (sx2 + i)));
-        OUT_RING(*((CARD32 *) (sy2 + i)));
-    }
     OUT_RING_SubA(0xEE,
                   acmd | HC_HPLEND_MASK | HC_HPMValidN_MASK | HC_HE3Fire_MASK);
     OUT_RING_SubA(0xEE,
@@ -500,7 +608,7 @@ via3DEmitState(VIAPtr pVia,
             OUT_RING_SubA(HC_SubA_HTXnL0_5WE, vTex->textureLevel0WExp);
             OUT_RING_SubA(HC_SubA_HTXnL0_5HE, vTex->textureLevel0HExp);
             OUT_RING_SubA(HC_SubA_HTXnL0OS, 0x00);
-            OUT_RING_SubA(HC_SubA_HTXnTB, 0x00);
+            OUT_RING_SubA(HC_SubA_HTXnTB, vTex->textureFilter);
             OUT_RING_SubA(HC_SubA_HTXnMPMD,
                           ((((unsigned)vTex->textureModesT) << 19)
                            | (((unsigned)vTex->textureModesS) << 16)));
@@ -561,8 +669,12 @@ viaInit3DState(Via3DState * v3d)
     v3d->setFlags = viaSet3DFlags;
     v3d->setTexture = viaSet3DTexture;
     v3d->setTexBlendCol = viaSet3DTexBlendCol;
+    v3d->setTexBlendMode = viaSet3DTexBlendMode;
+    v3d->setTexSampling = viaSet3DTexSampling;
+    v3d->setTexMatrix = viaSet3DTexMatrix;
     v3d->opSupported = via3DOpSupported;
     v3d->setCompositeOperator = viaSet3DCompositeOperator;
+    v3d->setCompositeOperatorCA = viaSet3DCompositeOperatorCA;
     v3d->emitQuad = via3DEmitQuad;
     v3d->emitState = via3DEmitState;
     v3d->emitClipRect = via3DEmitClipRect;
@@ -26,6 +26,7 @@
 
 #include "xorg-server.h"
 #include "xf86.h"
+#include "picturestr.h"
 #include "via_dmabuffer.h"
 
 #define VIA_NUM_TEXUNITS 2
@@ -47,7 +48,8 @@ typedef enum
     via_src_onepix_mask,
     via_src_onepix_comp_mask,
     via_mask,
-    via_comp_mask
+    via_comp_mask,
+    via_comp_mask_srcalpha
 } ViaTexBlendingModes;
 
 typedef struct _ViaTextureUnit
@@ -64,10 +66,14 @@ typedef struct _ViaTextureUnit
     CARD32 texRCa;
     CARD32 texAsat;
     CARD32 texRAa;
+    CARD32 textureFilter;
     Bool agpTexture;
     Bool textureDirty;
     Bool texBColDirty;
     Bool npot;
+    Bool transform;
+    Bool projective;
+    double matrix[3][3];
 } ViaTextureUnit;
 
 typedef struct _Via3DState
@@ -84,6 +90,7 @@ typedef struct _Via3DState
     CARD32 destPitch;
     CARD32 destFormat;
     int destDepth;
+    Bool destA8;
     int numTextures;
     Bool blend;
     CARD32 blendCol0;
@@ -106,7 +113,14 @@ typedef struct _Via3DState
         ViaTexBlendingModes blendingMode, Bool agpTexture);
     void (*setTexBlendCol) (struct _Via3DState * v3d, int tex, Bool component,
         CARD32 color);
+        Bool(*setTexBlendMode) (struct _Via3DState * v3d, int tex, int format,
+        ViaTexBlendingModes blendingMode);
+    void (*setTexSampling) (struct _Via3DState * v3d, int tex,
+        PictTransformPtr transform, Bool bilinear);
+    void (*setTexMatrix) (struct _Via3DState * v3d, int tex,
+        double matrix[3][3]);
     void (*setCompositeOperator) (struct _Via3DState * v3d, CARD8 op);
+    void (*setCompositeOperatorCA) (struct _Via3DState * v3d, CARD8 op);
         Bool(*opSupported) (CARD8 op);
     void (*emitQuad) (VIAPtr pVia,
         struct _Via3DState * v3d, ViaCommandBuffer * cb,
@@ -417,7 +417,9 @@ via_analog_get_modes(xf86OutputPtr output)
     }
 
     if (pI2CBus) {
+        viaTraceBegin("xf86OutputGetEDID", output->name);
         pMon = xf86OutputGetEDID(output, pI2CBus);
+        viaTraceEnd();
         if (pMon && (!pMon->features.input_type)) {
             xf86OutputSetEDID(output, pMon);
             pDisplay_Mode = xf86OutputGetEDIDModes(output);
@@ -434,7 +436,9 @@ via_analog_get_modes(xf86OutputPtr output)
     }
 
     if (pI2CBus) {
+        viaTraceBegin("xf86OutputGetEDID", output->name);
         pMon = xf86OutputGetEDID(output, pI2CBus);
+        viaTraceEnd();
         if (pMon && (!pMon->features.input_type)) {
             xf86OutputSetEDID(output, pMon);
             pDisplay_Mode = xf86OutputGetEDIDModes(output);
@@ -0,0 +1,452 @@
+/*
+ * Copyright 2026 The OpenChrome Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Runtime counters.
+ *
+ * The driver counts command submissions, syncs, marker waits, upload and
+ * download traffic, Xv frames, the EXA hooks that declined an
+ * operation and the register cycles the register shadow saved. The
+ * counts are always kept; they cost an add and a test each.
+ *
+ * The first count after a publish arms a one-shot timer, which a second
+ * later publishes them on the root window as the 32-bit INTEGER property
+ * _OPENCHROME_COUNTERS, with the names of the entries in the ATOM
+ * property _OPENCHROME_COUNTER_NAMES. Byte counts are
+ * published in KiB and the wait time in milliseconds, and all entries
+ * wrap at 32 bits, so clients should work with differences. Setting the
+ * root window property _OPENCHROME_COUNTERS_RESET to anything zeroes the
+ * counters, for example
+ *
+ *     xprop -root -f _OPENCHROME_COUNTERS_RESET 32c \
+ *           -set _OPENCHROME_COUNTERS_RESET 1
+ *
+ * Requests like this one are seen through PropertyStateCallback, so an
+ * idle server is never woken up for the counters.
+ *
+ * With Option "CounterLog" the counts also go to the log every so many
+ * seconds while they change.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <X11/Xatom.h>
+#include "property.h"
+#include "propertyst.h"
+
+#include "via_driver.h"
+
+#define VIA_COUNTERS_PERIOD     1000
+
+#define VIA_COUNTERS_NAME       "_OPENCHROME_COUNTERS"
+#define VIA_COUNTERS_NAMES_NAME "_OPENCHROME_COUNTER_NAMES"
+#define VIA_COUNTERS_RESET_NAME "_OPENCHROME_COUNTERS_RESET"
+#define VIA_COMPOSITE_DUMP_NAME "_OPENCHROME_COMPOSITE_DUMP"
+#define VIA_TRACE_DUMP_NAME     "_OPENCHROME_TRACE_DUMP"
+
+static const struct {
+    const char *name;
+    unsigned scale;             /* Divisor for export. */
+} viaCounterInfo[VIA_COUNTER_NUM] = {
+    [VIA_COUNTER_SUBMITS]              = {"submits",            1},
+    [VIA_COUNTER_DWORDS]               = {"dwords",             1},
+    [VIA_COUNTER_SYNCS]                = {"syncs",              1},
+    [VIA_COUNTER_WAITS]                = {"waits",              1},
+    [VIA_COUNTER_WAIT_US]              = {"wait_ms",            1000},
+    [VIA_COUNTER_UPLOAD_BYTES]         = {"upload_kb",          1024},
+    [VIA_COUNTER_DOWNLOAD_BYTES]       = {"download_kb",        1024},
+    [VIA_COUNTER_XV_FRAMES]            = {"xv_frames",          1},
+    [VIA_COUNTER_XV_BYTES]             = {"xv_kb",              1024},
+    [VIA_COUNTER_XV_UNCHANGED]         = {"xv_unchanged",       1},
+    [VIA_COUNTER_FB_CHECK_COMPOSITE]   = {"fallback_check_composite", 1},
+    [VIA_COUNTER_FB_PREPARE_COMPOSITE] = {"fallback_prepare_composite", 1},
+    [VIA_COUNTER_FB_SOLID]             = {"fallback_solid",     1},
+    [VIA_COUNTER_FB_COPY]              = {"fallback_copy",      1},
+    [VIA_COUNTER_FB_UPLOAD]            = {"fallback_upload",    1},
+    [VIA_COUNTER_FB_DOWNLOAD]          = {"fallback_download",  1},
+    [VIA_COUNTER_REG_CYCLES_SAVED]     = {"reg_cycles_saved",   1},
+};
+
+static Atom viaCountersAtom, viaCounterNamesAtom, viaCountersResetAtom;
+static Atom viaCompositeDumpAtom, viaTraceDumpAtom;
+
+static VIAPtr
+viaCountersScreen(ScreenPtr pScreen)
+{
+    return VIAPTR(xf86ScreenToScrn(pScreen));
+}
+
+/*
+ * EXA hook wrappers. A hook that returns FALSE sends the operation to
+ * the software fallback.
+ */
+static Bool
+viaCountCheckComposite(int op, PicturePtr pSrcPicture,
+                       PicturePtr pMaskPicture, PicturePtr pDstPicture)
+{
+    VIAPtr pVia = viaCountersScreen(pDstPicture->pDrawable->pScreen);
+
+    if (pVia->counters.CheckComposite(op, pSrcPicture, pMaskPicture,
+                                      pDstPicture))
+        return TRUE;
+    VIA_COUNT(pVia, VIA_COUNTER_FB_CHECK_COMPOSITE, 1);
+    return FALSE;
+}
+
+static Bool
+viaCountPrepareComposite(int op, PicturePtr pSrcPicture,
+                         PicturePtr pMaskPicture, PicturePtr pDstPicture,
+                         PixmapPtr pSrc, PixmapPtr pMask, PixmapPtr pDst)
+{
+    VIAPtr pVia = viaCountersScreen(pDst->drawable.pScreen);
+
+    if (pVia->counters.PrepareComposite(op, pSrcPicture, pMaskPicture,
+                                        pDstPicture, pSrc, pMask, pDst))
+        return TRUE;
+    VIA_COUNT(pVia, VIA_COUNTER_FB_PREPARE_COMPOSITE, 1);
+    viaExaCompositeReject(pVia, VIA_REJECT_PREPARE, op, pSrcPicture,
+                          pMaskPicture, pDstPicture);
+    return FALSE;
+}
+
+static Bool
+viaCountPrepareSolid(PixmapPtr pPixmap, int alu, Pixel planeMask, Pixel fg)
+{
+    VIAPtr pVia = viaCountersScreen(pPixmap->drawable.pScreen);
+
+    if (pVia->counters.PrepareSolid(pPixmap, alu, planeMask, fg))
+        return TRUE;
+    VIA_COUNT(pVia, VIA_COUNTER_FB_SOLID, 1);
+    return FALSE;
+}
+
+static Bool
+viaCountPrepareCopy(PixmapPtr pSrcPixmap, PixmapPtr pDstPixmap,
+                    int xdir, int ydir, int alu, Pixel planeMask)
+{
+    VIAPtr pVia = viaCountersScreen(pDstPixmap->drawable.pScreen);
+
+    if (pVia->counters.PrepareCopy(pSrcPixmap, pDstPixmap, xdir, ydir,
+                                   alu, planeMask))
+        return TRUE;
+    VIA_COUNT(pVia, VIA_COUNTER_FB_COPY, 1);
+    return FALSE;
+}
+
+static Bool
+viaCountUploadToScreen(PixmapPtr pDst, int x, int y, int w, int h,
+                       char *src, int src_pitch)
+{
+    VIAPtr pVia = viaCountersScreen(pDst->drawable.pScreen);
+
+    if (pVia->counters.UploadToScreen(pDst, x, y, w, h, src, src_pitch)) {
+        VIA_COUNT(pVia, VIA_COUNTER_UPLOAD_BYTES,
+                  ((CARD64) w * pDst->drawable.bitsPerPixel >> 3) * h);
+        return TRUE;
+    }
+    VIA_COUNT(pVia, VIA_COUNTER_FB_UPLOAD, 1);
+    return FALSE;
+}
+
+static Bool
+viaCountDownloadFromScreen(PixmapPtr pSrc, int x, int y, int w, int h,
+                           char *dst, int dst_pitch)
+{
+    VIAPtr pVia = viaCountersScreen(pSrc->drawable.pScreen);
+
+    if (pVia->counters.DownloadFromScreen(pSrc, x, y, w, h, dst,
+                                          dst_pitch)) {
+        VIA_COUNT(pVia, VIA_COUNTER_DOWNLOAD_BYTES,
+                  ((CARD64) w * pSrc->drawable.bitsPerPixel >> 3) * h);
+        return TRUE;
+    }
+    VIA_COUNT(pVia, VIA_COUNTER_FB_DOWNLOAD, 1);
+    return FALSE;
+}
+
+/*
+ * Count the fallbacks of the hooks viaInitExa installed. Called right
+ * before exaDriverInit.
+ */
+void
+viaCountersWrapExa(VIAPtr pVia, ExaDriverPtr pExa)
+{
+    ViaCounters *c = &pVia->counters;
+
+#define VIA_WRAP_EXA(hook)                     \
+    do {                                       \
+        c->hook = pExa->hook;                  \
+        if (c->hook)                           \
+            pExa->hook = viaCount##hook;       \
+    } while (0)
+
+    VIA_WRAP_EXA(CheckComposite);
+    VIA_WRAP_EXA(PrepareComposite);
+    VIA_WRAP_EXA(PrepareSolid);
+    VIA_WRAP_EXA(PrepareCopy);
+    VIA_WRAP_EXA(UploadToScreen);
+    VIA_WRAP_EXA(DownloadFromScreen);
+
+#undef VIA_WRAP_EXA
+}
+
+void
+viaCountersReset(VIAPtr pVia)
+{
+    memset(pVia->counters.val, 0, sizeof(pVia->counters.val));
+    pVia->counters.valid = FALSE;
+}
+
+static void
+viaCountersLog(ScrnInfoPtr pScrn, int verb)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    CARD64 *val = pVia->counters.val;
+
+    xf86DrvMsgVerb(pScrn->scrnIndex, X_INFO, verb,
+                   "Counters: %llu submits, %llu dwords, %llu syncs, "
+                   "%llu waits (%llu ms), %llu KiB up, %llu KiB down, "
+                   "%llu Xv frames (%llu KiB, %llu unchanged).\n",
+                   (unsigned long long) val[VIA_COUNTER_SUBMITS],
+                   (unsigned long long) val[VIA_COUNTER_DWORDS],
+                   (unsigned long long) val[VIA_COUNTER_SYNCS],
+                   (unsigned long long) val[VIA_COUNTER_WAITS],
+                   (unsigned long long) val[VIA_COUNTER_WAIT_US] / 1000,
+                   (unsigned long long) val[VIA_COUNTER_UPLOAD_BYTES] >> 10,
+                   (unsigned long long) val[VIA_COUNTER_DOWNLOAD_BYTES] >> 10,
+                   (unsigned long long) val[VIA_COUNTER_XV_FRAMES],
+                   (unsigned long long) val[VIA_COUNTER_XV_BYTES] >> 10,
+                   (unsigned long long) val[VIA_COUNTER_XV_UNCHANGED]);
+    xf86DrvMsgVerb(pScrn->scrnIndex, X_INFO, verb,
+                   "Counters: fallbacks %llu check composite, "
+                   "%llu prepare composite, %llu solid, %llu copy, "
+                   "%llu upload, %llu download.\n",
+                   (unsigned long long) val[VIA_COUNTER_FB_CHECK_COMPOSITE],
+                   (unsigned long long) val[VIA_COUNTER_FB_PREPARE_COMPOSITE],
+                   (unsigned long long) val[VIA_COUNTER_FB_SOLID],
+                   (unsigned long long) val[VIA_COUNTER_FB_COPY],
+                   (unsigned long long) val[VIA_COUNTER_FB_UPLOAD],
+                   (unsigned long long) val[VIA_COUNTER_FB_DOWNLOAD]);
+}
+
+static void
+viaCountersPublishNames(WindowPtr pRoot)
+{
+    Atom names[VIA_COUNTER_NUM];
+    int i;
+
+    for (i = 0; i < VIA_COUNTER_NUM; i++)
+        names[i] = MakeAtom(viaCounterInfo[i].name,
+                            strlen(viaCounterInfo[i].name), TRUE);
+
+    dixChangeWindowProperty(serverClient, pRoot, viaCounterNamesAtom,
+                            XA_ATOM, 32, PropModeReplace, VIA_COUNTER_NUM,
+                            names, FALSE);
+}
+
+/*
+ * Rewrite the property only when a published value moved, so that
+ * clients waiting for PropertyNotify are not woken on an idle server.
+ */
+static void
+viaCountersPublish(VIAPtr pVia, WindowPtr pRoot)
+{
+    ViaCounters *c = &pVia->counters;
+    CARD32 exported[VIA_COUNTER_NUM];
+    int i;
+
+    for (i = 0; i < VIA_COUNTER_NUM; i++)
+        exported[i] = (CARD32) (c->val[i] / viaCounterInfo[i].scale);
+
+    if (c->valid && !memcmp(exported, c->exported, sizeof(exported)))
+        return;
+
+    if (dixChangeWindowProperty(serverClient, pRoot, viaCountersAtom,
+                                XA_INTEGER, 32, PropModeReplace,
+                                VIA_COUNTER_NUM, exported, TRUE) == Success) {
+        memcpy(c->exported, exported, sizeof(exported));
+        c->valid = TRUE;
+    }
+}
+
+/*
+ * Clients ask for something by setting a root window property, which is
+ * consumed here.
+ */
+static Bool
+viaCountersRequested(WindowPtr pRoot, Atom atom)
+{
+    PropertyPtr pProp;
+
+    if (dixLookupProperty(&pProp, pRoot, atom, serverClient,
+                          DixReadAccess) != Success)
+        return FALSE;
+
+    DeleteProperty(serverClient, pRoot, atom);
+    return TRUE;
+}
+
+static CARD32
+viaCountersTimer(OsTimerPtr timer, CARD32 now, pointer arg)
+{
+    ScrnInfoPtr pScrn = arg;
+    VIAPtr pVia = VIAPTR(pScrn);
+    ViaCounters *c = &pVia->counters;
+    WindowPtr pRoot = pScrn->pScreen->root;
+
+    if (!pRoot)
+        return VIA_COUNTERS_PERIOD;
+
+    /* The root window did not exist at ScreenInit time. */
+    if (!c->named) {
+        viaCountersPublishNames(pRoot);
+        c->named = TRUE;
+    }
+
+    if (pScrn->vtSema)
+        viaCountersPublish(pVia, pRoot);
+
+    if (c->logInterval > 0 &&
+        (CARD32) (now - c->lastLog) >= (CARD32) c->logInterval * 1000) {
+        viaCountersLog(pScrn, 1);
+        c->lastLog = now;
+    }
+
+    /* The next count arms the timer again. */
+    c->armed = FALSE;
+    return 0;
+}
+
+void
+viaCountersArm(VIAPtr pVia)
+{
+    ViaCounters *c = &pVia->counters;
+
+    /* Nothing is published before ScreenInit, which resets the counts. */
+    if (!c->pScrn)
+        return;
+
+    c->timer = TimerSet(c->timer, 0, VIA_COUNTERS_PERIOD,
+                        viaCountersTimer, c->pScrn);
+    c->armed = TRUE;
+}
+
+static Bool
+viaCountersWork(ClientPtr client, pointer closure)
+{
+    ScrnInfoPtr pScrn = closure;
+    VIAPtr pVia = VIAPTR(pScrn);
+    WindowPtr pRoot = pScrn->pScreen->root;
+
+    if (!pRoot)
+        return TRUE;
+
+    if (viaCountersRequested(pRoot, viaCountersResetAtom)) {
+        viaCountersReset(pVia);
+        viaCountersArm(pVia);
+        xf86DrvMsgVerb(pScrn->scrnIndex, X_INFO, 3,
+                       "Counters reset by client request.\n");
+    }
+
+    if (viaCountersRequested(pRoot, viaCompositeDumpAtom))
+        viaExaRejectDump(pScrn, 1);
+
+    if (viaCountersRequested(pRoot, viaTraceDumpAtom))
+        viaTraceWrite(pScrn);
+
+    return TRUE;
+}
+
+/*
+ * A client set a property on our root window. The request is consumed
+ * from a work procedure, because the property must not be deleted while
+ * its PropertyNotify is being delivered.
+ */
+static void
+viaCountersPropertyState(CallbackListPtr *list, pointer closure,
+                         pointer data)
+{
+    ScrnInfoPtr pScrn = closure;
+    PropertyStateRec *rec = data;
+    Atom atom = rec->prop->propertyName;
+
+    if (rec->state != PropertyNewValue || rec->win != pScrn->pScreen->root)
+        return;
+
+    if (atom == viaCountersResetAtom || atom == viaCompositeDumpAtom ||
+        atom == viaTraceDumpAtom)
+        QueueWorkProc(viaCountersWork, NULL, pScrn);
+}
+
+/*
+ * Start publishing. Called at the end of ScreenInit.
+ */
+void
+viaCountersInit(ScreenPtr pScreen)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    VIAPtr pVia = VIAPTR(pScrn);
+    ViaCounters *c = &pVia->counters;
+
+    viaCountersReset(pVia);
+    c->named = FALSE;
+    c->pScrn = pScrn;
+    c->lastLog = GetTimeInMillis();
+
+    viaCountersAtom = MakeAtom(VIA_COUNTERS_NAME,
+                               strlen(VIA_COUNTERS_NAME), TRUE);
+    viaCounterNamesAtom = MakeAtom(VIA_COUNTERS_NAMES_NAME,
+                                   strlen(VIA_COUNTERS_NAMES_NAME), TRUE);
+    viaCountersResetAtom = MakeAtom(VIA_COUNTERS_RESET_NAME,
+                                    strlen(VIA_COUNTERS_RESET_NAME), TRUE);
+    viaCompositeDumpAtom = MakeAtom(VIA_COMPOSITE_DUMP_NAME,
+                                    strlen(VIA_COMPOSITE_DUMP_NAME), TRUE);
+    viaTraceDumpAtom = MakeAtom(VIA_TRACE_DUMP_NAME,
+                                strlen(VIA_TRACE_DUMP_NAME), TRUE);
+
+    AddCallback(&PropertyStateCallback, viaCountersPropertyState, pScrn);
+
+    /* Publish the names once the root window exists. */
+    viaCountersArm(pVia);
+}
+
+void
+viaCountersFini(ScrnInfoPtr pScrn)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    ViaCounters *c = &pVia->counters;
+
+    if (!c->pScrn)
+        return;
+
+    DeleteCallback(&PropertyStateCallback, viaCountersPropertyState, pScrn);
+    if (c->timer) {
+        TimerFree(c->timer);
+        c->timer = NULL;
+    }
+    c->armed = FALSE;
+    c->pScrn = NULL;
+    viaCountersLog(pScrn, 3);
+}
@@ -206,6 +206,17 @@ viaIGA1InitHI(ScrnInfoPtr pScrn)
     }
 }
 
+/*
+ * Returns the frame buffer offset of the cursor image currently selected
+ * from the CRTC's cursor cache.
+ */
+static CARD32
+viaCursorSlotOffset(drmmode_crtc_private_ptr iga)
+{
+    return iga->cursor_bo->offset + iga->cursor_offset +
+            iga->cursor_cache.slot * VIA_CURSOR_SIZE;
+}
+
 static void
 viaIGA1SetHIStartingAddress(xf86CrtcPtr crtc)
 {
@@ -221,11 +232,11 @@ viaIGA1SetHIStartingAddress(xf86CrtcPtr crtc)
     case VIA_VX800:
     case VIA_VX855:
     case VIA_VX900:
-        VIASETREG(PRIM_HI_FBOFFSET, iga->cursor_bo->offset);
+        VIASETREG(PRIM_HI_FBOFFSET, viaCursorSlotOffset(iga));
         break;
     default:
         /* Mono Cursor Display Path [bit31]: Primary */
-        VIASETREG(HI_FBOFFSET, iga->cursor_bo->offset);
+        VIASETREG(HI_FBOFFSET, viaCursorSlotOffset(iga));
         break;
     }
 }
@@ -394,7 +405,7 @@ viaIGA2SetHIStartingAddress(xf86CrtcPtr crtc)
     ScrnInfoPtr pScrn = crtc->scrn;
     VIAPtr pVia = VIAPTR(pScrn);
 
-    VIASETREG(HI_FBOFFSET, iga->cursor_bo->offset);
+    VIASETREG(HI_FBOFFSET, viaCursorSlotOffset(iga));
 }
 
 /*
@@ -455,16 +466,22 @@ viaIGA2SetHIDisplayLocation(ScrnInfoPtr pScrn,
     }
 }
 
-static void
-VIALoadRgbLut(ScrnInfoPtr pScrn, int start, int numColors, LOCO *colors)
+/*
+ * Works out the palette LUT contents that loading the given colors
+ * produces, and marks the entries that differ from what the CRTC's LUT
+ * shadow says the hardware already holds. Returns the number of such
+ * entries.
+ */
+static int
+viaLUTDiff(ScrnInfoPtr pScrn, drmmode_crtc_private_ptr iga,
+            int start, int numColors, LOCO *colors,
+            CARD8 lut[256][3], Bool dirty[256])
 {
-    vgaHWPtr hwp = VGAHWPTR(pScrn);
-    int i, j;
+    via_lut_shadow_rec *shadow = &iga->lut_shadow;
+    Bool touched[256];
+    int i, j, entry, count = 0;
 
-    DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO, "VIALoadRgbLut\n"));
-
-    hwp->enablePalette(hwp);
-    hwp->writeDacMask(hwp, 0xFF);
+    memset(touched, 0, sizeof(touched));
 
     /* We need the same palette contents for both 16 and 24 bits, but X doesn't
      * play: X's colormap handling is hopelessly intertwined with almost every
@@ -473,11 +490,12 @@ VIALoadRgbLut(ScrnInfoPtr pScrn, int start, int numColors, LOCO *colors)
     switch (pScrn->bitsPerPixel) {
         case 15:
             for (i = start; i < numColors; i++) {
-                hwp->writeDacWriteAddr(hwp, i * 4);
                 for (j = 0; j < 4; j++) {
-                    hwp->writeDacData(hwp, colors[i / 2].red);
-                    hwp->writeDacData(hwp, colors[i].green);
-                    hwp->writeDacData(hwp, colors[i / 2].blue);
+                    entry = (i * 4 + j) & 0xFF;
+                    lut[entry][0] = colors[i / 2].red;
+                    lut[entry][1] = colors[i].green;
+                    lut[entry][2] = colors[i / 2].blue;
+                    touched[entry] = TRUE;
                 }
             }
             break;
@@ -485,10 +503,11 @@ VIALoadRgbLut(ScrnInfoPtr pScrn, int start, int numColors, LOCO *colors)
         case 16:
         case 32:
             for (i = start; i < numColors; i++) {
-                hwp->writeDacWriteAddr(hwp, i);
-                hwp->writeDacData(hwp, colors[i].red);
-                hwp->writeDacData(hwp, colors[i].green);
-                hwp->writeDacData(hwp, colors[i].blue);
+                entry = i & 0xFF;
+                lut[entry][0] = colors[i].red;
+                lut[entry][1] = colors[i].green;
+                lut[entry][2] = colors[i].blue;
+                touched[entry] = TRUE;
             }
             break;
         default:
@@ -496,9 +515,67 @@ VIALoadRgbLut(ScrnInfoPtr pScrn, int start, int numColors, LOCO *colors)
                        "Unsupported bitdepth: %d\n", pScrn->bitsPerPixel);
             break;
     }
+
+    for (i = 0; i < 256; i++) {
+        dirty[i] = touched[i] &&
+                    ((!shadow->valid[i]) ||
+                     memcmp(shadow->rgb[i], lut[i], 3));
+        if (dirty[i])
+            count++;
+    }
+
+    return count;
+}
+
+/*
+ * Uploads the dirty palette LUT entries, using one DAC auto-increment run
+ * per contiguous range of changed entries.
+ */
+static void
+VIALoadRgbLut(ScrnInfoPtr pScrn, drmmode_crtc_private_ptr iga,
+                CARD8 lut[256][3], Bool dirty[256])
+{
+    vgaHWPtr hwp = VGAHWPTR(pScrn);
+    via_lut_shadow_rec *shadow = &iga->lut_shadow;
+    int i;
+
+    DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO, "VIALoadRgbLut\n"));
+
+    hwp->enablePalette(hwp);
+    hwp->writeDacMask(hwp, 0xFF);
+
+    for (i = 0; i < 256; i++) {
+        if (!dirty[i])
+            continue;
+
+        /* Start a new run; the DAC index auto-increments within it. */
+        if ((i == 0) || (!dirty[i - 1]))
+            hwp->writeDacWriteAddr(hwp, i);
+
+        hwp->writeDacData(hwp, lut[i][0]);
+        hwp->writeDacData(hwp, lut[i][1]);
+        hwp->writeDacData(hwp, lut[i][2]);
+
+        memcpy(shadow->rgb[i], lut[i], 3);
+        shadow->valid[i] = TRUE;
+    }
+
     hwp->disablePalette(hwp);
 }
 
+/*
+ * Forgets the palette LUT shadow, forcing the next load to write every
+ * entry it covers. Needed whenever something else may have loaded the
+ * palette, e.g. the console after a VT switch.
+ */
+void
+viaLUTShadowReset(xf86CrtcPtr crtc)
+{
+    drmmode_crtc_private_ptr iga = crtc->driver_private;
+
+    memset(iga->lut_shadow.valid, 0, sizeof(iga->lut_shadow.valid));
+}
+
 void
 ViaGammaDisable(ScrnInfoPtr pScrn)
 {
@@ -3140,12 +3217,16 @@ via_crtc_save(xf86CrtcPtr crtc)
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                         "Entered %s.\n", __func__));
 
+    viaTraceBegin("via_crtc_save", iga->index ? "IGA2" : "IGA1");
+
     if (!iga->index) {
         viaIGA1Save(pScrn);
     } else {
         viaIGA2Save(pScrn);
     }
 
+    viaTraceEnd();
+
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                         "Exiting %s.\n", __func__));
 }
@@ -3159,12 +3240,16 @@ via_crtc_restore(xf86CrtcPtr crtc)
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                         "Entered %s.\n", __func__));
 
+    viaTraceBegin("via_crtc_restore", iga->index ? "IGA2" : "IGA1");
+
     if (!iga->index) {
         viaIGA1Restore(pScrn);
     } else {
         viaIGA2Restore(pScrn);
     }
 
+    viaTraceEnd();
+
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                         "Exiting %s.\n", __func__));
 }
@@ -3290,6 +3375,8 @@ via_crtc_mode_set(xf86CrtcPtr crtc,
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                         "Entered %s.\n", __func__));
 
+    viaTraceBegin("via_crtc_mode_set", iga->index ? "IGA2" : "IGA1");
+
     if (!iga->index) {
         /* Put IGA1 into a reset state. */
         viaIGA1HWReset(pScrn, TRUE);
@@ -3351,6 +3438,8 @@ via_crtc_mode_set(xf86CrtcPtr crtc,
         viaIGA2HWReset(pScrn, FALSE);
     }
 
+    viaTraceEnd();
+
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                         "Exiting %s.\n", __func__));
 }
@@ -3383,6 +3472,8 @@ via_crtc_gamma_set(xf86CrtcPtr crtc, CARD16 *red, CARD16 *green, CARD16 *blue,
     ScrnInfoPtr pScrn = crtc->scrn;
     drmmode_crtc_private_ptr iga = crtc->driver_private;
     LOCO colors[size];
+    CARD8 lut[256][3];
+    Bool dirty[256];
     int i;
 
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
@@ -3394,27 +3485,38 @@ via_crtc_gamma_set(xf86CrtcPtr crtc, CARD16 *red, CARD16 *green, CARD16 *blue,
         colors[i].blue = blue[i] >> 8;
     }
 
+    /*
+     * The LUT control bits are programmed on every call, since a mode
+     * set resets them (viaIGA1Init clears CR33[7]). Only the DAC writes
+     * are skipped when the hardware already holds these values.
+     */
     if (!iga->index) {
         /* Set palette LUT to 8-bit mode. */
         viaIGA1SetPaletteLUTResolution(pScrn, TRUE);
 
         /* IGA1 will access the palette LUT. */
         viaSetPaletteLUTAccess(pScrn, 0x00);
-
-        /* Turn gamma correction off. */
-        viaIGA1SetGamma(pScrn, FALSE);
     } else {
         /* Set palette LUT to 8-bit mode. */
         viaIGA2SetPaletteLUTResolution(pScrn, TRUE);
 
         /* IGA2 will access the palette LUT. */
         viaSetPaletteLUTAccess(pScrn, 0x01);
-
-        /* Turn gamma correction off. */
-        viaIGA2SetGamma(pScrn, FALSE);
     }
 
-    VIALoadRgbLut(pScrn, 0, size, colors);
+    if (viaLUTDiff(pScrn, iga, 0, size, colors, lut, dirty)) {
+        /* Turn gamma correction off while the LUT is loaded. */
+        if (!iga->index) {
+            viaIGA1SetGamma(pScrn, FALSE);
+        } else {
+            viaIGA2SetGamma(pScrn, FALSE);
+        }
+
+        VIALoadRgbLut(pScrn, iga, lut, dirty);
+    } else {
+        DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+                            "Palette LUT unchanged.\n"));
+    }
 
     /*
      * Turn gamma correction on.
@@ -3517,23 +3619,144 @@ via_crtc_hide_cursor(xf86CrtcPtr crtc)
     }
 }
 
+/*
+ * FNV-1a over the 32-bit words of a cursor image.
+ */
+static uint64_t
+viaCursorHash(const CARD32 *image)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    int i;
+
+    for (i = 0; i < VIA_CURSOR_SIZE / 4; i++) {
+        hash ^= image[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+/*
+ * Forget all cursor images held in video memory, and force the hardware
+ * icon engine to be reprogrammed on the next load. Needed whenever the
+ * cursor storage or the HI registers may have been clobbered, e.g. after
+ * a VT switch.
+ */
+void
+viaCursorCacheReset(xf86CrtcPtr crtc)
+{
+    drmmode_crtc_private_ptr iga = crtc->driver_private;
+    via_cursor_cache_rec *cache = &iga->cursor_cache;
+    int i;
+
+    for (i = 0; i < VIA_CURSOR_CACHE_SLOTS; i++) {
+        cache->valid[i] = FALSE;
+        cache->age[i] = 0;
+    }
+
+    cache->clock = 0;
+    cache->slot = 0;
+    cache->hiInitialized = FALSE;
+}
+
+/*
+ * Before the CX700 there is a single hardware icon engine. IGA1 and IGA2
+ * share HI_CONTROL and HI_FBOFFSET, and HI_CONTROL[31] routes the icon
+ * to either of them.
+ */
+static Bool
+viaCursorSharedHI(VIAPtr pVia)
+{
+    switch(pVia->Chipset) {
+    case VIA_CX700:
+    case VIA_P4M890:
+    case VIA_P4M900:
+    case VIA_VX800:
+    case VIA_VX855:
+    case VIA_VX900:
+        return FALSE;
+    default:
+        return TRUE;
+    }
+}
+
+/*
+ * Each CRTC keeps the last few cursor images in separate video memory
+ * slots. Loading an image that is already resident (animated cursors,
+ * arrow / text beam flips) only moves the HI starting address; otherwise
+ * the least recently used slot is overwritten.
+ */
 static void
 via_crtc_load_cursor_argb(xf86CrtcPtr crtc, CARD32 *image)
 {
     ScrnInfoPtr pScrn = crtc->scrn;
+    xf86CrtcConfigPtr xf86_config = XF86_CRTC_CONFIG_PTR(pScrn);
     drmmode_crtc_private_ptr iga = crtc->driver_private;
-    void *dst;
+    via_cursor_cache_rec *cache = &iga->cursor_cache;
+    uint64_t hash = viaCursorHash(image);
+    int i, slot = -1, victim = 0;
+    CARD8 *dst;
+
+    for (i = 0; i < VIA_CURSOR_CACHE_SLOTS; i++) {
+        if (cache->valid[i] && (cache->hash[i] == hash)) {
+            slot = i;
+            break;
+        }
 
-    dst = drm_bo_map(pScrn, iga->cursor_bo);
-    memcpy(dst, image, iga->cursor_bo->size);
+        if (!cache->valid[i]) {
+            if (cache->valid[victim])
+                victim = i;
+        } else if (cache->valid[victim] &&
+                    (cache->age[i] < cache->age[victim])) {
+            victim = i;
+        }
+    }
+
+    if (slot < 0) {
+        slot = victim;
+        dst = drm_bo_map(pScrn, iga->cursor_bo);
+        memcpy(dst + iga->cursor_offset + slot * VIA_CURSOR_SIZE,
+                image, VIA_CURSOR_SIZE);
+        cache->hash[slot] = hash;
+        cache->valid[slot] = TRUE;
+        cache->misses++;
+    } else {
+        cache->hits++;
+    }
+
+    cache->age[slot] = ++cache->clock;
+
+    if ((slot == cache->slot) && cache->hiInitialized)
+        return;
+
+    cache->slot = slot;
 
     if (!iga->index) {
-        viaIGA1InitHI(pScrn);
+        if (!cache->hiInitialized)
+            viaIGA1InitHI(pScrn);
         viaIGA1SetHIStartingAddress(crtc);
     } else {
-        viaIGA2InitHI(pScrn);
+        if (!cache->hiInitialized)
+            viaIGA2InitHI(pScrn);
         viaIGA2SetHIStartingAddress(crtc);
     }
+
+    cache->hiInitialized = TRUE;
+
+    /*
+     * The shared engine now points at this CRTC, so the other one has
+     * to program it again on its next load.
+     */
+    if (viaCursorSharedHI(VIAPTR(pScrn))) {
+        for (i = 0; i < xf86_config->num_crtc; i++) {
+            xf86CrtcPtr other = xf86_config->crtc[i];
+
+            if (other != crtc) {
+                iga = other->driver_private;
+                iga->cursor_cache.hiInitialized = FALSE;
+            }
+        }
+    }
 }
 
 static void
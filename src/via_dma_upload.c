@@ -0,0 +1,171 @@
+/*
+ * Copyright 2026 The OpenChrome Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * The choice of EXA upload path and the PCI DMA upload through the DRM
+ * blit ioctls. This only depends on libdrm, so that
+ * tools/via_upload_test.c can run it against the DRM shim.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <string.h>
+
+#include <xf86drm.h>
+#ifndef __user
+#define __user
+#endif
+#include "via_drm.h"
+#include "via_dma_upload.h"
+
+/*
+ * The engine paths an upload may take on this chipset. The chipsets with
+ * the AGP texture upload (agpTexChip) only use it on AGP boards and when
+ * the user asked for it, as it has no test coverage; the others use the
+ * PCI DMA, which only Linux has.
+ */
+unsigned
+viaUploadPathsInit(int agpTexChip, int isPCI, int agpUpload)
+{
+    if (agpTexChip)
+        return (!isPCI && agpUpload) ? VIA_UPLOAD_AGP : 0;
+#ifdef linux
+    return VIA_UPLOAD_DMA;
+#else
+    return 0;
+#endif
+}
+
+/*
+ * The engine paths, out of those set up in paths, that are worth it for
+ * an upload of size bytes, to be tried in the order AGP, DMA, before
+ * falling back to the CPU.
+ */
+unsigned
+viaUploadPaths(unsigned paths, unsigned size,
+               unsigned minTexUpload, unsigned minDmaUpload)
+{
+    if (size < minTexUpload)
+        paths &= ~VIA_UPLOAD_AGP;
+    if (size < minDmaUpload)
+        paths &= ~VIA_UPLOAD_DMA;
+    return paths;
+}
+
+/*
+ * Blit w bytes by h lines from system memory to the framebuffer. Sources
+ * that are not 16 byte aligned are staged through the two halves of the
+ * bounce buffer, each bounceSize bytes plus 16 bytes of room to align
+ * them, so that copying one chunk overlaps the blit of the other.
+ * Returns 0 or a negative errno.
+ */
+int
+viaDMAUploadBlits(int fd, unsigned char *bounce, unsigned bounceSize,
+                  unsigned long fbOffset, unsigned dstPitch,
+                  unsigned char *src, unsigned srcPitch,
+                  unsigned w, unsigned h)
+{
+    drm_via_dmablit_t blit[2], *curBlit;
+    unsigned char *sysAligned;
+    int doSync[2], useBounceBuffer;
+    unsigned pitch;
+    int curBuf, err = 0, ret, i, blitHeight;
+
+    useBounceBuffer = (((unsigned long)src & 15) || (srcPitch & 15));
+    doSync[0] = 0;
+    doSync[1] = 0;
+    curBuf = 1;
+    blitHeight = h;
+    pitch = srcPitch;
+    if (useBounceBuffer) {
+        pitch = (w + 15) & ~15;
+        blitHeight = bounceSize / pitch;
+        if (!blitHeight)
+            return -EINVAL;
+    }
+
+    while (h != 0) {
+        curBuf = 1 - curBuf;
+        curBlit = &blit[curBuf];
+        if (doSync[curBuf]) {
+            do {
+                err = drmCommandWrite(fd, DRM_VIA_BLIT_SYNC,
+                                      &curBlit->sync, sizeof(curBlit->sync));
+            } while (err == -EAGAIN);
+
+            if (err)
+                return err;
+            doSync[curBuf] = 0;
+        }
+
+        curBlit->num_lines = (h > blitHeight) ? blitHeight : h;
+        h -= curBlit->num_lines;
+
+        if (useBounceBuffer) {
+            sysAligned = bounce + curBuf * bounceSize;
+            sysAligned = (unsigned char *)
+                    (((unsigned long)sysAligned + 15) & ~15UL);
+            curBlit->mem_addr = sysAligned;
+            for (i = 0; i < curBlit->num_lines; ++i) {
+                memcpy(sysAligned, src, w);
+                sysAligned += pitch;
+                src += srcPitch;
+            }
+        } else {
+            curBlit->mem_addr = src;
+            src += curBlit->num_lines * srcPitch;
+        }
+
+        curBlit->line_length = w;
+        curBlit->mem_stride = pitch;
+        curBlit->fb_addr = fbOffset;
+        curBlit->fb_stride = dstPitch;
+        curBlit->to_fb = 1;
+        fbOffset += curBlit->num_lines * dstPitch;
+
+        do {
+            err = drmCommandWriteRead(fd, DRM_VIA_DMA_BLIT,
+                                      curBlit, sizeof(*curBlit));
+        } while (err == -EAGAIN);
+
+        if (err)
+            break;
+        doSync[curBuf] = 1;
+    }
+
+    for (i = 0; i < 2; ++i) {
+        if (doSync[i]) {
+            do {
+                ret = drmCommandWrite(fd, DRM_VIA_BLIT_SYNC,
+                                      &blit[i].sync, sizeof(blit[i].sync));
+            } while (ret == -EAGAIN);
+            if (!err)
+                err = ret;
+        }
+    }
+
+    return err;
+}
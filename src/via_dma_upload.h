@@ -0,0 +1,39 @@
+/*
+ * Copyright 2026 The OpenChrome Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _VIA_DMA_UPLOAD_H_
+#define _VIA_DMA_UPLOAD_H_
+
+/* Engine paths for EXA UploadToScreen, besides writing through the CPU. */
+#define VIA_UPLOAD_AGP      0x01
+#define VIA_UPLOAD_DMA      0x02
+
+unsigned viaUploadPathsInit(int agpTexChip, int isPCI, int agpUpload);
+unsigned viaUploadPaths(unsigned paths, unsigned size,
+                        unsigned minTexUpload, unsigned minDmaUpload);
+int viaDMAUploadBlits(int fd, unsigned char *bounce, unsigned bounceSize,
+                      unsigned long fbOffset, unsigned dstPitch,
+                      unsigned char *src, unsigned srcPitch,
+                      unsigned w, unsigned h);
+
+#endif /* _VIA_DMA_UPLOAD_H_ */
@@ -248,28 +248,50 @@ VIAEnterVT_internal(ScrnInfoPtr pScrn, int flags)
 {
     xf86CrtcConfigPtr xf86_config = XF86_CRTC_CONFIG_PTR(pScrn);
     VIAPtr pVia = VIAPTR(pScrn);
+    CARD64 start = GetTimeInMicros();
     int i;
 
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                         "Entered %s.\n", __func__));
 
+    viaTraceBegin("VIAEnterVT", NULL);
+
+    /* The console may have reprogrammed any register. */
+    if (!pVia->KMS)
+        viaRegShadowReset(pScrn);
+
     for (i = 0; i < xf86_config->num_crtc; i++) {
         xf86CrtcPtr crtc = xf86_config->crtc[i];
 
         if (crtc->funcs->save) {
             crtc->funcs->save(crtc);
         }
+
+        /*
+         * The console may have reprogrammed the hardware icon and
+         * the palette.
+         */
+        if (!pVia->KMS) {
+            if (pVia->drmmode.hwcursor) {
+                viaCursorCacheReset(crtc);
+            }
+
+            viaLUTShadowReset(crtc);
+        }
     }
 
     for (i = 0; i < xf86_config->num_output; i++) {
         xf86OutputPtr output = xf86_config->output[i];
 
         if (output->funcs->save) {
+            viaTraceBegin("output save", output->name);
             output->funcs->save(output);
+            viaTraceEnd();
         }
     }
 
     if (!xf86SetDesiredModes(pScrn)) {
+        viaTraceEnd();
         DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                             "Exiting %s.\n", __func__));
         return FALSE;
@@ -281,6 +303,8 @@ VIAEnterVT_internal(ScrnInfoPtr pScrn, int flags)
             viaRestoreVideo(pScrn);
         }
 
+        viaRingResume(pScrn);
+
 #ifdef OPENCHROMEDRI
         if (pVia->directRenderingType == DRI_1) {
             kickVblank(pScrn);
@@ -291,6 +315,12 @@ VIAEnterVT_internal(ScrnInfoPtr pScrn, int flags)
 #endif
     }
 
+    viaTraceEnd();
+
+    xf86DrvMsgVerb(pScrn->scrnIndex, X_INFO, 4,
+                   "VT enter took %u ms.\n",
+                   (unsigned)((GetTimeInMicros() - start) / 1000));
+
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                         "Exiting %s.\n", __func__));
     return TRUE;
@@ -308,11 +338,14 @@ VIALeaveVT_internal(ScrnInfoPtr pScrn, int flags)
 {
     xf86CrtcConfigPtr xf86_config = XF86_CRTC_CONFIG_PTR(pScrn);
     VIAPtr pVia = VIAPTR(pScrn);
+    CARD64 start = GetTimeInMicros();
     int i;
 
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                         "Entered %s.\n", __func__));
 
+    viaTraceBegin("VIALeaveVT", NULL);
+
     if (!flags) {
 #ifdef OPENCHROMEDRI
         if (pVia->directRenderingType == DRI_1) {
@@ -332,6 +365,8 @@ VIALeaveVT_internal(ScrnInfoPtr pScrn, int flags)
         }
 #endif
 
+        viaRingSuspend(pScrn);
+
         /* Save video status and turn off all video activities. */
         if ((!pVia->IsSecondary) && (!pVia->KMS)){
             viaSaveVideo(pScrn);
@@ -342,7 +377,9 @@ VIALeaveVT_internal(ScrnInfoPtr pScrn, int flags)
         xf86OutputPtr output = xf86_config->output[i];
 
         if (output->funcs->restore) {
+            viaTraceBegin("output restore", output->name);
             output->funcs->restore(output);
+            viaTraceEnd();
         }
     }
 
@@ -356,6 +393,12 @@ VIALeaveVT_internal(ScrnInfoPtr pScrn, int flags)
 
     pScrn->vtSema = FALSE;
 
+    viaTraceEnd();
+
+    xf86DrvMsgVerb(pScrn->scrnIndex, X_INFO, 4,
+                   "VT leave took %u ms.\n",
+                   (unsigned)((GetTimeInMicros() - start) / 1000));
+
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                         "Exiting %s.\n", __func__));
 }
@@ -387,6 +430,8 @@ VIAFreeRec(ScrnInfoPtr pScrn)
     if (pVia->VideoRegs)
         free(pVia->VideoRegs);
 
+    free(pVia->traceFile);
+
     free(pScrn->driverPrivate);
     pScrn->driverPrivate = NULL;
 } /* VIAFreeRec */
@@ -440,6 +485,8 @@ via_pci_probe(DriverPtr driver, int entity_num,
 {
     ScrnInfoPtr scrn = NULL;
 
+    viaTraceBegin("VIAProbe", NULL);
+
     scrn = xf86ConfigPciEntity(scrn, 0, entity_num, VIAPciChipsets,
                                NULL, NULL, NULL, NULL, NULL);
 
@@ -463,6 +510,8 @@ via_pci_probe(DriverPtr driver, int entity_num,
                 "For support, please refer to"
                 " https://www.freedesktop.org/wiki/Openchrome/.\n");
     }
+
+    viaTraceEnd();
     return scrn != NULL;
 }
 #else /* !XSERVER_LIBPCIACCESS */
@@ -483,6 +532,8 @@ VIAProbe(DriverPtr drv, int flags)
     if (xf86GetPciVideoInfo() == NULL)
         return FALSE;
 
+    viaTraceBegin("VIAProbe", NULL);
+
     numUsed = xf86MatchPciInstances(DRIVER_NAME,
                                     PCI_VIA_VENDOR_ID,
                                     VIAChipsets,
@@ -493,8 +544,10 @@ VIAProbe(DriverPtr drv, int flags)
                                     &usedChips);
     free(devSections);
 
-    if (numUsed <= 0)
+    if (numUsed <= 0) {
+        viaTraceEnd();
         return FALSE;
+    }
 
     xf86Msg(X_NOTICE,
             "VIA Technologies does not support this driver in any way.\n");
@@ -568,6 +621,7 @@ VIAProbe(DriverPtr drv, int flags)
 
     free(usedChips);
 
+    viaTraceEnd();
     return foundScreen;
 
 } /* VIAProbe */
@@ -954,6 +1008,8 @@ VIAPreInit(ScrnInfoPtr pScrn, int flags)
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                         "Entered %s.\n", __func__));
 
+    viaTraceBegin("VIAPreInit", NULL);
+
     pScrn->monitor = pScrn->confScreen->monitor;
 
     /*
@@ -1203,6 +1259,7 @@ fail:
 free_rec:
     VIAFreeRec(pScrn);
 exit:
+    viaTraceEnd();
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                         "Exiting %s.\n", __func__));
     return status;
@@ -1264,10 +1321,136 @@ LoadPalette(ScrnInfoPtr pScrn, int numColors, int *indices,
     }
 }
 
+/*
+ * Copy function used for shadow frame buffer updates. It is picked by
+ * benchmarking the available (SSE / MMX / libc) copy routines the first
+ * time it is needed, the same way the Xv code does.
+ */
+static vidCopyFunc viaShadowCpy = NULL;
+
+/*
+ * Vertically adjacent damage boxes are merged into one span as long as
+ * the merged bounding box does not copy more than 1/VIA_SHADOW_WASTE
+ * extra bytes compared to copying the boxes on their own.
+ */
+#define VIA_SHADOW_WASTE    4
+
+static void
+viaShadowCopySpan(uint8_t *dst, int dstPitch, const uint8_t *src,
+                    int srcPitch, int x1, int x2, int y1, int y2)
+{
+    int lines = y2 - y1;
+    int width = x2 - x1;
+
+    dst += y1 * dstPitch + x1;
+    src += y1 * srcPitch + x1;
+
+    /*
+     * The SSE and MMX routines store with movntps / movntq, which fault
+     * on a destination that is not 16-byte aligned.
+     */
+    if (((unsigned long)dst | dstPitch) & 15) {
+        while (lines--) {
+            memcpy(dst, src, width);
+            dst += dstPitch;
+            src += srcPitch;
+        }
+        return;
+    }
+
+    /*
+     * Full lines with identical pitches form one contiguous block.
+     * The copy routines move 2 * w bytes per line in their 4:2:2 mode,
+     * so the last byte of an odd sized copy is moved on its own.
+     */
+    if ((width == srcPitch) && (srcPitch == dstPitch)) {
+        width *= lines;
+        lines = 1;
+    }
+
+    while (lines--) {
+        (*viaShadowCpy)(dst, src, dstPitch, width >> 1, 1, TRUE);
+        if (width & 1)
+            dst[width - 1] = src[width - 1];
+        dst += dstPitch;
+        src += srcPitch;
+    }
+}
+
+/*
+ * Shadow frame buffer update. Rather than copying every damage box on
+ * its own, vertically adjoining boxes are coalesced into larger spans
+ * (whole lines where possible) and copied with the fastest available
+ * copy routine.
+ */
 static void
 viaUpdatePacked(ScreenPtr pScreen, shadowBufPtr pBuf)
 {
-    shadowUpdatePacked(pScreen, pBuf);
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    VIAPtr pVia = VIAPTR(pScrn);
+    RegionPtr damage = shadowDamage(pBuf);
+    PixmapPtr pShadow = pBuf->pPixmap;
+    int nbox = RegionNumRects(damage);
+    BoxPtr pbox = RegionRects(damage);
+    int cpp = (pScrn->bitsPerPixel + 7) >> 3;
+    int srcPitch = pShadow->devKind;
+    int dstPitch = (pScrn->displayWidth * pScrn->bitsPerPixel) >> 3;
+    int lineBytes = (srcPitch < dstPitch) ? srcPitch : dstPitch;
+    const uint8_t *src = pShadow->devPrivate.ptr;
+    uint8_t *dst;
+    int x1, x2, y1, y2, bx1, bx2;
+    unsigned long area, merged;
+
+    if (!nbox)
+        return;
+
+    dst = drm_bo_map(pScrn, pVia->drmmode.front_bo);
+    if (!dst)
+        return;
+
+    x1 = y1 = x2 = y2 = 0;
+    area = 0;
+
+    for (; nbox--; pbox++) {
+        /*
+         * Work in bytes, rounded out to the 16-byte boundaries the fast
+         * copy routines need. The shadow mirrors the front buffer, so
+         * copying the extra bytes is harmless.
+         */
+        bx1 = (pbox->x1 * cpp) & ~15;
+        bx2 = (pbox->x2 * cpp + 15) & ~15;
+        if (bx2 > lineBytes)
+            bx2 = lineBytes;
+
+        if (area) {
+            int mx1 = (bx1 < x1) ? bx1 : x1;
+            int mx2 = (bx2 > x2) ? bx2 : x2;
+            int my2 = (pbox->y2 > y2) ? pbox->y2 : y2;
+
+            merged = (unsigned long)(mx2 - mx1) * (my2 - y1);
+            area += (unsigned long)(bx2 - bx1) * (pbox->y2 - pbox->y1);
+
+            /* Region boxes are y-x banded, so pbox->y1 >= y1. */
+            if ((pbox->y1 <= y2) &&
+                (merged <= area + area / VIA_SHADOW_WASTE)) {
+                x1 = mx1;
+                x2 = mx2;
+                y2 = my2;
+                continue;
+            }
+
+            viaShadowCopySpan(dst, dstPitch, src, srcPitch,
+                                x1, x2, y1, y2);
+        }
+
+        x1 = bx1;
+        x2 = bx2;
+        y1 = pbox->y1;
+        y2 = pbox->y2;
+        area = (unsigned long)(x2 - x1) * (y2 - y1);
+    }
+
+    viaShadowCopySpan(dst, dstPitch, src, srcPitch, x1, x2, y1, y2);
 }
 
 static void *
@@ -1316,6 +1499,12 @@ VIACreateScreenResources(ScreenPtr pScreen)
         return FALSE;
 
     if (pVia->shadowFB) {
+        if (!viaShadowCpy) {
+            viaTraceBegin("viaVidCopyInit", "shadow");
+            viaShadowCpy = viaVidCopyInit("shadow", pScreen);
+            viaTraceEnd();
+        }
+
         if (!shadowAdd(pScreen, rootPixmap, viaUpdatePacked,
                         viaShadowWindow, 0, NULL))
             return FALSE;
@@ -1350,6 +1539,9 @@ VIACloseScreen(CLOSE_SCREEN_ARGS_DECL)
     }
 #endif /* OPENCHROMEDRI */
 
+    viaCountersFini(pScrn);
+    viaTraceWrite(pScrn);
+
     if (pVia->directRenderingType != DRI_2)
         viaExitVideo(pScrn);
 
@@ -1379,11 +1571,27 @@ VIACloseScreen(CLOSE_SCREEN_ARGS_DECL)
         drm_bo_free(pScrn, pVia->drmmode.front_bo);
     }
 
-    if (iga->cursor_bo)
+    if (iga->cursor_bo) {
+        int i;
+
+        if (!pVia->KMS) {
+            for (i = 0; i < xf86_config->num_crtc; i++) {
+                drmmode_crtc_private_ptr cursorIGA =
+                                xf86_config->crtc[i]->driver_private;
+
+                xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+                            "IGA%d cursor cache: %lu hits, %lu misses.\n",
+                            cursorIGA->index + 1,
+                            cursorIGA->cursor_cache.hits,
+                            cursorIGA->cursor_cache.misses);
+            }
+        }
+
         /*
          * Release hardware cursor storage.
          */
         drm_bo_free(pScrn, iga->cursor_bo);
+    }
 
 #ifdef OPENCHROMEDRI
     if (pVia->directRenderingType == DRI_1)
@@ -1424,6 +1632,9 @@ VIAScreenInit(SCREEN_INIT_ARGS_DECL)
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                         "Entered %s.\n", __func__));
 
+    /* Left open on failure; the server gives up on a failed ScreenInit. */
+    viaTraceBegin("VIAScreenInit", NULL);
+
     pScrn->pScreen = pScreen;
 
     miClearVisualTypes();
@@ -1550,6 +1761,13 @@ VIAScreenInit(SCREEN_INIT_ARGS_DECL)
         cursorSize = (cursorWidth * cursorHeight) * (32 / 8);
         alignment = 1024;
 
+        /*
+         * Under UMS, every CRTC gets its own set of cursor cache
+         * slots within the cursor storage.
+         */
+        if (!pVia->KMS)
+            cursorSize *= VIA_CURSOR_CACHE_SLOTS * xf86_config->num_crtc;
+
         /*
          * Set cursor location in frame buffer.
          */
@@ -1567,6 +1785,12 @@ VIAScreenInit(SCREEN_INIT_ARGS_DECL)
              * Set cursor location in frame buffer.
              */
             iga->cursor_bo = bo;
+            iga->cursor_offset = 0;
+            if (!pVia->KMS) {
+                iga->cursor_offset = i * VIA_CURSOR_CACHE_SLOTS *
+                                        VIA_CURSOR_SIZE;
+                viaCursorCacheReset(crtc);
+            }
         }
 
         if (!xf86_cursors_init(pScreen,
@@ -1632,9 +1856,14 @@ VIAScreenInit(SCREEN_INIT_ARGS_DECL)
         viaInitVideo(pScrn->pScreen);
     }
 
+    viaCountersInit(pScreen);
+
     if (serverGeneration == 1)
         xf86ShowUnusedOptions(pScrn->scrnIndex, pScrn->options);
 
+    viaTraceEnd();
+    viaTraceWrite(pScrn);
+
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                         "Exiting %s.\n", __func__));
     return TRUE;
@@ -77,6 +77,7 @@
 #include "via_dri.h"
 #include "via_drmclient.h"
 #include "via_drm.h"
+#include "via_dma_upload.h"
 #endif
 
 
@@ -90,10 +91,13 @@
 
 #define VIA_AGP_UPL_SIZE    (1024*128)
 #define VIA_DMA_DL_SIZE     (1024*128)
+
 #define VIA_SCRATCH_SIZE    (4*1024*1024)
 
 /*
- * Pixmap sizes below which we don't try to do hw accel.
+ * Pixmap sizes below which we don't try to do hw accel. These are only
+ * the starting values; the cost model in via_exa_cost.c replaces them
+ * with thresholds measured on the running machine.
  */
 
 #define VIA_MIN_COMPOSITE   400
@@ -101,6 +105,30 @@
 #define VIA_MIN_TEX_UPLOAD 200
 #define VIA_MIN_DOWNLOAD 200
 
+/*
+ * The 3D engine clips to 0 - 2047. Render targets larger than that are
+ * drawn in VIA_3D_TILE sized tiles, rebasing the destination for each.
+ * Textures are limited to VIA_3D_TEX_MAX texels in each direction.
+ */
+
+#define VIA_3D_CLIP_MAX     2047
+#define VIA_3D_TILE         1024
+#define VIA_3D_TEX_MAX      2048
+
+/*
+ * The 2D engine takes pitches up to 16383 bytes, see VIA_REG_PITCH. This
+ * is the largest pitch below that which keeps the pixmap pitch alignment.
+ */
+
+#define VIA_2D_PITCH_MAX    16368
+
+/*
+ * Linear gradient sources are drawn from a one line ramp texture. Recent
+ * ramps are kept in VRAM, keyed by their stop list.
+ */
+#define VIA_GRADIENT_WIDTH  256
+#define VIA_GRADIENT_CACHE  8
+
 #define AGP_PAGE_SIZE 4096
 #define AGP_PAGES 8192
 #define AGP_SIZE (AGP_PAGE_SIZE * AGP_PAGES)
@@ -210,6 +238,133 @@ typedef struct _twodContext {
     int clipY2;
 } ViaTwodContext;
 
+/*
+ * Linear cost of one way of doing an operation, in microseconds, with the
+ * decayed sums used to refit it from measurements.
+ */
+typedef struct _ViaCost {
+    double fixed;
+    double perUnit;
+    double n, sx, sy, sxx, sxy;
+} ViaCost;
+
+typedef struct _ViaCostModel {
+    ViaCost cpuBlend;       /* pixman Over, per pixel, system memory. */
+    ViaCost cpuRead;        /* CPU read from VRAM, per byte. */
+    ViaCost cpuWrite;       /* CPU write to VRAM, per byte. */
+    ViaCost sysWrite;       /* CPU write to system memory, per byte. */
+    ViaCost dmaRead;        /* PCI DMA download, per byte. */
+    ViaCost dmaWrite;       /* PCI DMA upload, per byte. */
+    ViaCost texUpload;      /* AGP texture upload, per byte. */
+    ViaCost gpuFill;        /* 2D engine fill and sync, per pixel. */
+    ViaCost submit;         /* Command buffer flush, per dword. */
+    ViaCost sync;           /* Waiting for an idle engine. */
+    int cpp;
+    Bool calibrated;
+    unsigned long samples;
+    unsigned minComposite;
+    unsigned minDownload;
+    unsigned minTexUpload;
+    unsigned minDmaUpload;
+} ViaCostModel;
+
+/* How a prepared composite is drawn. */
+typedef enum {
+    VIA_ROUTE_3D,
+    VIA_ROUTE_COPY,
+    VIA_ROUTE_SOLID,
+    VIA_ROUTE_NUM
+} ViaCompositeRoute;
+
+/* Why a composite went to software, see via_exa_reject.c. */
+typedef enum {
+    VIA_REJECT_SOURCE_PICT,
+    VIA_REJECT_MASK_PICT,
+    VIA_REJECT_SRC_SMALL,
+    VIA_REJECT_MASK_SMALL,
+    VIA_REJECT_MASK_REPEAT,
+    VIA_REJECT_TEX_SIZE,
+    VIA_REJECT_COMPONENT_ALPHA,
+    VIA_REJECT_OP,
+    VIA_REJECT_TRANSFORM,
+    VIA_REJECT_DST_FORMAT,
+    VIA_REJECT_A8_DST,
+    VIA_REJECT_MASK_FORMAT,
+    VIA_REJECT_SRC_FORMAT,
+    VIA_REJECT_PREPARE,
+    VIA_REJECT_NUM
+} ViaCompositeReject;
+
+typedef struct _ViaGradientRamp {
+    CARD32 hash;
+    Bool pad;
+    int nstops;
+    PictGradientStopPtr stops;
+    CARD32 lastUse;
+} ViaGradientRamp;
+
+/* Command ring fed to the regulator without DRM, see via_ring.c. */
+typedef struct _ViaRing {
+    struct buffer_object *bo;
+    CARD32             *virt;
+    CARD32              base;
+    CARD32              size;
+    CARD32              low;
+    CARD32              diff;
+    CARD32             *lastPause;
+    CARD32              regPause;
+    Bool                enabled;
+    Bool                running;
+} ViaRing;
+
+/* Runtime counters, see via_counters.c. */
+typedef enum {
+    VIA_COUNTER_SUBMITS,
+    VIA_COUNTER_DWORDS,
+    VIA_COUNTER_SYNCS,
+    VIA_COUNTER_WAITS,
+    VIA_COUNTER_WAIT_US,
+    VIA_COUNTER_UPLOAD_BYTES,
+    VIA_COUNTER_DOWNLOAD_BYTES,
+    VIA_COUNTER_XV_FRAMES,
+    VIA_COUNTER_XV_BYTES,
+    VIA_COUNTER_XV_UNCHANGED,
+    VIA_COUNTER_FB_CHECK_COMPOSITE,
+    VIA_COUNTER_FB_PREPARE_COMPOSITE,
+    VIA_COUNTER_FB_SOLID,
+    VIA_COUNTER_FB_COPY,
+    VIA_COUNTER_FB_UPLOAD,
+    VIA_COUNTER_FB_DOWNLOAD,
+    VIA_COUNTER_REG_CYCLES_SAVED,
+    VIA_COUNTER_NUM
+} ViaCounterId;
+
+typedef struct _ViaCounters {
+    CARD64              val[VIA_COUNTER_NUM];
+    CARD32              exported[VIA_COUNTER_NUM];
+    Bool                valid;
+    Bool                named;
+    Bool                armed;
+    ScrnInfoPtr         pScrn;
+    OsTimerPtr          timer;
+    int                 logInterval;
+    CARD32              lastLog;
+    Bool (*CheckComposite) (int, PicturePtr, PicturePtr, PicturePtr);
+    Bool (*PrepareComposite) (int, PicturePtr, PicturePtr, PicturePtr,
+                              PixmapPtr, PixmapPtr, PixmapPtr);
+    Bool (*PrepareSolid) (PixmapPtr, int, Pixel, Pixel);
+    Bool (*PrepareCopy) (PixmapPtr, PixmapPtr, int, int, int, Pixel);
+    Bool (*UploadToScreen) (PixmapPtr, int, int, int, int, char *, int);
+    Bool (*DownloadFromScreen) (PixmapPtr, int, int, int, int, char *, int);
+} ViaCounters;
+
+#define VIA_COUNT(pVia, id, n)                      \
+    do {                                            \
+        (pVia)->counters.val[(id)] += (n);          \
+        if (!(pVia)->counters.armed)                \
+            viaCountersArm(pVia);                   \
+    } while (0)
+
 typedef struct _VIA {
     int                 Bpl;
 
@@ -262,6 +417,11 @@ typedef struct _VIA {
     Via3DState          v3d;
     Via3DState          *lastToUpload;
     ViaCommandBuffer    cb;
+    ViaRing             ring;
+    ViaCounters         counters;
+    char               *traceFile;
+    ViaRegShadow        regShadow;
+    Bool                regShadowEnable;
     int                 accelMarker;
     struct buffer_object *exa_sync_bo;
     struct buffer_object *exaMem;
@@ -269,6 +429,7 @@ typedef struct _VIA {
     void               *markerBuf;
     CARD32              curMarker;
     CARD32              lastMarkerRead;
+    Bool                markerPending;
     Bool                agpDMA;
     Bool                nPOT[VIA_NUM_TEXUNITS];
     const unsigned     *HqvCmeRegs;
@@ -281,6 +442,25 @@ typedef struct _VIA {
     Bool                componentAlpha;
     void               *srcP;
     CARD32              srcFormat;
+    Bool                dstTiled;
+    CARD32              dstFormat;
+    Bool                caTwoPass;
+    int                 maskTex;
+    ViaCostModel        cost;
+    Bool                srcBounded;
+    Bool                srcFillOutside;
+    BoxRec              srcBounds;
+    CARD32              srcSolid;
+    unsigned            uploadPaths;
+    ViaCompositeRoute   compositeRoute;
+    unsigned long       routeOps[VIA_ROUTE_NUM];
+    unsigned long       routeRects[VIA_ROUTE_NUM];
+    Bool                compositeStats;
+    Bool                exaAGPUpload;
+    struct _ViaRejectTable *rejects;
+    ExaOffscreenArea   *gradArea;
+    ViaGradientRamp     gradRamps[VIA_GRADIENT_CACHE];
+    CARD32              gradClock;
     unsigned            scratchOffset;
     int                 exaScratchSize;
     char *              scratchAddr;
@@ -379,6 +559,18 @@ void viaSetupDefaultOptions(ScrnInfoPtr pScrn);
 void viaProcessOptions(ScrnInfoPtr pScrn);
 Bool via_xf86crtc_resize(ScrnInfoPtr scrn, int width, int height);
 
+/* In via_counters.c */
+void viaCountersWrapExa(VIAPtr pVia, ExaDriverPtr pExa);
+void viaCountersInit(ScreenPtr pScreen);
+void viaCountersFini(ScrnInfoPtr pScrn);
+void viaCountersReset(VIAPtr pVia);
+void viaCountersArm(VIAPtr pVia);
+
+/* In via_trace.c */
+void viaTraceBegin(const char *name, const char *detail);
+void viaTraceEnd(void);
+void viaTraceWrite(ScrnInfoPtr pScrn);
+
 /* In via_exa.c. */
 int viaEXAOffscreenAlloc(ScrnInfoPtr pScrn,
                             struct buffer_object *obj,
@@ -391,6 +583,7 @@ Bool viaAccelSetMode(int bpp, ViaTwodContext * tdc);
 void viaSetClippingRectangle(ScrnInfoPtr pScrn,
                                 int x1, int y1, int x2, int y2);
 void viaAccelSync(ScrnInfoPtr);
+void viaFlushPCI(VIAPtr pVia, ViaCommandBuffer *cb);
 void viaExitAccel(ScreenPtr);
 void viaFinishInitAccel(ScreenPtr);
 Bool viaOrder(CARD32 val, CARD32 * shift);
@@ -398,6 +591,35 @@ CARD32 viaBitExpandHelper(CARD32 pixel, CARD32 bits);
 Bool viaCheckUpload(ScrnInfoPtr pScrn, Via3DState * v3d);
 void viaPixelARGB8888(unsigned format, void *pixelP, CARD32 * argb8888);
 Bool viaExpandablePixel(int format);
+#ifdef OPENCHROMEDRI
+int viaAccelDMADownload(ScrnInfoPtr pScrn, unsigned long fbOffset,
+                        unsigned srcPitch, unsigned char *dst,
+                        unsigned dstPitch, unsigned w, unsigned h);
+int viaAccelDMAUpload(ScrnInfoPtr pScrn, unsigned long fbOffset,
+                        unsigned dstPitch, unsigned char *src,
+                        unsigned srcPitch, unsigned w, unsigned h);
+#endif
+int viaExaDstWidth(PixmapPtr pDst);
+Bool viaExaTiledDst(PixmapPtr pDst);
+Bool viaExaCheckA8Dst(int op, PicturePtr pSrcPicture,
+                        PicturePtr pMaskPicture, PicturePtr pDstPicture);
+Bool viaExaTexFits(PicturePtr pPict);
+void viaExaCompositeTiled(ScrnInfoPtr pScrn, PixmapPtr pDst,
+                            int srcX, int srcY, int maskX, int maskY,
+                            int dstX, int dstY, int width, int height);
+ViaCompositeRoute viaExaCompositeRoute(int op, PicturePtr pSrcPicture,
+                            PicturePtr pMaskPicture, PicturePtr pDstPicture,
+                            PixmapPtr pSrc, PixmapPtr pDst, Pixel *fg);
+void viaExaReportRoutes(ScrnInfoPtr pScrn);
+Bool viaExaCheckComponentAlpha(int op, PicturePtr pMaskPicture);
+Bool viaExaCheckTransform(PicturePtr pSrcPicture, PicturePtr pMaskPicture);
+ViaTextureModes viaExaRepeatMode(PicturePtr pPict);
+Bool viaExaSetTexSampling(ScrnInfoPtr pScrn, int op, PicturePtr pPict,
+                            int tex, Bool isSrc);
+void viaExaComponentAlphaPass(ScrnInfoPtr pScrn, CARD8 op);
+void viaExaCompositeRect(ScrnInfoPtr pScrn, PixmapPtr pDst,
+                            int srcX, int srcY, int maskX, int maskY,
+                            int dstX, int dstY, int width, int height);
 void viaAccelFillPixmap(ScrnInfoPtr, unsigned long, unsigned long,
 			int, int, int, int, int, unsigned long);
 void viaAccelTextureBlit(ScrnInfoPtr, unsigned long, unsigned, unsigned,
@@ -410,6 +632,34 @@ void viaExaPrintCompositeInfo(char *info, CARD8 op, PicturePtr pSrc, PicturePtr
                             PicturePtr pDst);
 #endif
 
+/* In via_exa_cost.c */
+void viaCostModelDefaults(ScrnInfoPtr pScrn);
+void viaCostModelInit(ScreenPtr pScreen);
+void viaCostModelReport(ScrnInfoPtr pScrn);
+CARD64 viaCostTime(void);
+void viaCostSample(VIAPtr pVia, ViaCost *cost, double units, CARD64 start);
+
+/* In via_exa_fence.c */
+void viaMarkerInit(VIAPtr pVia);
+void viaMarkerSubmitted(VIAPtr pVia);
+Bool viaMarkerNext(VIAPtr pVia);
+void viaMarkerEmitted(VIAPtr pVia);
+void viaAccelWaitMarker(ScreenPtr pScreen, int marker);
+
+/* In via_exa_gradient.c */
+Bool viaExaCheckSourcePict(PicturePtr pPict);
+Bool viaExaPrepareGradient(ScrnInfoPtr pScrn, PicturePtr pPict, int tex,
+                            ViaTexBlendingModes blendingMode);
+void viaExaGradientFini(ScreenPtr pScreen);
+
+/* In via_exa_reject.c */
+void viaExaRejectInit(ScrnInfoPtr pScrn);
+void viaExaRejectFini(ScrnInfoPtr pScrn);
+void viaExaRejectDump(ScrnInfoPtr pScrn, int verb);
+void viaExaCompositeReject(VIAPtr pVia, ViaCompositeReject reason, int op,
+                            PicturePtr pSrcPicture, PicturePtr pMaskPicture,
+                            PicturePtr pDstPicture);
+
 /* In via_exa_h2.c */
 Bool viaExaPrepareSolid_H2(PixmapPtr pPixmap, int alu, Pixel planeMask,
                         Pixel fg);
@@ -448,6 +698,14 @@ void viaExaComposite_H6(PixmapPtr pDst, int srcX, int srcY,
                         int width, int height);
 int viaAccelMarkSync_H6(ScreenPtr);
 
+/* In via_ring.c */
+void viaRingInit(ScrnInfoPtr pScrn);
+void viaRingFini(ScrnInfoPtr pScrn);
+void viaRingSuspend(ScrnInfoPtr pScrn);
+void viaRingResume(ScrnInfoPtr pScrn);
+void viaRingFlush(VIAPtr pVia, ViaCommandBuffer *cb);
+Bool viaRingWaitIdle(VIAPtr pVia);
+
 /* In via_xv.c */
 void viaInitVideo(ScreenPtr pScreen);
 void viaExitVideo(ScrnInfoPtr pScrn);
@@ -530,6 +530,7 @@
 #define HQV_FIFO_STATUS     0x00001000  
 #define HQV_GEN_IRQ         0x00000080
 #define HQV_FIFO_DEPTH_1    0x00010000
+#define HQV_MOTION_ADAPTIVE 0x00800000   /* Motion adaptive deinterlacing */
 /* for CME engine */
 #define HQV_SW_FLIP_QUEUE_ENABLE    0x00100000
 
@@ -606,6 +607,23 @@
 #define HQV_VDEBLOCK_FILTER 0x80000000
 #define HQV_HDEBLOCK_FILTER 0x00008000
 
+/*
+ * Post filters of the Unichrome Pro HQV. With an NV12 source the V start
+ * address register is free and holds their setup, and bits 31:27 of the
+ * Y and UV start addresses hold the deblocking thresholds.
+ */
+#define HQV_DEBLOCK_Y_PARAM         0x30000000
+#define HQV_DEBLOCK_UV_PARAM        0x98000000
+#define HQV_SRC_ADDR_MASK           0x07FFFFFF
+/* HQV_SRC_STARTADDR_V             0x3DC */
+#define HQV_DEBLOCK_ENABLE          0x08000000
+#define HQV_DEBLOCK_LOWPASS         0x04000000
+#define HQV_DEBLOCK_LEVEL_DEFAULT   0x00080000
+#define HQV_MOTION_BUFFER_MASK      0x000007FF
+/* HQV_FILTER_CONTROL for motion adaptive deinterlacing */
+#define HQV_DEINTERLACE_FILTER      0xCE048811
+#define HQV_DEINTERLACE_MOTION      0x00001000
+
 /* new added registers for VT3409.For some registers have different meanings
  * but the same address,we add postfix _409 to distinguish */
 #define HQV_COLOR_ADJUSTMENT_PRE_CTRL1              0x360
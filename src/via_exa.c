@@ -34,12 +34,13 @@
 #endif
 
 #include <errno.h>
+#include <math.h>
 
 #include "via_driver.h"
 #include "via_regs.h"
 #include "via_dmabuffer.h"
 
-static void
+void
 viaFlushPCI(VIAPtr pVia, ViaCommandBuffer *cb)
 {
     register CARD32 *bp = cb->buf;
@@ -48,6 +49,8 @@ viaFlushPCI(VIAPtr pVia, ViaCommandBuffer *cb)
     unsigned loop = 0;
     register CARD32 offset = 0;
     register CARD32 value;
+    CARD64 start = viaCostTime();
+    unsigned dwords = cb->pos;
 
     while (bp < endp) {
         if (*bp == HALCYON_HEADER2) {
@@ -108,6 +111,10 @@ viaFlushPCI(VIAPtr pVia, ViaCommandBuffer *cb)
     cb->pos = 0;
     cb->mode = 0;
     cb->has3dState = FALSE;
+    viaMarkerSubmitted(pVia);
+    VIA_COUNT(pVia, VIA_COUNTER_SUBMITS, 1);
+    VIA_COUNT(pVia, VIA_COUNTER_DWORDS, dwords);
+    viaCostSample(pVia, &pVia->cost.submit, dwords, start);
 }
 
 #ifdef OPENCHROMEDRI
@@ -140,6 +147,7 @@ viaFlushDRIEnabled(VIAPtr pVia, ViaCommandBuffer *cb)
     char *tmp = (char *)cb->buf;
     int tmpSize;
     drm_via_cmdbuffer_t b;
+    CARD64 start = viaCostTime();
 
     /* Align end of command buffer for AGP DMA. */
     OUT_RING_H1(0x2f8, 0x67676767);
@@ -165,6 +173,10 @@ viaFlushDRIEnabled(VIAPtr pVia, ViaCommandBuffer *cb)
                 return;
             }
         }
+        viaMarkerSubmitted(pVia);
+        VIA_COUNT(pVia, VIA_COUNTER_SUBMITS, 1);
+        VIA_COUNT(pVia, VIA_COUNTER_DWORDS, cb->pos);
+        viaCostSample(pVia, &pVia->cost.submit, cb->pos, start);
         cb->pos = 0;
     } else {
         viaFlushPCI(pVia, cb);
@@ -371,6 +383,607 @@ viaExpandablePixel(int format)
             formatType == PICT_TYPE_ABGR || formatType == PICT_TYPE_ARGB);
 }
 
+/*
+ * Width of a composite destination as seen by the 3D engine. A8
+ * destinations are drawn through an ARGB8888 alias, see viaExaCompositeA8.
+ */
+int
+viaExaDstWidth(PixmapPtr pDst)
+{
+    if (pDst->drawable.bitsPerPixel == 8)
+        return (pDst->drawable.width + 3) >> 2;
+    return pDst->drawable.width;
+}
+
+/*
+ * Check whether a composite destination exceeds the 3D clip rectangle
+ * range and needs to be drawn in tiles.
+ */
+Bool
+viaExaTiledDst(PixmapPtr pDst)
+{
+    return (viaExaDstWidth(pDst) > VIA_3D_CLIP_MAX ||
+            pDst->drawable.height > VIA_3D_CLIP_MAX);
+}
+
+/*
+ * A8 destinations are drawn one byte lane of the alias at a time, so
+ * the color channels blend against neighbouring pixels' alpha instead
+ * of their own. Only operators whose factors depend on the source alpha
+ * alone give the right result in every lane.
+ */
+Bool
+viaExaCheckA8Dst(int op, PicturePtr pSrcPicture, PicturePtr pMaskPicture,
+                 PicturePtr pDstPicture)
+{
+    if (pDstPicture->format != PICT_a8)
+        return TRUE;
+
+    switch (op) {
+    case PictOpClear:
+    case PictOpSrc:
+    case PictOpDst:
+    case PictOpOver:
+    case PictOpInReverse:
+    case PictOpOutReverse:
+    case PictOpAdd:
+    case PictOpDisjointClear:
+    case PictOpDisjointSrc:
+    case PictOpDisjointDst:
+    case PictOpConjointClear:
+    case PictOpConjointSrc:
+    case PictOpConjointDst:
+        break;
+    default:
+        return FALSE;
+    }
+
+    if (pMaskPicture && pMaskPicture->componentAlpha)
+        return FALSE;
+    if (pSrcPicture->pDrawable && !PICT_FORMAT_A(pSrcPicture->format))
+        return FALSE;
+
+    return (pDstPicture->pDrawable->height <= VIA_3D_CLIP_MAX);
+}
+
+/*
+ * Check whether a source or mask picture fits in a single texture.
+ * Pixmaps can be as large as the 2D engine allows, but the texture
+ * engine can only address VIA_3D_TEX_MAX texels in each direction.
+ */
+Bool
+viaExaTexFits(PicturePtr pPict)
+{
+    if (!pPict || !pPict->pDrawable)
+        return TRUE;
+
+    return (pPict->pDrawable->width <= VIA_3D_TEX_MAX &&
+            pPict->pDrawable->height <= VIA_3D_TEX_MAX);
+}
+
+/*
+ * Emit a composite rectangle to a destination larger than the 3D clip
+ * range. The rectangle is split along a VIA_3D_TILE grid, and for each
+ * piece the destination base is moved to the tile origin so that all
+ * vertex and clip coordinates stay within 0 - VIA_3D_TILE. Tile origins
+ * are multiples of VIA_3D_TILE pixels and lines, which keeps the rebased
+ * offset as aligned as the pixmap itself.
+ */
+void
+viaExaCompositeTiled(ScrnInfoPtr pScrn, PixmapPtr pDst,
+                        int srcX, int srcY, int maskX, int maskY,
+                        int dstX, int dstY, int width, int height)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    Via3DState *v3d = &pVia->v3d;
+    unsigned long dstOffset = exaGetPixmapOffset(pDst);
+    unsigned dstPitch = exaGetPixmapPitch(pDst);
+    int cpp = pDst->drawable.bitsPerPixel >> 3;
+    int tileX, tileY, x1, y1, x2, y2;
+
+    for (tileY = dstY & ~(VIA_3D_TILE - 1); tileY < dstY + height;
+         tileY += VIA_3D_TILE) {
+        y1 = max(dstY, tileY);
+        y2 = min(dstY + height, tileY + VIA_3D_TILE);
+
+        for (tileX = dstX & ~(VIA_3D_TILE - 1); tileX < dstX + width;
+             tileX += VIA_3D_TILE) {
+            x1 = max(dstX, tileX);
+            x2 = min(dstX + width, tileX + VIA_3D_TILE);
+
+            v3d->setDestination(v3d,
+                                dstOffset + tileY * dstPitch + tileX * cpp,
+                                dstPitch, pVia->dstFormat);
+            v3d->emitState(pVia, v3d, &pVia->cb, viaCheckUpload(pScrn, v3d));
+            v3d->emitClipRect(pVia, v3d, &pVia->cb, 0, 0,
+                        min(VIA_3D_TILE, pDst->drawable.width - tileX),
+                        min(VIA_3D_TILE, pDst->drawable.height - tileY));
+            v3d->emitQuad(pVia, v3d, &pVia->cb, x1 - tileX, y1 - tileY,
+                            srcX + x1 - dstX, srcY + y1 - dstY,
+                            maskX + x1 - dstX, maskY + y1 - dstY,
+                            x2 - x1, y2 - y1);
+        }
+    }
+}
+
+/*
+ * Pack an argb8888 pixel into a solid fill pixel of the given format.
+ * The reverse of viaPixelARGB8888.
+ */
+static Bool
+viaExaPackPixel(unsigned format, CARD32 argb8888, Pixel *pixel)
+{
+    CARD32 a = argb8888 >> 24, r = (argb8888 >> 16) & 0xFF;
+    CARD32 g = (argb8888 >> 8) & 0xFF, b = argb8888 & 0xFF;
+    int bitsA = PICT_FORMAT_A(format), bitsR = PICT_FORMAT_R(format);
+    int bitsG = PICT_FORMAT_G(format), bitsB = PICT_FORMAT_B(format);
+
+    switch (PICT_FORMAT_TYPE(format)) {
+    case PICT_TYPE_A:
+        *pixel = a >> (8 - bitsA);
+        return TRUE;
+    case PICT_TYPE_ARGB:
+        *pixel = ((b >> (8 - bitsB)) |
+                  ((g >> (8 - bitsG)) << bitsB) |
+                  ((r >> (8 - bitsR)) << (bitsB + bitsG)));
+        if (bitsA)
+            *pixel |= (a >> (8 - bitsA)) << (bitsB + bitsG + bitsR);
+        return TRUE;
+    case PICT_TYPE_ABGR:
+        *pixel = ((r >> (8 - bitsR)) |
+                  ((g >> (8 - bitsG)) << bitsR) |
+                  ((b >> (8 - bitsB)) << (bitsR + bitsG)));
+        if (bitsA)
+            *pixel |= (a >> (8 - bitsA)) << (bitsB + bitsG + bitsR);
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+/*
+ * Whether copying the raw pixels of the src format gives the dst format,
+ * that is the formats are equal or differ only in an alpha channel that
+ * the destination does not have.
+ */
+static Bool
+viaExaCopyableFormat(unsigned srcFormat, unsigned dstFormat)
+{
+    if (srcFormat == dstFormat)
+        return TRUE;
+
+    return (PICT_FORMAT_A(dstFormat) == 0 &&
+            PICT_FORMAT_BPP(srcFormat) == PICT_FORMAT_BPP(dstFormat) &&
+            PICT_FORMAT_TYPE(srcFormat) == PICT_FORMAT_TYPE(dstFormat) &&
+            PICT_FORMAT_RGB(srcFormat) == PICT_FORMAT_RGB(dstFormat));
+}
+
+/*
+ * Recognize composites that are really plain copies or fills, so that
+ * they can go to the 2D engine instead of setting up the 3D engine for
+ * a quad per rectangle. The fill pixel is returned in fg.
+ */
+ViaCompositeRoute
+viaExaCompositeRoute(int op, PicturePtr pSrcPicture, PicturePtr pMaskPicture,
+                     PicturePtr pDstPicture, PixmapPtr pSrc, PixmapPtr pDst,
+                     Pixel *fg)
+{
+    CARD32 col;
+
+    if (pMaskPicture || pDstPicture->alphaMap || pSrcPicture->alphaMap)
+        return VIA_ROUTE_3D;
+
+    if (op == PictOpClear)
+        return (viaExaPackPixel(pDstPicture->format, 0, fg))
+            ? VIA_ROUTE_SOLID : VIA_ROUTE_3D;
+
+    if (op != PictOpSrc && op != PictOpOver)
+        return VIA_ROUTE_3D;
+
+    if (!pSrc) {
+        if (pSrcPicture->pSourcePict->type != SourcePictTypeSolidFill)
+            return VIA_ROUTE_3D;
+        col = pSrcPicture->pSourcePict->solidFill.color;
+    } else if (pSrcPicture->repeat && pSrc->drawable.width == 1 &&
+               pSrc->drawable.height == 1 &&
+               viaExpandablePixel(pSrcPicture->format)) {
+        viaPixelARGB8888(pSrcPicture->format, pSrc->devPrivate.ptr, &col);
+    } else {
+        if (pSrcPicture->repeat || pSrcPicture->transform || pSrc == pDst ||
+            !viaExaIsOffscreen(pSrc) ||
+            !viaExaCopyableFormat(pSrcPicture->format, pDstPicture->format))
+            return VIA_ROUTE_3D;
+        if (op == PictOpOver && PICT_FORMAT_A(pSrcPicture->format))
+            return VIA_ROUTE_3D;
+        return VIA_ROUTE_COPY;
+    }
+
+    if (op == PictOpOver && (col >> 24) != 0xFF)
+        return VIA_ROUTE_3D;
+    return (viaExaPackPixel(pDstPicture->format, col, fg))
+        ? VIA_ROUTE_SOLID : VIA_ROUTE_3D;
+}
+
+void
+viaExaReportRoutes(ScrnInfoPtr pScrn)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+
+    xf86DrvMsgVerb(pScrn->scrnIndex, X_INFO, 3,
+                   "[EXA] Composite routes: 3D %lu ops / %lu rects, "
+                   "copy %lu ops / %lu rects, solid %lu ops / %lu rects.\n",
+                   pVia->routeOps[VIA_ROUTE_3D],
+                   pVia->routeRects[VIA_ROUTE_3D],
+                   pVia->routeOps[VIA_ROUTE_COPY],
+                   pVia->routeRects[VIA_ROUTE_COPY],
+                   pVia->routeOps[VIA_ROUTE_SOLID],
+                   pVia->routeRects[VIA_ROUTE_SOLID]);
+}
+
+/*
+ * Emit a composite rectangle to an A8 destination. The alias pixel X
+ * holds A8 pixels 4X to 4X + 3 in its byte lanes, and each lane is drawn
+ * in a pass of its own with the plane mask letting through only that
+ * byte. The texture matrices map alias coordinates to picture
+ * coordinates with a horizontal stride of four, so that the center of
+ * alias pixel X samples the center of A8 pixel 4X + lane.
+ */
+static void
+viaExaCompositeA8(ScrnInfoPtr pScrn, int srcX, int srcY, int maskX, int maskY,
+                    int dstX, int dstY, int width, int height)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    Via3DState *v3d = &pVia->v3d;
+    ViaTextureUnit save[VIA_NUM_TEXUNITS];
+    ViaTextureUnit *vTex;
+    double s[3][3], m[3][3];
+    int lane, i, j, k, x1, x2;
+
+    memcpy(save, v3d->tex, sizeof(save));
+
+    for (lane = 0; lane < 4; lane++) {
+        x1 = (dstX - lane + 3) >> 2;
+        x2 = (dstX + width - lane + 3) >> 2;
+        if (x1 >= x2)
+            continue;
+
+        for (i = 0; i < v3d->numTextures; ++i) {
+            memset(s, 0, sizeof(s));
+            s[0][0] = 4.;
+            s[0][2] = lane - 1.5 - dstX + ((i) ? maskX : srcX);
+            s[1][1] = 1.;
+            s[1][2] = ((i) ? maskY : srcY) - dstY;
+            s[2][2] = 1.;
+
+            if (save[i].transform) {
+                for (j = 0; j < 3; ++j)
+                    for (k = 0; k < 3; ++k)
+                        m[j][k] = save[i].matrix[j][0] * s[0][k] +
+                                  save[i].matrix[j][1] * s[1][k] +
+                                  save[i].matrix[j][2] * s[2][k];
+                v3d->setTexMatrix(v3d, i, m);
+            } else {
+                v3d->setTexMatrix(v3d, i, s);
+            }
+        }
+
+        v3d->setDrawing(v3d, v3d->rop, (CARD32) 0xFF << (lane * 8),
+                        v3d->solidColor, v3d->solidAlpha);
+        v3d->emitState(pVia, v3d, &pVia->cb, viaCheckUpload(pScrn, v3d));
+        v3d->emitQuad(pVia, v3d, &pVia->cb, x1, dstY, x1, dstY, x1, dstY,
+                      x2 - x1, height);
+    }
+
+    for (i = 0; i < v3d->numTextures; ++i) {
+        vTex = v3d->tex + i;
+        vTex->transform = save[i].transform;
+        vTex->projective = save[i].projective;
+        memcpy(vTex->matrix, save[i].matrix, sizeof(vTex->matrix));
+    }
+}
+
+/*
+ * Emit one composite rectangle with the current state, however the
+ * destination needs to be addressed.
+ */
+static void
+viaExaEmitRect(ScrnInfoPtr pScrn, PixmapPtr pDst,
+                int srcX, int srcY, int maskX, int maskY,
+                int dstX, int dstY, int width, int height)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    Via3DState *v3d = &pVia->v3d;
+
+    if (v3d->destA8)
+        viaExaCompositeA8(pScrn, srcX, srcY, maskX, maskY,
+                            dstX, dstY, width, height);
+    else if (pVia->dstTiled)
+        viaExaCompositeTiled(pScrn, pDst, srcX, srcY, maskX, maskY,
+                                dstX, dstY, width, height);
+    else
+        v3d->emitQuad(pVia, v3d, &pVia->cb, dstX, dstY, srcX, srcY,
+                      maskX, maskY, width, height);
+}
+
+/*
+ * Component alpha masks are handled for Add directly, for OutReverse by
+ * feeding src alpha times mask color to a color-weighted blend, and for
+ * Over as OutReverse followed by Add.
+ */
+Bool
+viaExaCheckComponentAlpha(int op, PicturePtr pMaskPicture)
+{
+    if (!pMaskPicture || !pMaskPicture->componentAlpha)
+        return TRUE;
+
+    return (op == PictOpOver || op == PictOpOutReverse || op == PictOpAdd);
+}
+
+/*
+ * Set up the blend and mask texture stage for one component alpha pass.
+ */
+void
+viaExaComponentAlphaPass(ScrnInfoPtr pScrn, CARD8 op)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    Via3DState *v3d = &pVia->v3d;
+
+    v3d->setCompositeOperatorCA(v3d, op);
+    v3d->setTexBlendMode(v3d, pVia->maskTex, pVia->maskFormat,
+                         (op == PictOpAdd) ? via_comp_mask
+                                           : via_comp_mask_srcalpha);
+}
+
+/*
+ * Render operators that leave the destination untouched where the source
+ * is transparent. Only for these can a composite be clipped to the
+ * bounds of a non-repeating source.
+ */
+static Bool
+viaExaOpKeepsDst(int op)
+{
+    switch (op) {
+    case PictOpDst:
+    case PictOpOver:
+    case PictOpOverReverse:
+    case PictOpOutReverse:
+    case PictOpAtop:
+    case PictOpXor:
+    case PictOpAdd:
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+/*
+ * Check the filter and transform of the src and mask pictures. The
+ * texture engine samples nearest or bilinear. Transformed non-repeating
+ * sources are clipped to their destination space bounds, which needs an
+ * axis aligned affine transform. Projective transforms can only be
+ * interpolated correctly for a single texture.
+ */
+Bool
+viaExaCheckTransform(PicturePtr pSrcPicture, PicturePtr pMaskPicture)
+{
+    PictTransformPtr t;
+
+    if (pSrcPicture->filter >= PictFilterConvolution)
+        return FALSE;
+
+    if (pMaskPicture) {
+        if (pMaskPicture->filter >= PictFilterConvolution)
+            return FALSE;
+
+        t = pMaskPicture->transform;
+        if (t && (pMaskPicture->componentAlpha || !pMaskPicture->repeat ||
+                  t->matrix[2][0] || t->matrix[2][1] ||
+                  t->matrix[2][2] != pixman_fixed_1))
+            return FALSE;
+    }
+
+    t = pSrcPicture->transform;
+    if (!t)
+        return TRUE;
+
+    if (t->matrix[2][0] || t->matrix[2][1] ||
+        t->matrix[2][2] != pixman_fixed_1) {
+        if (pMaskPicture || !pSrcPicture->repeat)
+            return FALSE;
+    }
+
+    if (!pSrcPicture->repeat &&
+        !(t->matrix[0][1] == 0 && t->matrix[1][0] == 0) &&
+        !(t->matrix[0][0] == 0 && t->matrix[1][1] == 0))
+        return FALSE;
+
+    return TRUE;
+}
+
+/*
+ * Texture wrap mode for a picture. Untransformed non-repeating pictures
+ * are clipped by EXA, so they can keep the cheap repeat mode.
+ */
+ViaTextureModes
+viaExaRepeatMode(PicturePtr pPict)
+{
+    if (!pPict->repeat)
+        return (pPict->transform) ? via_clamp : via_repeat;
+
+    switch (pPict->repeatType) {
+    case RepeatPad:
+        return via_clamp;
+    case RepeatReflect:
+        return via_mirror;
+    default:
+        return via_repeat;
+    }
+}
+
+/*
+ * Destination space bounds of a transformed source picture, in the
+ * untransformed source coordinates EXA hands to Composite.
+ */
+static Bool
+viaExaSourceBounds(PicturePtr pPict, BoxPtr box)
+{
+    struct pixman_f_transform t, inv;
+    struct pixman_f_vector v;
+    double x1 = MAXSHORT, y1 = MAXSHORT, x2 = MINSHORT, y2 = MINSHORT;
+    int c;
+
+    pixman_f_transform_from_pixman_transform(&t, pPict->transform);
+    if (!pixman_f_transform_invert(&inv, &t))
+        return FALSE;
+
+    for (c = 0; c < 4; ++c) {
+        v.v[0] = (c & 1) ? pPict->pDrawable->width : 0;
+        v.v[1] = (c & 2) ? pPict->pDrawable->height : 0;
+        v.v[2] = 1.;
+        if (!pixman_f_transform_point(&inv, &v))
+            return FALSE;
+        x1 = min(x1, v.v[0]);
+        y1 = min(y1, v.v[1]);
+        x2 = max(x2, v.v[0]);
+        y2 = max(y2, v.v[1]);
+    }
+
+    /* Pixels whose centers map inside the source. */
+    box->x1 = max(ceil(x1 - 0.5), MINSHORT);
+    box->y1 = max(ceil(y1 - 0.5), MINSHORT);
+    box->x2 = min(floor(x2 + 0.5), MAXSHORT);
+    box->y2 = min(floor(y2 + 0.5), MAXSHORT);
+    return TRUE;
+}
+
+/*
+ * Set up filtering and transformation for a picture bound to texture
+ * unit tex, after setTexture.
+ */
+Bool
+viaExaSetTexSampling(ScrnInfoPtr pScrn, int op, PicturePtr pPict, int tex,
+                     Bool isSrc)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    Via3DState *v3d = &pVia->v3d;
+
+    if (pPict->transform || pPict->filter != PictFilterNearest)
+        v3d->setTexSampling(v3d, tex, pPict->transform,
+                            pPict->filter != PictFilterNearest &&
+                            pPict->filter != PictFilterFast);
+
+    if (isSrc && pPict->transform && !pPict->repeat) {
+        if (!viaExaSourceBounds(pPict, &pVia->srcBounds))
+            return FALSE;
+        pVia->srcBounded = TRUE;
+        pVia->srcFillOutside = !viaExaOpKeepsDst(op);
+    }
+    return TRUE;
+}
+
+/*
+ * Draw one prepared composite rectangle. Two-pass component alpha Over
+ * emits both passes back to back for each rectangle, so that overlapping
+ * rectangles of the same operation still blend in order.
+ */
+static void
+viaExaCompositePasses(ScrnInfoPtr pScrn, PixmapPtr pDst,
+                        int srcX, int srcY, int maskX, int maskY,
+                        int dstX, int dstY, int width, int height)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    Via3DState *v3d = &pVia->v3d;
+    int pass;
+
+    for (pass = 0; pass < (pVia->caTwoPass ? 2 : 1); pass++) {
+        if (pVia->caTwoPass) {
+            viaExaComponentAlphaPass(pScrn, (pass) ? PictOpAdd
+                                                   : PictOpOutReverse);
+            v3d->emitState(pVia, v3d, &pVia->cb, viaCheckUpload(pScrn, v3d));
+        }
+
+        viaExaEmitRect(pScrn, pDst, srcX, srcY, maskX, maskY,
+                        dstX, dstY, width, height);
+    }
+}
+
+/*
+ * Draw the part of a bounded composite that lies outside the source, as
+ * the operator applied to a transparent source.
+ */
+static void
+viaExaCompositeOutside(ScrnInfoPtr pScrn, PixmapPtr pDst,
+                        int dstX, int dstY, int width, int height)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    Via3DState *v3d = &pVia->v3d;
+    int numTex = v3d->numTextures;
+    CARD32 solidColor = v3d->solidColor, solidAlpha = v3d->solidAlpha;
+
+    if (width <= 0 || height <= 0)
+        return;
+
+    v3d->setFlags(v3d, 0, FALSE, TRUE, TRUE);
+    v3d->setDrawing(v3d, 0x0c, 0xFFFFFFFF, 0x00000000, 0x00);
+    v3d->emitState(pVia, v3d, &pVia->cb, viaCheckUpload(pScrn, v3d));
+
+    viaExaEmitRect(pScrn, pDst, 0, 0, 0, 0, dstX, dstY, width, height);
+
+    v3d->setFlags(v3d, numTex, FALSE, TRUE, TRUE);
+    v3d->setDrawing(v3d, 0x0c, 0xFFFFFFFF, solidColor, solidAlpha);
+    v3d->emitState(pVia, v3d, &pVia->cb, viaCheckUpload(pScrn, v3d));
+}
+
+/*
+ * Draw one prepared composite rectangle, clipped to the bounds of a
+ * transformed non-repeating source when there is one.
+ */
+void
+viaExaCompositeRect(ScrnInfoPtr pScrn, PixmapPtr pDst,
+                    int srcX, int srcY, int maskX, int maskY,
+                    int dstX, int dstY, int width, int height)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    BoxPtr b = &pVia->srcBounds;
+    int x1, y1, x2, y2;
+
+    if (!pVia->srcBounded) {
+        viaExaCompositePasses(pScrn, pDst, srcX, srcY, maskX, maskY,
+                                dstX, dstY, width, height);
+        return;
+    }
+
+    x1 = max(srcX, b->x1);
+    y1 = max(srcY, b->y1);
+    x2 = min(srcX + width, b->x2);
+    y2 = min(srcY + height, b->y2);
+
+    if (x1 >= x2 || y1 >= y2) {
+        if (pVia->srcFillOutside)
+            viaExaCompositeOutside(pScrn, pDst, dstX, dstY, width, height);
+        return;
+    }
+
+    viaExaCompositePasses(pScrn, pDst, x1, y1,
+                            maskX + x1 - srcX, maskY + y1 - srcY,
+                            dstX + x1 - srcX, dstY + y1 - srcY,
+                            x2 - x1, y2 - y1);
+
+    if (pVia->srcFillOutside) {
+        x1 -= srcX;
+        y1 -= srcY;
+        x2 -= srcX;
+        y2 -= srcY;
+        viaExaCompositeOutside(pScrn, pDst, dstX, dstY, width, y1);
+        viaExaCompositeOutside(pScrn, pDst, dstX, dstY + y2,
+                                width, height - y2);
+        viaExaCompositeOutside(pScrn, pDst, dstX, dstY + y1,
+                                x1, y2 - y1);
+        viaExaCompositeOutside(pScrn, pDst, dstX + x2, dstY + y1,
+                                width - x2, y2 - y1);
+    }
+}
+
 #ifdef VIA_DEBUG_COMPOSITE
 void
 viaExaCompositePictDesc(PicturePtr pict, char *string, int n)
@@ -467,6 +1080,10 @@ viaAccelSync(ScrnInfoPtr pScrn)
     VIAPtr pVia = VIAPTR(pScrn);
     int loop = 0;
 
+    VIA_COUNT(pVia, VIA_COUNTER_SYNCS, 1);
+    if (pVia->ring.running)
+        viaRingWaitIdle(pVia);
+
     mem_barrier();
 
     switch (pVia->Chipset) {
@@ -495,26 +1112,8 @@ viaAccelSync(ScrnInfoPtr pScrn)
     }
 }
 
-/*
- * Wait for the value to get blitted, or in the PCI case for engine idle.
- */
-static void
-viaAccelWaitMarker(ScreenPtr pScreen, int marker)
-{
-    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
-    VIAPtr pVia = VIAPTR(pScrn);
-    CARD32 uMarker = marker;
-
-    if (pVia->agpDMA) {
-        while ((pVia->lastMarkerRead - uMarker) > (1 << 24))
-            pVia->lastMarkerRead = *(CARD32 *) pVia->markerBuf;
-    } else {
-        viaAccelSync(pScrn);
-    }
-}
-
 #ifdef OPENCHROMEDRI
-static int
+int
 viaAccelDMADownload(ScrnInfoPtr pScrn, unsigned long fbOffset,
                     unsigned srcPitch, unsigned char *dst,
                     unsigned dstPitch, unsigned w, unsigned h)
@@ -599,6 +1198,21 @@ viaAccelDMADownload(ScrnInfoPtr pScrn, unsigned long fbOffset,
     return ret;
 }
 
+/*
+ * PCI DMA from system memory to the framebuffer, see via_dma_upload.c.
+ */
+int
+viaAccelDMAUpload(ScrnInfoPtr pScrn, unsigned long fbOffset,
+                  unsigned dstPitch, unsigned char *src,
+                  unsigned srcPitch, unsigned w, unsigned h)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+
+    return viaDMAUploadBlits(pVia->drmmode.fd,
+                             (unsigned char *)pVia->dBounce, VIA_DMA_DL_SIZE,
+                             fbOffset, dstPitch, src, srcPitch, w, h);
+}
+
 /*
  * Use PCI DMA if we can. If the system alignments don't match, we're using
  * an aligned bounce buffer for pipelined PCI DMA and memcpy.
@@ -614,6 +1228,7 @@ viaExaDownloadFromScreen(PixmapPtr pSrc, int x, int y, int w, int h,
     char *bounceAligned = NULL;
     VIAPtr pVia = VIAPTR(pScrn);
     unsigned totSize;
+    CARD64 start;
 
     if (!w || !h)
         return TRUE;
@@ -626,7 +1241,8 @@ viaExaDownloadFromScreen(PixmapPtr pSrc, int x, int y, int w, int h,
     totSize = wBytes * h;
 
     exaWaitSync(pScrn->pScreen);
-    if (totSize < VIA_MIN_DOWNLOAD) {
+    start = viaCostTime();
+    if (totSize < pVia->cost.minDownload) {
         bounceAligned = (char *) drm_bo_map(pScrn, pVia->drmmode.front_bo) + srcOffset;
 
         while (h--) {
@@ -634,6 +1250,7 @@ viaExaDownloadFromScreen(PixmapPtr pSrc, int x, int y, int w, int h,
             dst += dst_pitch;
             bounceAligned += srcPitch;
         }
+        viaCostSample(pVia, &pVia->cost.cpuRead, totSize, start);
         return TRUE;
     }
 
@@ -649,13 +1266,15 @@ viaExaDownloadFromScreen(PixmapPtr pSrc, int x, int y, int w, int h,
                             dst_pitch, wBytes, h))
         return FALSE;
 
+    viaCostSample(pVia, &pVia->cost.dmaRead, totSize, start);
     return TRUE;
 }
 
 /*
  * Upload to framebuffer memory using memcpy to AGP pipelined with a
  * 3D engine texture operation from AGP to framebuffer. The AGP buffers (2)
- * should be kept rather small for optimal pipelining.
+ * should be kept rather small for optimal pipelining. Returns FALSE for
+ * uploads the texture engine can't do.
  */
 static Bool
 viaExaTexUploadToScreen(PixmapPtr pDst, int x, int y, int w, int h, char *src,
@@ -669,30 +1288,15 @@ viaExaTexUploadToScreen(PixmapPtr pDst, int x, int y, int w, int h, char *src,
     VIAPtr pVia = VIAPTR(pScrn);
     Via3DState *v3d = &pVia->v3d;
     char *dst, *texAddr;
+    unsigned long texOffset;
+    unsigned totSize = wBytes * h;
+    CARD64 start;
     Bool buf;
 
-    if (!w || !h)
-        return TRUE;
-
-    if (wBytes * h < VIA_MIN_TEX_UPLOAD) {
-        dstOffset = x * pDst->drawable.bitsPerPixel;
-        if (dstOffset & 3)
-            return FALSE;
-
-        dst = (char *) drm_bo_map(pScrn, pVia->drmmode.front_bo) +
-                        (exaGetPixmapOffset(pDst) + y * dstPitch +
-                        (dstOffset >> 3));
-        exaWaitSync(pScrn->pScreen);
-
-        while (h--) {
-            memcpy(dst, src, wBytes);
-            dst += dstPitch;
-            src += src_pitch;
-        }
-        return TRUE;
-    }
+    if (!pVia->texAGPBuffer || !pVia->texAGPBuffer->ptr)
+        return FALSE;
 
-    if (!pVia->texAGPBuffer->ptr)
+    if (w > VIA_3D_TEX_MAX || viaExaTiledDst(pDst))
         return FALSE;
 
     switch (pDst->drawable.bitsPerPixel) {
@@ -726,12 +1330,13 @@ viaExaTexUploadToScreen(PixmapPtr pDst, int x, int y, int w, int h, char *src,
 
     texHeight = height << 1;
     bufOffs = texPitch * height;
-    texAddr = (char *) drm_bo_map(pScrn, pVia->texAGPBuffer);
+    texAddr = (char *) pVia->texAGPBuffer->ptr;
+    texOffset = pVia->texAGPBuffer->offset + pVia->agpAddr;
 
     v3d->setDestination(v3d, dstOffset, dstPitch, format);
     v3d->setDrawing(v3d, 0x0c, 0xFFFFFFFF, 0x000000FF, 0x00);
     v3d->setFlags(v3d, 1, TRUE, TRUE, FALSE);
-    if (!v3d->setTexture(v3d, 0, (unsigned long) texAddr, texPitch,
+    if (!v3d->setTexture(v3d, 0, texOffset, texPitch,
                          pVia->nPOT[0], texWidth, texHeight, format,
                          via_single, via_single, via_src, TRUE))
         return FALSE;
@@ -744,6 +1349,7 @@ viaExaTexUploadToScreen(PixmapPtr pDst, int x, int y, int w, int h, char *src,
     yOffs = 0;
     sync[0] = -1;
     sync[1] = -1;
+    start = viaCostTime();
 
     while (h) {
         buf = (buf) ? 0 : 1;
@@ -771,11 +1377,116 @@ viaExaTexUploadToScreen(PixmapPtr pDst, int x, int y, int w, int h, char *src,
     if (sync[buf] >= 0)
         pVia->exaDriverPtr->WaitMarker(pScrn->pScreen, sync[buf]);
 
+    viaCostSample(pVia, &pVia->cost.texUpload, totSize, start);
+    return TRUE;
+}
+
+/*
+ * Upload by PCI DMA. Returns FALSE for uploads the DMA engine can't do.
+ */
+static Bool
+viaExaDMAUploadToScreen(PixmapPtr pDst, int x, int y, int w, int h,
+                        char *src, int src_pitch)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pDst->drawable.pScreen);
+    unsigned wBytes = (pDst->drawable.bitsPerPixel * w + 7) >> 3;
+    unsigned dstPitch = exaGetPixmapPitch(pDst), dstOffset;
+    VIAPtr pVia = VIAPTR(pScrn);
+    CARD64 start;
+
+    if (!pVia->dBounce)
+        return FALSE;
+
+    dstOffset = x * pDst->drawable.bitsPerPixel;
+    if (dstOffset & 3)
+        return FALSE;
+    dstOffset = exaGetPixmapOffset(pDst) + y * dstPitch + (dstOffset >> 3);
+
+    if ((dstPitch & 3) || (dstOffset & 3))
+        return FALSE;
+
+    exaWaitSync(pScrn->pScreen);
+    start = viaCostTime();
+    if (viaAccelDMAUpload(pScrn, dstOffset, dstPitch, (unsigned char *)src,
+                          src_pitch, wBytes, h))
+        return FALSE;
+
+    viaCostSample(pVia, &pVia->cost.dmaWrite, wBytes * h, start);
     return TRUE;
 }
 
 #endif /* OPENCHROMEDRI */
 
+/*
+ * Upload by writing through the write-combined framebuffer mapping.
+ */
+static Bool
+viaExaMemcpyUploadToScreen(PixmapPtr pDst, int x, int y, int w, int h,
+                            char *src, int src_pitch)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pDst->drawable.pScreen);
+    unsigned wBytes = (w * pDst->drawable.bitsPerPixel + 7) >> 3;
+    unsigned dstPitch = exaGetPixmapPitch(pDst), dstOffset;
+    VIAPtr pVia = VIAPTR(pScrn);
+    unsigned totSize = wBytes * h;
+    CARD64 start;
+    char *dst;
+
+    dstOffset = x * pDst->drawable.bitsPerPixel;
+    if (dstOffset & 3)
+        return FALSE;
+
+    dst = (char *) drm_bo_map(pScrn, pVia->drmmode.front_bo) +
+                    (exaGetPixmapOffset(pDst) + y * dstPitch +
+                    (dstOffset >> 3));
+    exaWaitSync(pScrn->pScreen);
+    start = viaCostTime();
+
+    while (h--) {
+        memcpy(dst, src, wBytes);
+        dst += dstPitch;
+        src += src_pitch;
+    }
+    viaCostSample(pVia, &pVia->cost.cpuWrite, totSize, start);
+    return TRUE;
+}
+
+/*
+ * Pick the upload path by size, see viaUploadPaths(). The engine paths
+ * hand back what they can't do to the memcpy path.
+ * tools/via_upload_test.c runs the same choice and checks the DMA path
+ * against the memcpy result.
+ */
+static Bool
+viaExaUploadToScreen(PixmapPtr pDst, int x, int y, int w, int h, char *src,
+                     int src_pitch)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pDst->drawable.pScreen);
+    VIAPtr pVia = VIAPTR(pScrn);
+    unsigned totSize = ((w * pDst->drawable.bitsPerPixel + 7) >> 3) * h;
+#ifdef OPENCHROMEDRI
+    unsigned paths;
+#endif
+
+    if (!w || !h)
+        return TRUE;
+
+#ifdef OPENCHROMEDRI
+    paths = viaUploadPaths(pVia->uploadPaths, totSize,
+                           pVia->cost.minTexUpload, pVia->cost.minDmaUpload);
+
+    if ((paths & VIA_UPLOAD_AGP) &&
+        viaExaTexUploadToScreen(pDst, x, y, w, h, src, src_pitch))
+        return TRUE;
+
+    if ((paths & VIA_UPLOAD_DMA) &&
+        viaExaDMAUploadToScreen(pDst, x, y, w, h, src, src_pitch))
+        return TRUE;
+#endif
+
+    return viaExaMemcpyUploadToScreen(pDst, x, y, w, h, src, src_pitch);
+}
+
 int
 viaEXAOffscreenAlloc(ScrnInfoPtr pScrn, struct buffer_object *obj,
                         unsigned long size, unsigned long alignment)
@@ -859,6 +1570,8 @@ viaInitExa(ScreenPtr pScreen)
     pVia->nPOT[0] = nPOTSupported;
     pVia->nPOT[1] = nPOTSupported;
 
+    viaCostModelDefaults(pScrn);
+
     if (Success != viaSetupCBuffer(pVia, &pVia->cb, 0)) {
         pVia->NoAccel = TRUE;
         return FALSE;
@@ -883,7 +1596,9 @@ viaInitExa(ScreenPtr pScreen)
     /*  HW Limitation are described here:
      *
      *  1. H2/H5/H6 2D source and destination:
-     *     Pitch: (1 << 14) - 1 = 16383
+     *     Pitch: (1 << 14) - 1 = 16383, programmed in quadwords through
+     *            VIA_REG_PITCH (0x38, H2) or VIA_REG_PITCH_M1 (0x08, H6),
+     *            destination in bits 16 and up, source in the low bits.
      *     Dimension: (1 << 12) = 4096
      *     X, Y position: (1 << 12) - 1 = 4095.
      *
@@ -895,9 +1610,17 @@ viaInitExa(ScreenPtr pScreen)
      *     Pitch: ((1 << 10) - 1)*32 = 32736
      *     Clip Rectangle: Color Window, 12bits. As Spec saied: 0 - 2048
      *                     Scissor is the same as color window.
+     *
+     *  Every pixmap can be a 2D source or destination, so the pixmap limits
+     *  follow the 2D engine: the pitch is capped at VIA_2D_PITCH_MAX, below
+     *  the larger H5/H6 3D limit. Composites to targets beyond the 3D clip
+     *  rectangle are tiled, see viaExaCompositeTiled.
      */
-    pExa->maxX = 2047;
-    pExa->maxY = 2047;
+    pExa->maxX = 4095;
+    pExa->maxY = 4095;
+#if (EXA_VERSION_MAJOR > 2) || (EXA_VERSION_MINOR >= 5)
+    pExa->maxPitchBytes = VIA_2D_PITCH_MAX;
+#endif
     pExa->WaitMarker = viaAccelWaitMarker;
 
     switch (pVia->Chipset) {
@@ -923,6 +1646,8 @@ viaInitExa(ScreenPtr pScreen)
         break;
     }
 
+    pExa->UploadToScreen = viaExaUploadToScreen;
+    pVia->uploadPaths = 0;
 #ifdef OPENCHROMEDRI
     if (pVia->directRenderingType == DRI_1) {
 #ifdef linux
@@ -931,10 +1656,12 @@ viaInitExa(ScreenPtr pScreen)
         switch (pVia->Chipset) {
         case VIA_K8M800:
         case VIA_KM400:
-            pExa->UploadToScreen = NULL; //viaExaTexUploadToScreen;
+            pVia->uploadPaths = viaUploadPathsInit(TRUE, pVia->IsPCI,
+                                                   pVia->exaAGPUpload);
             break;
         default:
-            pExa->UploadToScreen = NULL; //viaExaUploadToScreen;
+            pVia->uploadPaths = viaUploadPathsInit(FALSE, pVia->IsPCI,
+                                                   pVia->exaAGPUpload);
             break;
         }
     }
@@ -962,6 +1689,8 @@ viaInitExa(ScreenPtr pScreen)
                    "[EXA] Disabling EXA accelerated composite.\n");
     }
 
+    viaExaRejectInit(pScrn);
+    viaCountersWrapExa(pVia, pExa);
     if (!exaDriverInit(pScreen, pExa)) {
         free(pExa);
         return FALSE;
@@ -989,12 +1718,15 @@ viaFinishInitAccel(ScreenPtr pScreen)
 #ifdef OPENCHROMEDRI
     if (pVia->directRenderingType && pVia->useEXA) {
 
-        pVia->dBounce = calloc(VIA_DMA_DL_SIZE * 2, 1);
+        /* Two halves plus room to align them to 16 bytes. */
+        pVia->dBounce = calloc(VIA_DMA_DL_SIZE * 2 + 16, 1);
+        if (!pVia->dBounce)
+            pVia->uploadPaths &= ~VIA_UPLOAD_DMA;
 
         if (!pVia->IsPCI) {
 
             /* Allocate upload and scratch space. */
-            if (pVia->exaDriverPtr->UploadToScreen == viaExaTexUploadToScreen) {
+            if (pVia->uploadPaths & VIA_UPLOAD_AGP) {
                 size = VIA_AGP_UPL_SIZE * 2;
 
                 pVia->texAGPBuffer = drm_bo_alloc(pScrn, size, 32, TTM_PL_TT);
@@ -1004,6 +1736,9 @@ viaFinishInitAccel(ScreenPtr pScreen)
                                "system-to-framebuffer transfer.\n",
                                size / 1024);
                     pVia->texAGPBuffer->offset = (pVia->texAGPBuffer->offset + 31) & ~31;
+                    drm_bo_map(pScrn, pVia->texAGPBuffer);
+                } else {
+                    pVia->uploadPaths &= ~VIA_UPLOAD_AGP;
                 }
             }
 
@@ -1033,6 +1768,9 @@ viaFinishInitAccel(ScreenPtr pScreen)
         }
     }
     memset(pVia->markerBuf, 0, pVia->exa_sync_bo->size);
+
+    if (pVia->useEXA && pVia->exaDriverPtr)
+        viaCostModelInit(pScreen);
 }
 
 /*
@@ -1045,9 +1783,15 @@ viaExitAccel(ScreenPtr pScreen)
     VIAPtr pVia = VIAPTR(pScrn);
 
     viaAccelSync(pScrn);
+    viaRingFini(pScrn);
     viaTearDownCBuffer(&pVia->cb);
 
     if (pVia->useEXA) {
+        viaCostModelReport(pScrn);
+        viaExaReportRoutes(pScrn);
+        viaExaRejectFini(pScrn);
+        viaExaGradientFini(pScreen);
+
 #ifdef OPENCHROMEDRI
         if (pVia->directRenderingType == DRI_1) {
             if (pVia->texAGPBuffer) {
@@ -0,0 +1,387 @@
+/*
+ * Copyright 2026 The OpenChrome Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Cost model for deciding whether an EXA operation is worth handing to
+ * the engines or is done faster by the CPU.
+ *
+ * Every way of doing something is modelled as a fixed cost plus a cost
+ * per pixel or byte. The two are fitted by least squares over decayed
+ * sums, first from short benchmarks run when acceleration is set up and
+ * then from the timings of real submissions, syncs and transfers. The
+ * size at which the engine path becomes cheaper than the CPU path is the
+ * threshold consulted by the Check and transfer hooks.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "via_driver.h"
+
+/* Weight of old samples; about the last 50 samples count. */
+#define VIA_COST_DECAY      0.98
+
+/* Recompute the thresholds after this many samples. */
+#define VIA_COST_INTERVAL   256
+
+/* Threshold meaning "never worth it". */
+#define VIA_COST_NEVER      (1U << 30)
+
+/* A blended pixel costs the 3D engine about a read and a write. */
+#define VIA_COST_BLEND      2.
+
+#define VIA_COST_BENCH_W    256
+#define VIA_COST_BENCH_H    256
+#define VIA_COST_BENCH_SIZE (VIA_COST_BENCH_W * VIA_COST_BENCH_H * 4)
+
+CARD64
+viaCostTime(void)
+{
+    return GetTimeInMicros();
+}
+
+static void
+viaCostFit(ViaCost *cost, double units, double us)
+{
+    double det;
+
+    cost->n = cost->n * VIA_COST_DECAY + 1.;
+    cost->sx = cost->sx * VIA_COST_DECAY + units;
+    cost->sy = cost->sy * VIA_COST_DECAY + us;
+    cost->sxx = cost->sxx * VIA_COST_DECAY + units * units;
+    cost->sxy = cost->sxy * VIA_COST_DECAY + units * us;
+
+    /*
+     * With samples of a single size only the fixed part can be fitted,
+     * keep the per unit cost from before.
+     */
+    det = cost->n * cost->sxx - cost->sx * cost->sx;
+    if (det > 1e-6 * cost->n * cost->sxx) {
+        double perUnit = (cost->n * cost->sxy - cost->sx * cost->sy) / det;
+
+        if (perUnit >= 0.)
+            cost->perUnit = perUnit;
+    }
+    cost->fixed = (cost->sy - cost->perUnit * cost->sx) / cost->n;
+    if (cost->fixed < 0.)
+        cost->fixed = 0.;
+}
+
+/*
+ * Size above which the engine path is cheaper than the CPU path.
+ */
+static unsigned
+viaCostCrossover(double cpuFixed, double cpuPerUnit,
+                 double gpuFixed, double gpuPerUnit)
+{
+    double n;
+
+    if (cpuPerUnit <= gpuPerUnit)
+        return VIA_COST_NEVER;
+
+    n = (gpuFixed - cpuFixed) / (cpuPerUnit - gpuPerUnit);
+    if (n < 1.)
+        return 1;
+    if (n > VIA_COST_NEVER)
+        return VIA_COST_NEVER;
+    return (unsigned) n;
+}
+
+static void
+viaCostUpdate(VIAPtr pVia)
+{
+    ViaCostModel *m = &pVia->cost;
+    double cpp = m->cpp;
+    double gpuFixed;
+
+    if (!m->calibrated)
+        return;
+
+    /*
+     * A software composite waits for the engines, then reads back and
+     * writes the destination through the CPU. A 3D composite costs a
+     * submission plus roughly a blended fill.
+     */
+    gpuFixed = m->submit.fixed;
+    m->minComposite =
+        viaCostCrossover(m->sync.fixed + m->cpuBlend.fixed,
+                         m->cpuBlend.perUnit +
+                         cpp * (m->cpuRead.perUnit + m->cpuWrite.perUnit),
+                         gpuFixed,
+                         VIA_COST_BLEND * m->gpuFill.perUnit);
+
+    if (m->dmaRead.n > 0.)
+        m->minDownload =
+            viaCostCrossover(m->cpuRead.fixed, m->cpuRead.perUnit,
+                             m->dmaRead.fixed, m->dmaRead.perUnit);
+
+    if (m->dmaWrite.n > 0.)
+        m->minDmaUpload =
+            viaCostCrossover(m->cpuWrite.fixed, m->cpuWrite.perUnit,
+                             m->dmaWrite.fixed, m->dmaWrite.perUnit);
+
+    /*
+     * Until real texture uploads have been timed, model one as a copy
+     * to AGP memory followed by a textured fill.
+     */
+    if (m->texUpload.n > 0.)
+        m->minTexUpload =
+            viaCostCrossover(m->cpuWrite.fixed, m->cpuWrite.perUnit,
+                             m->texUpload.fixed, m->texUpload.perUnit);
+    else
+        m->minTexUpload =
+            viaCostCrossover(m->cpuWrite.fixed, m->cpuWrite.perUnit,
+                             gpuFixed + m->sync.fixed,
+                             m->sysWrite.perUnit +
+                             m->gpuFill.perUnit / cpp);
+}
+
+/*
+ * Account one measurement of cost, taken from start until now.
+ */
+void
+viaCostSample(VIAPtr pVia, ViaCost *cost, double units, CARD64 start)
+{
+    viaCostFit(cost, units, (double) (viaCostTime() - start));
+
+    if ((++pVia->cost.samples % VIA_COST_INTERVAL) == 0)
+        viaCostUpdate(pVia);
+}
+
+/*
+ * Fixed thresholds to use until the model has been calibrated.
+ */
+void
+viaCostModelDefaults(ScrnInfoPtr pScrn)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+
+    memset(&pVia->cost, 0, sizeof(pVia->cost));
+    pVia->cost.cpp = pScrn->bitsPerPixel >> 3;
+    pVia->cost.minComposite = VIA_MIN_COMPOSITE;
+    pVia->cost.minDownload = VIA_MIN_DOWNLOAD;
+    pVia->cost.minTexUpload = VIA_MIN_TEX_UPLOAD;
+    pVia->cost.minDmaUpload = VIA_MIN_UPLOAD;
+}
+
+static void
+viaCostBenchCopy(VIAPtr pVia, ViaCost *cost,
+                 unsigned char *dst, unsigned char *src)
+{
+    static const unsigned sizes[] = { 4096, VIA_COST_BENCH_SIZE };
+    CARD64 start;
+    int i, j;
+
+    for (j = 0; j < 4; j++) {
+        for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            start = viaCostTime();
+            memcpy(dst, src, sizes[i]);
+            viaCostSample(pVia, cost, sizes[i], start);
+        }
+    }
+}
+
+static void
+viaCostBenchBlend(ScrnInfoPtr pScrn)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    static const int sizes[] = { 8, 64 };
+    pixman_image_t *src, *dst;
+    CARD64 start;
+    int i, j, k;
+
+    src = pixman_image_create_bits(PIXMAN_a8r8g8b8, 64, 64, NULL, 0);
+    dst = pixman_image_create_bits(PIXMAN_a8r8g8b8, 64, 64, NULL, 0);
+
+    if (src && dst) {
+        memset(pixman_image_get_data(src), 0x80, 64 * 64 * 4);
+        for (j = 0; j < 4; j++) {
+            for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+                start = viaCostTime();
+                for (k = 0; k < 16; k++)
+                    pixman_image_composite(PIXMAN_OP_OVER, src, NULL, dst,
+                                           0, 0, 0, 0, 0, 0,
+                                           sizes[i], sizes[i]);
+                viaCostFit(&pVia->cost.cpuBlend, sizes[i] * sizes[i],
+                           (double) (viaCostTime() - start) / 16.);
+            }
+        }
+    }
+
+    if (src)
+        pixman_image_unref(src);
+    if (dst)
+        pixman_image_unref(dst);
+}
+
+static void
+viaCostBenchEngine(ScreenPtr pScreen, unsigned char *vram)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    VIAPtr pVia = VIAPTR(pScrn);
+    ExaDriverPtr pExa = pVia->exaDriverPtr;
+    static const int sizes[] = { 16, VIA_COST_BENCH_H };
+    int cpp = pScrn->bitsPerPixel >> 3;
+    PixmapPtr pPix;
+    CARD64 start;
+    int i, j;
+
+    /*
+     * Submission and sync times are sampled by the hooks themselves. Syncs
+     * with nothing submitted return at once and aren't sampled, so the
+     * fills below provide the sync samples as well.
+     */
+    pPix = GetScratchPixmapHeader(pScreen, VIA_COST_BENCH_W,
+                                  VIA_COST_BENCH_SIZE /
+                                  (VIA_COST_BENCH_W * 4),
+                                  pScrn->depth, pScrn->bitsPerPixel,
+                                  VIA_COST_BENCH_W * cpp, vram);
+    if (!pPix)
+        return;
+
+    for (j = 0; j < 4; j++) {
+        for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            start = viaCostTime();
+            if (pExa->PrepareSolid(pPix, GXcopy, ~0, 0)) {
+                pExa->Solid(pPix, 0, 0, sizes[i], sizes[i]);
+                pExa->DoneSolid(pPix);
+            }
+            pExa->WaitMarker(pScreen, pExa->MarkSync(pScreen));
+            viaCostSample(pVia, &pVia->cost.gpuFill,
+                          sizes[i] * sizes[i], start);
+        }
+    }
+
+    FreeScratchPixmapHeader(pPix);
+}
+
+#ifdef OPENCHROMEDRI
+static void
+viaCostBenchDMA(ScrnInfoPtr pScrn, unsigned long fbOffset,
+                unsigned char *sys)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    static const unsigned lines[] = { 4, VIA_COST_BENCH_H };
+    unsigned pitch = VIA_COST_BENCH_W * 4;
+    CARD64 start;
+    int i, j;
+
+    for (j = 0; j < 4; j++) {
+        for (i = 0; i < sizeof(lines) / sizeof(lines[0]); i++) {
+            start = viaCostTime();
+            if (viaAccelDMADownload(pScrn, fbOffset, pitch, sys, pitch,
+                                    pitch, lines[i]))
+                return;
+            viaCostSample(pVia, &pVia->cost.dmaRead,
+                          pitch * lines[i], start);
+
+            if (!(pVia->uploadPaths & VIA_UPLOAD_DMA))
+                continue;
+            start = viaCostTime();
+            if (viaAccelDMAUpload(pScrn, fbOffset, pitch, sys, pitch,
+                                  pitch, lines[i]))
+                return;
+            viaCostSample(pVia, &pVia->cost.dmaWrite,
+                          pitch * lines[i], start);
+        }
+    }
+}
+#endif
+
+/*
+ * Calibrate the model with short benchmarks. Needs a scratch area of
+ * offscreen memory, so run it once EXA is up.
+ */
+void
+viaCostModelInit(ScreenPtr pScreen)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    VIAPtr pVia = VIAPTR(pScrn);
+    ExaOffscreenArea *pArea;
+    unsigned char *sys, *sys2, *vram;
+
+    pArea = exaOffscreenAlloc(pScreen, VIA_COST_BENCH_SIZE, 32, TRUE,
+                              NULL, NULL);
+    sys = malloc(VIA_COST_BENCH_SIZE + 16);
+    sys2 = malloc(VIA_COST_BENCH_SIZE);
+    if (!pArea || !sys || !sys2) {
+        xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+                   "Could not calibrate the acceleration cost model, "
+                   "using fixed thresholds.\n");
+        goto out;
+    }
+
+    vram = (unsigned char *) pVia->FBBase + pArea->offset;
+    memset(sys, 0, VIA_COST_BENCH_SIZE);
+    memset(sys2, 0, VIA_COST_BENCH_SIZE);
+
+    pVia->exaDriverPtr->WaitMarker(pScreen,
+                                   pVia->exaDriverPtr->MarkSync(pScreen));
+
+    viaCostBenchCopy(pVia, &pVia->cost.cpuRead, sys, vram);
+    viaCostBenchCopy(pVia, &pVia->cost.cpuWrite, vram, sys);
+    viaCostBenchCopy(pVia, &pVia->cost.sysWrite, sys2, sys);
+    viaCostBenchBlend(pScrn);
+    viaCostBenchEngine(pScreen, vram);
+#ifdef OPENCHROMEDRI
+    if (pVia->directRenderingType && pVia->dBounce)
+        viaCostBenchDMA(pScrn, pArea->offset,
+                        (unsigned char *) ALIGN_TO((unsigned long) sys, 16));
+#endif
+
+    pVia->cost.calibrated = TRUE;
+    viaCostUpdate(pVia);
+    viaCostModelReport(pScrn);
+
+out:
+    free(sys);
+    free(sys2);
+    if (pArea)
+        exaOffscreenFree(pScreen, pArea);
+}
+
+void
+viaCostModelReport(ScrnInfoPtr pScrn)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    ViaCostModel *m = &pVia->cost;
+
+    xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+               "Acceleration thresholds%s: composite %u pixels, "
+               "download %u bytes, texture upload %u bytes, "
+               "DMA upload %u bytes.\n",
+               (m->calibrated) ? "" : " (not calibrated)",
+               m->minComposite, m->minDownload, m->minTexUpload,
+               m->minDmaUpload);
+    xf86DrvMsgVerb(pScrn->scrnIndex, X_INFO, 4,
+                   "Cost model: submit %.1f us, sync %.1f us, "
+                   "fill %.4f us/px, blend %.4f us/px, "
+                   "VRAM read %.4f us/kB, VRAM write %.4f us/kB, "
+                   "DMA read %.1f us + %.4f us/kB, %lu samples.\n",
+                   m->submit.fixed, m->sync.fixed,
+                   m->gpuFill.perUnit, m->cpuBlend.perUnit,
+                   m->cpuRead.perUnit * 1024., m->cpuWrite.perUnit * 1024.,
+                   m->dmaRead.fixed, m->dmaRead.perUnit * 1024.,
+                   m->samples);
+}
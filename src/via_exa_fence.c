@@ -0,0 +1,147 @@
+/*
+ * Copyright 2026 The OpenChrome Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * EXA markers.
+ *
+ * A marker is a sequence number. MarkSync only hands out a new one when
+ * commands were queued since the previous marker, so the back to back
+ * MarkSync/WaitMarker pairs EXA issues around CPU access cost nothing
+ * once the engines have caught up.
+ *
+ * With AGP DMA the command regulator executes the 2D and 3D streams in
+ * order, and a marker is a one pixel 2D fill that writes the sequence
+ * number to markerBuf. A wait compares against the last value read
+ * before it reads VRAM, and polls until the fill has landed. Over MMIO
+ * the 3D engine runs unordered with respect to the 2D engine, so a
+ * marker is only a count and waiting for one that has not passed means
+ * waiting for idle, after which all markers have passed.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "via_driver.h"
+
+#define VIA_MARKER_MASK     0x7FFFFFFF
+
+/* Polls of markerBuf before falling back to waiting for idle. */
+#define VIA_MARKER_POLLS    1000
+
+void
+viaMarkerInit(VIAPtr pVia)
+{
+    pVia->curMarker = 0;
+    pVia->lastMarkerRead = 0;
+    pVia->markerPending = FALSE;
+    if (pVia->markerBuf)
+        *(volatile CARD32 *) pVia->markerBuf = 0;
+}
+
+/*
+ * Called by the flush functions for every submission.
+ */
+void
+viaMarkerSubmitted(VIAPtr pVia)
+{
+    pVia->markerPending = TRUE;
+}
+
+/*
+ * Hand out the next marker. Returns FALSE if nothing was submitted or
+ * queued since the current one, which then covers the caller as well.
+ */
+Bool
+viaMarkerNext(VIAPtr pVia)
+{
+    if (!pVia->markerPending && !pVia->cb.pos)
+        return FALSE;
+
+    /* Wrap around without affecting the sign bit. */
+    pVia->curMarker = (pVia->curMarker + 1) & VIA_MARKER_MASK;
+    return TRUE;
+}
+
+/*
+ * The marker has been written or emitted, anything submitted from here
+ * on needs a new one.
+ */
+void
+viaMarkerEmitted(VIAPtr pVia)
+{
+    pVia->markerPending = FALSE;
+}
+
+static Bool
+viaMarkerPassed(VIAPtr pVia, CARD32 marker)
+{
+    return (((pVia->lastMarkerRead - marker) & VIA_MARKER_MASK) <
+            (VIA_MARKER_MASK >> 1));
+}
+
+void
+viaAccelWaitMarker(ScreenPtr pScreen, int marker)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    VIAPtr pVia = VIAPTR(pScrn);
+    volatile CARD32 *markerBuf = pVia->markerBuf;
+    CARD32 uMarker = marker;
+    CARD64 start;
+    int loop = 0;
+
+    if (viaMarkerPassed(pVia, uMarker))
+        return;
+
+    start = viaCostTime();
+    if (pVia->agpDMA) {
+        for (;;) {
+            pVia->lastMarkerRead = *markerBuf;
+            if (viaMarkerPassed(pVia, uMarker))
+                break;
+
+            /*
+             * Once the engines are idle everything has run, and a marker
+             * that is still missing was lost rather than late.
+             */
+            if (++loop == VIA_MARKER_POLLS) {
+                viaAccelSync(pScrn);
+                pVia->lastMarkerRead = *markerBuf;
+                if (!viaMarkerPassed(pVia, uMarker)) {
+                    DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+                                     "Lost marker %u, last seen %u.\n",
+                                     (unsigned)uMarker,
+                                     (unsigned)pVia->lastMarkerRead));
+                    pVia->lastMarkerRead = pVia->curMarker;
+                }
+                break;
+            }
+        }
+    } else {
+        viaAccelSync(pScrn);
+        pVia->lastMarkerRead = pVia->curMarker;
+    }
+    viaCostSample(pVia, &pVia->cost.sync, 0, start);
+    VIA_COUNT(pVia, VIA_COUNTER_WAITS, 1);
+    VIA_COUNT(pVia, VIA_COUNTER_WAIT_US, viaCostTime() - start);
+}
@@ -0,0 +1,284 @@
+/*
+ * Copyright 2026 The OpenChrome Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Source pictures without a drawable.
+ *
+ * Solid fills are fed to the blender as the constant drawing color, the
+ * same way one-pixel repeat sources are. Linear gradients are rendered
+ * into a VIA_GRADIENT_WIDTH x 1 ramp texture, and the gradient vector is
+ * folded into the texture coordinate matrix so that the texture engine
+ * interpolates the gradient parameter across the quad. Ramps are kept in
+ * a small VRAM cache keyed by their stop list, since toolkits redraw the
+ * same few gradients over and over. Radial and conical gradients need a
+ * per pixel square root or arc tangent and stay with the software path.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "via_driver.h"
+
+#define VIA_GRADIENT_STRIDE (VIA_GRADIENT_WIDTH * 4)
+
+Bool
+viaExaCheckSourcePict(PicturePtr pPict)
+{
+    SourcePictPtr pSource = pPict->pSourcePict;
+
+    if (!pSource)
+        return FALSE;
+
+    switch (pSource->type) {
+    case SourcePictTypeSolidFill:
+        return TRUE;
+    case SourcePictTypeLinear:
+        /*
+         * The texture engine has no way to return transparent outside
+         * the ramp, so gradients without repeat are left to pixman.
+         */
+        if (!pPict->repeat || pSource->linear.nstops < 1)
+            return FALSE;
+        return (pSource->linear.p1.x != pSource->linear.p2.x ||
+                pSource->linear.p1.y != pSource->linear.p2.y);
+    default:
+        return FALSE;
+    }
+}
+
+static CARD32
+viaExaGradientHash(PictGradient *grad, Bool pad)
+{
+    CARD32 hash = 2166136261U ^ pad;
+    int i;
+
+    for (i = 0; i < grad->nstops; i++) {
+        hash = (hash ^ grad->stops[i].x) * 16777619U;
+        hash = (hash ^ grad->stops[i].color.red) * 16777619U;
+        hash = (hash ^ grad->stops[i].color.green) * 16777619U;
+        hash = (hash ^ grad->stops[i].color.blue) * 16777619U;
+        hash = (hash ^ grad->stops[i].color.alpha) * 16777619U;
+    }
+    return hash;
+}
+
+/*
+ * Render a ramp. Stop colors are interpolated unpremultiplied, as pixman
+ * does, and premultiplied per texel. Padded ramps put the ends of the
+ * gradient on the first and last texel centers, repeating ramps spread
+ * one period evenly over the texture so that it wraps seamlessly.
+ */
+static void
+viaExaGradientFill(CARD32 *ramp, PictGradient *grad, Bool pad)
+{
+    PictGradientStopPtr s0, s1;
+    double t, f, a, r, g, b;
+    int i, k = 0;
+
+    for (i = 0; i < VIA_GRADIENT_WIDTH; i++) {
+        t = (pad) ? (double)i / (VIA_GRADIENT_WIDTH - 1)
+                  : (i + 0.5) / VIA_GRADIENT_WIDTH;
+
+        while (k < grad->nstops &&
+               pixman_fixed_to_double(grad->stops[k].x) <= t)
+            k++;
+
+        s0 = grad->stops + max(k - 1, 0);
+        s1 = grad->stops + min(k, grad->nstops - 1);
+        f = 0.;
+        if (s1->x > s0->x)
+            f = (t - pixman_fixed_to_double(s0->x)) /
+                pixman_fixed_to_double(s1->x - s0->x);
+
+        a = (s0->color.alpha + f * (s1->color.alpha - s0->color.alpha))
+            / 65535.;
+        r = (s0->color.red + f * (s1->color.red - s0->color.red)) / 65535.;
+        g = (s0->color.green + f * (s1->color.green - s0->color.green))
+            / 65535.;
+        b = (s0->color.blue + f * (s1->color.blue - s0->color.blue))
+            / 65535.;
+
+        ramp[i] = ((CARD32) (a * 255. + 0.5) << 24) |
+                  ((CARD32) (r * a * 255. + 0.5) << 16) |
+                  ((CARD32) (g * a * 255. + 0.5) << 8) |
+                  (CARD32) (b * a * 255. + 0.5);
+    }
+}
+
+/*
+ * Find or render the ramp for a gradient and return its VRAM offset.
+ */
+static Bool
+viaExaGradientRamp(ScrnInfoPtr pScrn, PictGradient *grad, Bool pad,
+                    unsigned long *offset)
+{
+    ScreenPtr pScreen = pScrn->pScreen;
+    VIAPtr pVia = VIAPTR(pScrn);
+    ExaDriverPtr pExa = pVia->exaDriverPtr;
+    ViaGradientRamp *ramp, *victim = NULL;
+    size_t size = grad->nstops * sizeof(PictGradientStop);
+    CARD32 hash = viaExaGradientHash(grad, pad);
+    int i;
+
+    if (!pVia->gradArea) {
+        pVia->gradArea = exaOffscreenAlloc(pScreen,
+                                           VIA_GRADIENT_CACHE *
+                                           VIA_GRADIENT_STRIDE, 32,
+                                           TRUE, NULL, NULL);
+        if (!pVia->gradArea)
+            return FALSE;
+    }
+
+    pVia->gradClock++;
+    for (i = 0; i < VIA_GRADIENT_CACHE; i++) {
+        ramp = pVia->gradRamps + i;
+        if (ramp->stops && ramp->hash == hash && ramp->pad == pad &&
+            ramp->nstops == grad->nstops &&
+            !memcmp(ramp->stops, grad->stops, size))
+            break;
+        if (!victim || !ramp->stops ||
+            (victim->stops && ramp->lastUse < victim->lastUse))
+            victim = ramp;
+    }
+
+    if (i == VIA_GRADIENT_CACHE) {
+        ramp = victim;
+        i = ramp - pVia->gradRamps;
+
+        /* Queued composites may still be sampling the old ramp. */
+        if (ramp->stops) {
+            pExa->WaitMarker(pScreen, pExa->MarkSync(pScreen));
+            free(ramp->stops);
+        }
+        ramp->stops = malloc(size);
+        if (!ramp->stops)
+            return FALSE;
+        memcpy(ramp->stops, grad->stops, size);
+        ramp->nstops = grad->nstops;
+        ramp->hash = hash;
+        ramp->pad = pad;
+
+        viaExaGradientFill((CARD32 *) ((char *)pVia->FBBase +
+                                       pVia->gradArea->offset +
+                                       i * VIA_GRADIENT_STRIDE),
+                           grad, pad);
+    }
+
+    ramp->lastUse = pVia->gradClock;
+    *offset = pVia->gradArea->offset + i * VIA_GRADIENT_STRIDE;
+    return TRUE;
+}
+
+/*
+ * Texture coordinate matrix of a linear gradient. The gradient parameter
+ * of a point q in picture space is t = (q - p1).d / |d|^2, d = p2 - p1,
+ * which is mapped to the ramp's texel space and composed with the
+ * picture transform.
+ */
+static void
+viaExaGradientMatrix(PicturePtr pPict, Bool pad, double m[3][3])
+{
+    PictLinearGradient *linear = &pPict->pSourcePict->linear;
+    struct pixman_f_transform t, g, res;
+    double x1, y1, dx, dy, len2, scale, bias;
+    int i, j;
+
+    x1 = pixman_fixed_to_double(linear->p1.x);
+    y1 = pixman_fixed_to_double(linear->p1.y);
+    dx = pixman_fixed_to_double(linear->p2.x) - x1;
+    dy = pixman_fixed_to_double(linear->p2.y) - y1;
+    len2 = dx * dx + dy * dy;
+
+    scale = (pad) ? VIA_GRADIENT_WIDTH - 1 : VIA_GRADIENT_WIDTH;
+    bias = (pad) ? 0.5 : 0.;
+
+    pixman_f_transform_init_identity(&g);
+    g.m[0][0] = scale * dx / len2;
+    g.m[0][1] = scale * dy / len2;
+    g.m[0][2] = bias - scale * (x1 * dx + y1 * dy) / len2;
+    g.m[1][0] = 0.;
+    g.m[1][1] = 0.;
+    g.m[1][2] = 0.5;
+
+    if (pPict->transform) {
+        pixman_f_transform_from_pixman_transform(&t, pPict->transform);
+        pixman_f_transform_multiply(&res, &g, &t);
+    } else {
+        res = g;
+    }
+
+    for (i = 0; i < 3; i++)
+        for (j = 0; j < 3; j++)
+            m[i][j] = res.m[i][j];
+}
+
+/*
+ * Bind the ramp of a linear gradient source to texture unit tex.
+ */
+Bool
+viaExaPrepareGradient(ScrnInfoPtr pScrn, PicturePtr pPict, int tex,
+                        ViaTexBlendingModes blendingMode)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    Via3DState *v3d = &pVia->v3d;
+    PictGradient *grad = &pPict->pSourcePict->gradient;
+    ViaTextureModes sMode = viaExaRepeatMode(pPict);
+    Bool pad = (sMode == via_clamp);
+    unsigned long offset;
+    double m[3][3];
+
+    if (pPict->pSourcePict->type != SourcePictTypeLinear)
+        return FALSE;
+
+    if (!viaExaGradientRamp(pScrn, grad, pad, &offset))
+        return FALSE;
+
+    if (!v3d->setTexture(v3d, tex, offset, VIA_GRADIENT_STRIDE,
+                         pVia->nPOT[tex], VIA_GRADIENT_WIDTH, 1,
+                         PICT_a8r8g8b8, sMode, via_clamp, blendingMode,
+                         FALSE))
+        return FALSE;
+
+    viaExaGradientMatrix(pPict, pad, m);
+    v3d->setTexSampling(v3d, tex, NULL, TRUE);
+    v3d->setTexMatrix(v3d, tex, m);
+    return TRUE;
+}
+
+void
+viaExaGradientFini(ScreenPtr pScreen)
+{
+    ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    VIAPtr pVia = VIAPTR(pScrn);
+    int i;
+
+    for (i = 0; i < VIA_GRADIENT_CACHE; i++) {
+        free(pVia->gradRamps[i].stops);
+        pVia->gradRamps[i].stops = NULL;
+    }
+    if (pVia->gradArea) {
+        exaOffscreenFree(pScreen, pVia->gradArea);
+        pVia->gradArea = NULL;
+    }
+}
@@ -98,10 +98,8 @@ viaAccelTransparentHelper_H2(VIAPtr pVia, CARD32 keyControl,
 }
 
 /*
- * Mark Sync using the 2D blitter for AGP. NoOp for PCI.
- * In the future one could even launch a NULL PCI DMA command
- * to have an interrupt generated, provided it is possible to
- * write to the PCI DMA engines from the AGP command stream.
+ * Hand out a marker, see via_exa_fence.c. With AGP DMA it is written by a
+ * one pixel 2D fill into markerBuf.
  */
 int
 viaAccelMarkSync_H2(ScreenPtr pScreen)
@@ -111,10 +109,8 @@ viaAccelMarkSync_H2(ScreenPtr pScreen)
 
     RING_VARS;
 
-    ++pVia->curMarker;
-
-    /* Wrap around without affecting the sign bit. */
-    pVia->curMarker &= 0x7FFFFFFF;
+    if (!viaMarkerNext(pVia))
+        return pVia->curMarker;
 
     if (pVia->agpDMA) {
         BEGIN_RING(16);
@@ -127,8 +123,11 @@ viaAccelMarkSync_H2(ScreenPtr pScreen)
         OUT_RING_H1(VIA_REG_FGCOLOR, pVia->curMarker);
         OUT_RING_H1(VIA_REG_GECMD, (0xF0 << 24) | VIA_GEC_BLT | VIA_GEC_FIXCOLOR_PAT);
 
+        ADVANCE_RING;
+    } else if (cb->pos) {
         ADVANCE_RING;
     }
+    viaMarkerEmitted(pVia);
     return pVia->curMarker;
 }
 
@@ -145,7 +144,7 @@ viaExaPrepareSolid_H2(PixmapPtr pPixmap, int alu, Pixel planeMask, Pixel fg)
     if (exaGetPixmapPitch(pPixmap) & 7)
         return FALSE;
 
-    if (!viaAccelSetMode(pPixmap->drawable.depth, tdc))
+    if (!viaAccelSetMode(pPixmap->drawable.bitsPerPixel, tdc))
         return FALSE;
 
     if (!viaAccelPlaneMaskHelper_H2(tdc, planeMask))
@@ -270,67 +269,86 @@ viaExaCheckComposite_H2(int op, PicturePtr pSrcPicture,
     ScrnInfoPtr pScrn = xf86ScreenToScrn(pDstPicture->pDrawable->pScreen);
     VIAPtr pVia = VIAPTR(pScrn);
     Via3DState *v3d = &pVia->v3d;
+    ViaCompositeReject reason;
 
-    if (!pSrcPicture->pDrawable)
-        return FALSE;
+    if (!pSrcPicture->pDrawable && !viaExaCheckSourcePict(pSrcPicture)) {
+        reason = VIA_REJECT_SOURCE_PICT;
+        goto reject;
+    }
+
+    if (pMaskPicture && !pMaskPicture->pDrawable) {
+        reason = VIA_REJECT_MASK_PICT;
+        goto reject;
+    }
 
     /* Reject small composites early. They are done much faster in software. */
-    if (!pSrcPicture->repeat &&
+    if (pSrcPicture->pDrawable && !pSrcPicture->repeat &&
         pSrcPicture->pDrawable->width *
-        pSrcPicture->pDrawable->height < VIA_MIN_COMPOSITE)
-        return FALSE;
+        pSrcPicture->pDrawable->height < pVia->cost.minComposite) {
+        reason = VIA_REJECT_SRC_SMALL;
+        goto reject;
+    }
 
     if (pMaskPicture && pMaskPicture->pDrawable &&
         !pMaskPicture->repeat &&
         pMaskPicture->pDrawable->width *
-        pMaskPicture->pDrawable->height < VIA_MIN_COMPOSITE)
-        return FALSE;
+        pMaskPicture->pDrawable->height < pVia->cost.minComposite) {
+        reason = VIA_REJECT_MASK_SMALL;
+        goto reject;
+    }
 
     if (pMaskPicture && pMaskPicture->repeat &&
-        pMaskPicture->repeatType != RepeatNormal)
-        return FALSE;
+        pMaskPicture->repeatType != RepeatNormal) {
+        reason = VIA_REJECT_MASK_REPEAT;
+        goto reject;
+    }
 
-    if (pMaskPicture && pMaskPicture->componentAlpha) {
-#ifdef VIA_DEBUG_COMPOSITE
-        viaExaPrintCompositeInfo("Component Alpha operation", op,  pSrcPicture, pMaskPicture, pDstPicture);
-#endif
-        return FALSE;
+    if (!viaExaTexFits(pSrcPicture) || !viaExaTexFits(pMaskPicture)) {
+        reason = VIA_REJECT_TEX_SIZE;
+        goto reject;
+    }
+
+    if (!viaExaCheckComponentAlpha(op, pMaskPicture)) {
+        reason = VIA_REJECT_COMPONENT_ALPHA;
+        goto reject;
     }
 
     if (!v3d->opSupported(op)) {
-#ifdef VIA_DEBUG_COMPOSITE
-        viaExaPrintCompositeInfo("Operator not supported", op, pSrcPicture, pMaskPicture, pDstPicture);
-#endif
-        return FALSE;
+        reason = VIA_REJECT_OP;
+        goto reject;
     }
 
-    /*
-     * FIXME: A8 destination formats are currently not supported and do not
-     * seem supported by the hardware, although there are some leftover
-     * register settings apparent in the via_3d_reg.h file. We need to fix this
-     * (if important), by using component ARGB8888 operations with bitmask.
-     */
+    if (!viaExaCheckTransform(pSrcPicture, pMaskPicture)) {
+        reason = VIA_REJECT_TRANSFORM;
+        goto reject;
+    }
 
     if (!v3d->dstSupported(pDstPicture->format)) {
-#ifdef VIA_DEBUG_COMPOSITE
-        viaExaPrintCompositeInfo(" Destination format not supported", op, pSrcPicture, pMaskPicture, pDstPicture);
-#endif
-        return FALSE;
+        reason = VIA_REJECT_DST_FORMAT;
+        goto reject;
     }
 
-    if (v3d->texSupported(pSrcPicture->format)) {
-        if (pMaskPicture && (PICT_FORMAT_A(pMaskPicture->format) == 0 ||
-                             !v3d->texSupported(pMaskPicture->format))) {
-#ifdef VIA_DEBUG_COMPOSITE
-            viaExaPrintCompositeInfo("Mask format not supported", op, pSrcPicture, pMaskPicture, pDstPicture);
-#endif
-            return FALSE;
-        }
-        return TRUE;
+    if (!viaExaCheckA8Dst(op, pSrcPicture, pMaskPicture, pDstPicture)) {
+        reason = VIA_REJECT_A8_DST;
+        goto reject;
     }
-#ifdef VIA_DEBUG_COMPOSITE
-    viaExaPrintCompositeInfo("Src format not supported", op, pSrcPicture, pMaskPicture, pDstPicture);
-#endif
+
+    if (!v3d->texSupported(pSrcPicture->format)) {
+        reason = VIA_REJECT_SRC_FORMAT;
+        goto reject;
+    }
+
+    if (pMaskPicture && (PICT_FORMAT_A(pMaskPicture->format) == 0 ||
+                         !v3d->texSupported(pMaskPicture->format))) {
+        reason = VIA_REJECT_MASK_FORMAT;
+        goto reject;
+    }
+
+    return TRUE;
+
+reject:
+    viaExaCompositeReject(pVia, reason, op, pSrcPicture, pMaskPicture,
+                          pDstPicture);
     return FALSE;
 }
 
@@ -347,22 +365,40 @@ viaExaPrepareComposite_H2(int op, PicturePtr pSrcPicture,
     ViaTexBlendingModes srcMode;
     Bool isAGP;
     unsigned long offset;
+    Pixel fg;
+
+    if (pSrcPicture->pDrawable && !pSrc)
+        return FALSE;
 
-    /* Workaround: EXA crash with new libcairo2 on a VIA VX800 (#298) */
-    /* TODO Add real source only pictures */
-    if (!pSrc) {
-	    ErrorF("pSrc is NULL\n");
-	    return FALSE;
-	}
+    /* Opaque copies and fills are cheaper on the 2D engine. */
+    pVia->compositeRoute = viaExaCompositeRoute(op, pSrcPicture, pMaskPicture,
+                                                pDstPicture, pSrc, pDst, &fg);
+    switch (pVia->compositeRoute) {
+    case VIA_ROUTE_COPY:
+        if (viaExaPrepareCopy_H2(pSrc, pDst, 1, 1, GXcopy, ~0))
+            break;
+        pVia->compositeRoute = VIA_ROUTE_3D;
+        break;
+    case VIA_ROUTE_SOLID:
+        if (viaExaPrepareSolid_H2(pDst, GXcopy, ~0, fg))
+            break;
+        pVia->compositeRoute = VIA_ROUTE_3D;
+        break;
+    default:
+        break;
+    }
+    if (pVia->compositeRoute != VIA_ROUTE_3D) {
+        pVia->routeOps[pVia->compositeRoute]++;
+        return TRUE;
+    }
 
+    pVia->dstTiled = viaExaTiledDst(pDst);
+    pVia->dstFormat = pDstPicture->format;
     v3d->setDestination(v3d, exaGetPixmapOffset(pDst),
                         exaGetPixmapPitch(pDst), pDstPicture->format);
     v3d->setCompositeOperator(v3d, op);
     v3d->setDrawing(v3d, 0x0c, 0xFFFFFFFF, 0x000000FF, 0xFF);
 
-    viaOrder(pSrc->drawable.width, &width);
-    viaOrder(pSrc->drawable.height, &height);
-
     /*
      * For one-pixel repeat mask pictures we avoid using multitexturing by
      * modifying the src's texture blending equation and feed the pixel
@@ -372,7 +408,11 @@ viaExaPrepareComposite_H2(int op, PicturePtr pSrcPicture,
 
     srcMode = via_src;
     pVia->maskP = NULL;
-    if (pMaskPicture &&
+    pVia->caTwoPass = FALSE;
+    pVia->srcBounded = FALSE;
+    if (pMaskPicture && (pSrc || pSrcPicture->pSourcePict->type !=
+                         SourcePictTypeSolidFill) &&
+        (!pMaskPicture->componentAlpha || op == PictOpAdd) &&
         (pMaskPicture->pDrawable->height == 1) &&
         (pMaskPicture->pDrawable->width == 1) &&
         pMaskPicture->repeat && viaExpandablePixel(pMaskPicture->format)) {
@@ -385,11 +425,16 @@ viaExaPrepareComposite_H2(int op, PicturePtr pSrcPicture,
 
     /*
      * One-Pixel repeat src pictures go as solid color instead of textures.
-     * Speeds up window shadows.
+     * Speeds up window shadows. Solid fill pictures go the same way, other
+     * source pictures without a drawable are gradients.
      */
 
     pVia->srcP = NULL;
-    if (pSrcPicture && pSrcPicture->repeat
+    if (!pSrc && pSrcPicture->pSourcePict->type == SourcePictTypeSolidFill) {
+        pVia->srcSolid = pSrcPicture->pSourcePict->solidFill.color;
+        pVia->srcP = &pVia->srcSolid;
+        pVia->srcFormat = PICT_a8r8g8b8;
+    } else if (pSrc && pSrcPicture->repeat
         && (pSrcPicture->pDrawable->height == 1)
         && (pSrcPicture->pDrawable->width == 1)
         && viaExpandablePixel(pSrcPicture->format)) {
@@ -404,7 +449,13 @@ viaExaPrepareComposite_H2(int op, PicturePtr pSrcPicture,
         return FALSE;
     }
 
-    if (!pVia->srcP) {
+    if (!pVia->srcP && !pSrc) {
+        if (!viaExaPrepareGradient(pScrn, pSrcPicture, curTex, srcMode))
+            return FALSE;
+        curTex++;
+    } else if (!pVia->srcP) {
+        viaOrder(pSrc->drawable.width, &width);
+        viaOrder(pSrc->drawable.height, &height);
         offset = exaGetPixmapOffset(pSrc);
         isAGP = viaIsAGP(pVia, pSrc, &offset);
         if (!isAGP && !viaExaIsOffscreen(pSrc))
@@ -412,9 +463,12 @@ viaExaPrepareComposite_H2(int op, PicturePtr pSrcPicture,
         if (!v3d->setTexture(v3d, curTex, offset,
                              exaGetPixmapPitch(pSrc), pVia->nPOT[curTex],
                              1 << width, 1 << height, pSrcPicture->format,
-                             via_repeat, via_repeat, srcMode, isAGP)) {
+                             viaExaRepeatMode(pSrcPicture),
+                             viaExaRepeatMode(pSrcPicture), srcMode, isAGP)) {
             return FALSE;
         }
+        if (!viaExaSetTexSampling(pScrn, op, pSrcPicture, curTex, TRUE))
+            return FALSE;
         curTex++;
     }
 
@@ -425,22 +479,34 @@ viaExaPrepareComposite_H2(int op, PicturePtr pSrcPicture,
             return FALSE;
         viaOrder(pMask->drawable.width, &width);
         viaOrder(pMask->drawable.height, &height);
+        pVia->maskTex = curTex;
+        pVia->maskFormat = pMaskPicture->format;
         if (!v3d->setTexture(v3d, curTex, offset,
                              exaGetPixmapPitch(pMask), pVia->nPOT[curTex],
                              1 << width, 1 << height, pMaskPicture->format,
-                             via_repeat, via_repeat,
+                             viaExaRepeatMode(pMaskPicture),
+                             viaExaRepeatMode(pMaskPicture),
                              ((pMaskPicture->componentAlpha)
                               ? via_comp_mask : via_mask), isAGP)) {
             return FALSE;
         }
+        if (!viaExaSetTexSampling(pScrn, op, pMaskPicture, curTex, FALSE))
+            return FALSE;
         curTex++;
     }
 
+    if (pMaskPicture && pMaskPicture->componentAlpha && op != PictOpAdd) {
+        pVia->caTwoPass = (op == PictOpOver);
+        viaExaComponentAlphaPass(pScrn, PictOpOutReverse);
+    }
+
     v3d->setFlags(v3d, curTex, FALSE, TRUE, TRUE);
     v3d->emitState(pVia, v3d, &pVia->cb, viaCheckUpload(pScrn, v3d));
-    v3d->emitClipRect(pVia, v3d, &pVia->cb, 0, 0, pDst->drawable.width,
-                      pDst->drawable.height);
+    if (!pVia->dstTiled)
+        v3d->emitClipRect(pVia, v3d, &pVia->cb, 0, 0, viaExaDstWidth(pDst),
+                          pDst->drawable.height);
 
+    pVia->routeOps[VIA_ROUTE_3D]++;
     return TRUE;
 }
 
@@ -453,6 +519,18 @@ viaExaComposite_H2(PixmapPtr pDst, int srcX, int srcY, int maskX, int maskY,
     Via3DState *v3d = &pVia->v3d;
     CARD32 col;
 
+    pVia->routeRects[pVia->compositeRoute]++;
+    switch (pVia->compositeRoute) {
+    case VIA_ROUTE_COPY:
+        viaExaCopy_H2(pDst, srcX, srcY, dstX, dstY, width, height);
+        return;
+    case VIA_ROUTE_SOLID:
+        viaExaSolid_H2(pDst, dstX, dstY, dstX + width, dstY + height);
+        return;
+    default:
+        break;
+    }
+
     if (pVia->maskP) {
         viaPixelARGB8888(pVia->maskFormat, pVia->maskP, &col);
         v3d->setTexBlendCol(v3d, 0, pVia->componentAlpha, col);
@@ -467,8 +545,8 @@ viaExaComposite_H2(PixmapPtr pDst, int srcX, int srcY, int maskX, int maskY,
     if (pVia->maskP || pVia->srcP)
         v3d->emitState(pVia, v3d, &pVia->cb, viaCheckUpload(pScrn, v3d));
 
-    v3d->emitQuad(pVia, v3d, &pVia->cb, dstX, dstY, srcX, srcY, maskX, maskY,
-                  width, height);
+    viaExaCompositeRect(pScrn, pDst, srcX, srcY, maskX, maskY,
+                        dstX, dstY, width, height);
 }
 
 void
@@ -0,0 +1,331 @@
+/*
+ * Copyright 2026 The OpenChrome Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Composite rejection histogram.
+ *
+ * With Option "CompositeStats" every composite the driver turns down is
+ * counted by reason, operator, source, mask and destination format and
+ * size class. EXA does not tell CheckComposite the size of the operation,
+ * so the area recorded is the destination drawable clipped by any
+ * unrepeated source or mask drawable, an upper bound of what fell back.
+ *
+ * The table is logged when the screen closes, and whenever a client sets
+ * the root window property _OPENCHROME_COMPOSITE_DUMP.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "via_driver.h"
+
+/* Power of two. Keys beyond this many classes are only totalled. */
+#define VIA_REJECT_SLOTS    512
+
+/* Format codes for sources without a drawable, and for no mask. */
+#define VIA_REJECT_FMT_NONE     0
+#define VIA_REJECT_FMT_SOLID    1
+#define VIA_REJECT_FMT_GRADIENT 2
+
+#define VIA_REJECT_BUCKETS  5
+
+typedef struct _ViaRejectEntry {
+    CARD32 src, mask, dst;
+    CARD8 reason, op, bucket, used;
+    unsigned long count;
+    CARD64 area;
+} ViaRejectEntry;
+
+typedef struct _ViaRejectTable {
+    ViaRejectEntry slot[VIA_REJECT_SLOTS];
+    unsigned classes;
+    unsigned long dropped;
+    unsigned long count;
+    CARD64 area;
+} ViaRejectTable;
+
+static const char *viaRejectReasons[VIA_REJECT_NUM] = {
+    [VIA_REJECT_SOURCE_PICT]     = "Source picture type not supported",
+    [VIA_REJECT_MASK_PICT]       = "Mask without drawable",
+    [VIA_REJECT_SRC_SMALL]       = "Source picture too small",
+    [VIA_REJECT_MASK_SMALL]      = "Mask picture too small",
+    [VIA_REJECT_MASK_REPEAT]     = "Repeat is different than normal",
+    [VIA_REJECT_TEX_SIZE]        = "Picture too large for a texture",
+    [VIA_REJECT_COMPONENT_ALPHA] = "Component Alpha operation",
+    [VIA_REJECT_OP]              = "Operator not supported",
+    [VIA_REJECT_TRANSFORM]       = "Transform or filter not supported",
+    [VIA_REJECT_DST_FORMAT]      = "Destination format not supported",
+    [VIA_REJECT_A8_DST]          = "Operation not supported to A8",
+    [VIA_REJECT_MASK_FORMAT]     = "Mask format not supported",
+    [VIA_REJECT_SRC_FORMAT]      = "Src format not supported",
+    [VIA_REJECT_PREPARE]         = "Prepare failed",
+};
+
+/* Upper area of each size class. */
+static const CARD64 viaRejectBucketArea[VIA_REJECT_BUCKETS - 1] = {
+    16 * 16, 64 * 64, 256 * 256, 1024 * 1024
+};
+
+static const char *viaRejectBucketNames[VIA_REJECT_BUCKETS] = {
+    "<=16x16", "<=64x64", "<=256x256", "<=1024x1024", ">1024x1024"
+};
+
+static CARD32
+viaRejectFormat(PicturePtr pPict)
+{
+    if (!pPict)
+        return VIA_REJECT_FMT_NONE;
+    if (!pPict->pDrawable)
+        return (pPict->pSourcePict &&
+                pPict->pSourcePict->type == SourcePictTypeSolidFill)
+            ? VIA_REJECT_FMT_SOLID : VIA_REJECT_FMT_GRADIENT;
+    return pPict->format;
+}
+
+static const char *
+viaRejectFormatName(CARD32 format, char *buf, int n)
+{
+    switch (format) {
+    case VIA_REJECT_FMT_NONE:
+        return "none";
+    case VIA_REJECT_FMT_SOLID:
+        return "solid";
+    case VIA_REJECT_FMT_GRADIENT:
+        return "gradient";
+    case PICT_a8r8g8b8:
+        return "a8r8g8b8";
+    case PICT_x8r8g8b8:
+        return "x8r8g8b8";
+    case PICT_a8b8g8r8:
+        return "a8b8g8r8";
+    case PICT_x8b8g8r8:
+        return "x8b8g8r8";
+    case PICT_r5g6b5:
+        return "r5g6b5";
+    case PICT_a1r5g5b5:
+        return "a1r5g5b5";
+    case PICT_x1r5g5b5:
+        return "x1r5g5b5";
+    case PICT_a4r4g4b4:
+        return "a4r4g4b4";
+    case PICT_a8:
+        return "a8";
+    case PICT_a4:
+        return "a4";
+    case PICT_a1:
+        return "a1";
+    default:
+        snprintf(buf, n, "0x%08x", (unsigned)format);
+        return buf;
+    }
+}
+
+static const char *
+viaRejectOpName(int op, char *buf, int n)
+{
+    static const char *names[] = {
+        "Clear", "Src", "Dst", "Over", "OverReverse", "In", "InReverse",
+        "Out", "OutReverse", "Atop", "AtopReverse", "Xor", "Add",
+        "Saturate"
+    };
+
+    if (op >= 0 && op < (int)(sizeof(names) / sizeof(names[0])))
+        return names[op];
+    snprintf(buf, n, "op %d", op);
+    return buf;
+}
+
+/*
+ * What a composite could have covered at most.
+ */
+static CARD64
+viaRejectArea(PicturePtr pSrc, PicturePtr pMask, PicturePtr pDst)
+{
+    CARD64 area, a;
+
+    area = (CARD64) pDst->pDrawable->width * pDst->pDrawable->height;
+    if (pSrc->pDrawable && !pSrc->repeat) {
+        a = (CARD64) pSrc->pDrawable->width * pSrc->pDrawable->height;
+        area = min(area, a);
+    }
+    if (pMask && pMask->pDrawable && !pMask->repeat) {
+        a = (CARD64) pMask->pDrawable->width * pMask->pDrawable->height;
+        area = min(area, a);
+    }
+    return area;
+}
+
+static int
+viaRejectBucket(CARD64 area)
+{
+    int i;
+
+    for (i = 0; i < VIA_REJECT_BUCKETS - 1; i++)
+        if (area <= viaRejectBucketArea[i])
+            break;
+    return i;
+}
+
+static void
+viaRejectRecord(ViaRejectTable *t, ViaCompositeReject reason, int op,
+                PicturePtr pSrc, PicturePtr pMask, PicturePtr pDst)
+{
+    CARD32 src = viaRejectFormat(pSrc);
+    CARD32 mask = viaRejectFormat(pMask);
+    CARD32 dst = pDst->format;
+    CARD64 area = viaRejectArea(pSrc, pMask, pDst);
+    int bucket = viaRejectBucket(area);
+    ViaRejectEntry *e;
+    CARD32 h;
+    int i;
+
+    t->count++;
+    t->area += area;
+
+    h = src * 0x9E3779B1 ^ mask * 0x85EBCA77 ^ dst * 0xC2B2AE3D;
+    h ^= (reason << 16) | (op << 8) | bucket;
+    h ^= h >> 15;
+
+    for (i = 0; i < VIA_REJECT_SLOTS; i++) {
+        e = &t->slot[(h + i) & (VIA_REJECT_SLOTS - 1)];
+        if (!e->used) {
+            e->used = TRUE;
+            e->src = src;
+            e->mask = mask;
+            e->dst = dst;
+            e->reason = reason;
+            e->op = op;
+            e->bucket = bucket;
+            t->classes++;
+            break;
+        }
+        if (e->src == src && e->mask == mask && e->dst == dst &&
+            e->reason == reason && e->op == op && e->bucket == bucket)
+            break;
+    }
+
+    if (i == VIA_REJECT_SLOTS) {
+        t->dropped++;
+        return;
+    }
+    e->count++;
+    e->area += area;
+}
+
+/*
+ * Called wherever a composite is turned down.
+ */
+void
+viaExaCompositeReject(VIAPtr pVia, ViaCompositeReject reason, int op,
+                      PicturePtr pSrcPicture, PicturePtr pMaskPicture,
+                      PicturePtr pDstPicture)
+{
+#ifdef VIA_DEBUG_COMPOSITE
+    viaExaPrintCompositeInfo((char *)viaRejectReasons[reason], op,
+                             pSrcPicture, pMaskPicture, pDstPicture);
+#endif
+    if (pVia->rejects)
+        viaRejectRecord(pVia->rejects, reason, op, pSrcPicture,
+                        pMaskPicture, pDstPicture);
+}
+
+static int
+viaRejectCompare(const void *a, const void *b)
+{
+    const ViaRejectEntry *ea = *(const ViaRejectEntry * const *)a;
+    const ViaRejectEntry *eb = *(const ViaRejectEntry * const *)b;
+
+    if (ea->area != eb->area)
+        return (ea->area < eb->area) ? 1 : -1;
+    return (ea->count < eb->count) ? 1 : (ea->count > eb->count) ? -1 : 0;
+}
+
+/*
+ * Log the classes, largest area first.
+ */
+void
+viaExaRejectDump(ScrnInfoPtr pScrn, int verb)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    ViaRejectTable *t = pVia->rejects;
+    ViaRejectEntry *sorted[VIA_REJECT_SLOTS];
+    char ob[16], sb[16], mb[16], db[16];
+    int i, n = 0;
+
+    if (!t)
+        return;
+
+    xf86DrvMsgVerb(pScrn->scrnIndex, X_INFO, verb,
+                   "[EXA] Composite fallbacks: %lu, up to %llu pixels, "
+                   "in %u classes (%lu not classified).\n",
+                   t->count, (unsigned long long)t->area, t->classes,
+                   t->dropped);
+
+    for (i = 0; i < VIA_REJECT_SLOTS; i++)
+        if (t->slot[i].used)
+            sorted[n++] = &t->slot[i];
+    qsort(sorted, n, sizeof(sorted[0]), viaRejectCompare);
+
+    for (i = 0; i < n; i++) {
+        ViaRejectEntry *e = sorted[i];
+
+        xf86DrvMsgVerb(pScrn->scrnIndex, X_INFO, verb,
+                       "[EXA]   %lu x %s, src %s, mask %s, dst %s, %s: "
+                       "%llu pixels, %s.\n",
+                       e->count, viaRejectOpName(e->op, ob, sizeof(ob)),
+                       viaRejectFormatName(e->src, sb, sizeof(sb)),
+                       viaRejectFormatName(e->mask, mb, sizeof(mb)),
+                       viaRejectFormatName(e->dst, db, sizeof(db)),
+                       viaRejectBucketNames[e->bucket],
+                       (unsigned long long)e->area,
+                       viaRejectReasons[e->reason]);
+    }
+}
+
+void
+viaExaRejectInit(ScrnInfoPtr pScrn)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+
+    if (!pVia->compositeStats || pVia->noComposite || pVia->rejects)
+        return;
+
+    pVia->rejects = calloc(1, sizeof(*pVia->rejects));
+    if (!pVia->rejects)
+        xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+                   "[EXA] No memory for composite statistics.\n");
+}
+
+void
+viaExaRejectFini(ScrnInfoPtr pScrn)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+
+    if (!pVia->rejects)
+        return;
+
+    viaExaRejectDump(pScrn, 1);
+    free(pVia->rejects);
+    pVia->rejects = NULL;
+}
@@ -1058,7 +1058,9 @@ via_fp_detect(xf86OutputPtr output)
     }
 
     if (pI2CBus) {
+        viaTraceBegin("xf86OutputGetEDID", output->name);
         pMon = xf86OutputGetEDID(output, pI2CBus);
+        viaTraceEnd();
         if (pMon && DIGITAL(pMon->features.input_type)) {
             xf86OutputSetEDID(output, pMon);
             xf86DrvMsg(pScrn->scrnIndex, X_PROBED,
@@ -43,6 +43,8 @@ typedef enum
     OPTION_NOACCEL,
     OPTION_EXA_NOCOMPOSITE,
     OPTION_EXA_SCRATCH_SIZE,
+    OPTION_EXA_COMPOSITE_STATS,
+    OPTION_EXA_AGP_UPLOAD,
     OPTION_SWCURSOR,
     OPTION_SHADOW_FB,
     OPTION_ROTATION_TYPE,
@@ -59,13 +61,18 @@ typedef enum
     OPTION_XV_DMA,
     OPTION_MAX_DRIMEM,
     OPTION_AGPMEM,
-    OPTION_DISABLE_XV_BW_CHECK
+    OPTION_DISABLE_XV_BW_CHECK,
+    OPTION_COUNTER_LOG,
+    OPTION_TRACE_FILE,
+    OPTION_REGISTER_SHADOW
 } VIAOpts;
 
 static OptionInfoRec VIAOptions[] = {
     {OPTION_NOACCEL,             "NoAccel",          OPTV_BOOLEAN, {0}, FALSE},
     {OPTION_EXA_NOCOMPOSITE,     "ExaNoComposite",   OPTV_BOOLEAN, {0}, FALSE},
     {OPTION_EXA_SCRATCH_SIZE,    "ExaScratchSize",   OPTV_INTEGER, {0}, FALSE},
+    {OPTION_EXA_COMPOSITE_STATS, "CompositeStats",   OPTV_BOOLEAN, {0}, FALSE},
+    {OPTION_EXA_AGP_UPLOAD,      "ExaAGPUpload",     OPTV_BOOLEAN, {0}, FALSE},
     {OPTION_SWCURSOR,            "SWCursor",         OPTV_BOOLEAN, {0}, FALSE},
     {OPTION_SHADOW_FB,           "ShadowFB",         OPTV_BOOLEAN, {0}, FALSE},
     {OPTION_ROTATION_TYPE,       "RotationType",     OPTV_ANYSTR,  {0}, FALSE},
@@ -82,6 +89,9 @@ static OptionInfoRec VIAOptions[] = {
     {OPTION_DISABLE_XV_BW_CHECK, "DisableXvBWCheck", OPTV_BOOLEAN, {0}, FALSE},
     {OPTION_MAX_DRIMEM,          "MaxDRIMem",        OPTV_INTEGER, {0}, FALSE},
     {OPTION_AGPMEM,              "AGPMem",           OPTV_INTEGER, {0}, FALSE},
+    {OPTION_COUNTER_LOG,         "CounterLog",       OPTV_INTEGER, {0}, FALSE},
+    {OPTION_TRACE_FILE,          "TraceFile",        OPTV_ANYSTR,  {0}, FALSE},
+    {OPTION_REGISTER_SHADOW,     "RegisterShadow",   OPTV_BOOLEAN, {0}, FALSE},
     {-1,                         NULL,               OPTV_NONE,    {0}, FALSE}
 };
 
@@ -103,6 +113,8 @@ viaSetupDefaultOptions(ScrnInfoPtr pScrn)
     pVia->shadowFB = FALSE;
     pVia->NoAccel = FALSE;
     pVia->noComposite = FALSE;
+    pVia->compositeStats = FALSE;
+    pVia->exaAGPUpload = FALSE;
     pVia->useEXA = TRUE;
     pVia->exaScratchSize = VIA_SCRATCH_SIZE / 1024;
     pVia->drmmode.hwcursor = TRUE;
@@ -111,12 +123,14 @@ viaSetupDefaultOptions(ScrnInfoPtr pScrn)
     pVia->agpEnable = TRUE;
     pVia->dma2d = TRUE;
     pVia->dmaXV = TRUE;
+    pVia->regShadowEnable = TRUE;
 #ifdef HAVE_DEBUG
     pVia->disableXvBWCheck = FALSE;
 #endif
     pVia->maxDriSize = 0;
     pVia->agpMem = AGP_SIZE / 1024;
     pVia->VideoEngine = VIDEO_ENGINE_CLE;
+    pVia->counters.logInterval = 0;
 
     /*
      * Disable vertical interpolation because the size of
@@ -249,6 +263,14 @@ viaProcessUMSOptions(ScrnInfoPtr pScrn)
                "image transfer if DRI is enabled.\n",
                (pVia->dmaXV) ? "" : "not ");
 
+    from = xf86GetOptValBool(VIAOptions,
+                                OPTION_REGISTER_SHADOW,
+                                &pVia->regShadowEnable) ?
+            X_CONFIG : X_DEFAULT;
+    xf86DrvMsg(pScrn->scrnIndex, from,
+                "Extended register shadow is %s.\n",
+                pVia->regShadowEnable ? "enabled" : "disabled");
+
 #ifdef HAVE_DEBUG
 /*
     pVia->disableXvBWCheck = FALSE;
@@ -513,6 +535,14 @@ viaProcessOptions(ScrnInfoPtr pScrn)
                         "EXA composite acceleration %s.\n",
                         !pVia->noComposite ? "enabled" : "disabled");
 
+            if (!pVia->noComposite &&
+                xf86GetOptValBool(VIAOptions, OPTION_EXA_COMPOSITE_STATS,
+                                    &pVia->compositeStats) &&
+                pVia->compositeStats)
+                xf86DrvMsg(pScrn->scrnIndex, X_CONFIG,
+                            "Collecting EXA composite fallback "
+                            "statistics.\n");
+
 /*
             pVia->exaScratchSize = VIA_SCRATCH_SIZE / 1024;
 */
@@ -523,6 +553,13 @@ viaProcessOptions(ScrnInfoPtr pScrn)
             xf86DrvMsg(pScrn->scrnIndex, from,
                         "EXA scratch area size is %d KB.\n",
                         pVia->exaScratchSize);
+
+            if (xf86GetOptValBool(VIAOptions, OPTION_EXA_AGP_UPLOAD,
+                                    &pVia->exaAGPUpload) &&
+                pVia->exaAGPUpload)
+                xf86DrvMsg(pScrn->scrnIndex, X_CONFIG,
+                            "Allowing EXA uploads through AGP "
+                            "textures.\n");
         }
     }
 
@@ -547,6 +584,21 @@ viaProcessOptions(ScrnInfoPtr pScrn)
         xf86DrvMsg(pScrn->scrnIndex, from,
                     "Using software cursors.\n");
 
+    from = xf86GetOptValInteger(VIAOptions, OPTION_COUNTER_LOG,
+                                &pVia->counters.logInterval) ?
+            X_CONFIG : X_DEFAULT;
+    if (pVia->counters.logInterval > 0)
+        xf86DrvMsg(pScrn->scrnIndex, from,
+                    "Logging runtime counters every %d seconds.\n",
+                    pVia->counters.logInterval);
+
+    if ((s = xf86GetOptValString(VIAOptions, OPTION_TRACE_FILE))) {
+        pVia->traceFile = xnfstrdup(s);
+        xf86DrvMsg(pScrn->scrnIndex, X_CONFIG,
+                    "Writing the startup trace to %s.\n",
+                    pVia->traceFile);
+    }
+
     if (!pVia->KMS) {
         viaProcessUMSOptions(pScrn);
     }
@@ -205,16 +205,26 @@ viaInitDisplay(ScrnInfoPtr pScrn)
     /* Initialize the number of TV connectors. */
     pVIADisplay->numberTV = 0;
 
+    viaTraceBegin("viaExtTMDSProbe", NULL);
     viaExtTMDSProbe(pScrn);
+    viaTraceEnd();
+    viaTraceBegin("viaTMDSProbe", NULL);
     viaTMDSProbe(pScrn);
+    viaTraceEnd();
 
+    viaTraceBegin("viaFPProbe", NULL);
     viaFPProbe(pScrn);
+    viaTraceEnd();
 
+    viaTraceBegin("viaAnalogProbe", NULL);
     viaAnalogProbe(pScrn);
+    viaTraceEnd();
 
 
     /* TV */
+    viaTraceBegin("via_tv_init", NULL);
     via_tv_init(pScrn);
+    viaTraceEnd();
 
     /* DVI */
     viaExtTMDSInit(pScrn);
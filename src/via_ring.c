@@ -0,0 +1,547 @@
+/*
+ * Copyright 2026 The OpenChrome Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Command ring without DRM.
+ *
+ * With DRI the DRM feeds the command regulator from a ring in AGP memory.
+ * Without it, every register of a command buffer is written over MMIO.
+ * On the AGP-class chipsets this file does what the DRM does, with the
+ * ring in video memory: the command buffer is copied behind the previous
+ * submission, closed with a pause command, and the pause the regulator is
+ * waiting at is rewritten to point at the new one. The protocol follows
+ * via_dma.c of the DRM, including its workarounds for a regulator that
+ * pauses before it sees the new pause address.
+ *
+ * Whether the regulator can fetch from the framebuffer aperture depends
+ * on the board, so the ring is tested with a marker before it is used,
+ * and it is given up for MMIO if it ever stalls.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <unistd.h>
+
+#include "via_driver.h"
+#include "via_regs.h"
+#include "via_dmabuffer.h"
+
+/* Must be a power of two. */
+#define VIA_RING_SIZE       (2 * 1024 * 1024)
+
+/* Pause commands end on this boundary. */
+#define VIA_RING_ALIGN      0x100
+#define VIA_RING_ALIGN_MASK (VIA_RING_ALIGN - 1)
+
+/* Space kept clear ahead of the reader, which prefetches. */
+#define VIA_RING_SLACK      (512 * 1024)
+
+/* Regulator status, set while it waits at a pause address. */
+#define VIA_RING_STATUS     0x41c
+#define VIA_RING_PAUSED     0x80000000
+
+#define VIA_RING_TIMEOUT    10000000
+
+/* Milliseconds to wait for the self-test marker. */
+#define VIA_RING_TEST_MS    100
+
+static void
+viaRingOut(ViaRing *ring, CARD32 val1, CARD32 val2)
+{
+    CARD32 *vb = ring->virt + (ring->low >> 2);
+
+    vb[0] = val1;
+    vb[1] = val2;
+    ring->low += 8;
+}
+
+static CARD32
+viaRingReader(VIAPtr pVia)
+{
+    return VIAGETREG(pVia->ring.regPause);
+}
+
+static Bool
+viaRingPaused(VIAPtr pVia)
+{
+    return (VIAGETREG(VIA_RING_STATUS) & VIA_RING_PAUSED) != 0;
+}
+
+/*
+ * Bus address just past the pause command the regulator was last told
+ * to stop at.
+ */
+static CARD32
+viaRingPauseAddr(ViaRing *ring, volatile CARD32 *pause)
+{
+    return ring->base + (((CARD32 *) pause - ring->virt) << 2) + 4;
+}
+
+/*
+ * Wait until size bytes from the write offset are no longer ahead of
+ * the reader.
+ */
+static Bool
+viaRingWait(VIAPtr pVia, unsigned size)
+{
+    ViaRing *ring = &pVia->ring;
+    CARD32 cur = ring->low;
+    CARD32 next = cur + size + VIA_RING_SLACK;
+    CARD32 hw;
+    unsigned loop = 0;
+
+    do {
+        hw = viaRingReader(pVia) - ring->base;
+        if (loop++ == VIA_RING_TIMEOUT)
+            return FALSE;
+    } while ((cur < hw) && (next >= hw));
+    return TRUE;
+}
+
+/*
+ * Append a pause, jump or stop command, padded so that it ends on a
+ * VIA_RING_ALIGN boundary. Returns the dword holding its address, which
+ * is what gets rewritten to move the pause point on.
+ */
+static CARD32 *
+viaRingAlign(VIAPtr pVia, CARD32 cmdType, CARD32 *hi, CARD32 *lo,
+             Bool wait)
+{
+    ViaRing *ring = &pVia->ring;
+    CARD32 addr;
+    int pad;
+
+    if (wait)
+        viaRingWait(pVia, 2 * VIA_RING_ALIGN);
+
+    viaRingOut(ring, HALCYON_HEADER2, HC_ParaType_PreCR << 16);
+    pad = (VIA_RING_ALIGN - (ring->low & VIA_RING_ALIGN_MASK)) >> 3;
+    addr = ring->base + ring->low + ((pad - 1) << 3);
+
+    *hi = (HC_SubA_HAGPBpH << 24) | (addr >> 24);
+    *lo = (HC_SubA_HAGPBpL << 24) | (cmdType & HC_HAGPBpID_MASK) |
+          (addr & HC_HAGPBpL_MASK);
+
+    while (--pad > 0)
+        viaRingOut(ring, HC_DUMMY, HC_DUMMY);
+    viaRingOut(ring, *hi, *lo);
+
+    return ring->virt + (ring->low >> 2) - 1;
+}
+
+/*
+ * Point the pause the regulator is heading for at the command just
+ * appended. If the regulator got to the old pause first, it never sees
+ * the change, and has to be given the new address over MMIO.
+ */
+static void
+viaRingHook(VIAPtr pVia, CARD32 hi, CARD32 lo)
+{
+    ViaRing *ring = &pVia->ring;
+    volatile CARD32 *pausedAt = ring->lastPause;
+    CARD32 ptr, reader, diff;
+    unsigned loop = 0;
+
+    mem_barrier();
+    (void) *(volatile CARD32 *) (ring->virt + (ring->low >> 2) - 1);
+
+    *pausedAt = lo;
+    mem_barrier();
+    (void) *pausedAt;
+
+    ptr = viaRingPauseAddr(ring, pausedAt);
+    ring->lastPause = ring->virt + (ring->low >> 2) - 1;
+
+    reader = viaRingReader(pVia);
+    diff = ptr - reader - ring->diff;
+    while (!diff && (loop++ < VIA_RING_TIMEOUT)) {
+        if (viaRingPaused(pVia))
+            break;
+        reader = viaRingReader(pVia);
+        diff = ptr - reader - ring->diff;
+    }
+
+    if (!viaRingPaused(pVia))
+        return;
+
+    reader = viaRingReader(pVia);
+    diff = (ptr - reader - ring->diff) & (ring->size - 1);
+    if (!diff) {
+        VIASETREG(VIA_REG_TRANSET, HC_ParaType_PreCR << 16);
+        VIASETREG(VIA_REG_TRANSPACE, hi);
+        VIASETREG(VIA_REG_TRANSPACE, lo);
+        (void) VIAGETREG(VIA_REG_TRANSPACE);
+    } else if (diff < (ring->size >> 1)) {
+        ErrorF("Command ring paused at 0x%08x, expected 0x%08x.\n",
+               (unsigned)reader, (unsigned)(ptr - ring->diff));
+    }
+}
+
+/*
+ * The regulator does not always fetch correctly right after a jump, the
+ * DRM starts over with two empty blits as well.
+ */
+static void
+viaRingDummyBlit(ViaRing *ring)
+{
+    viaRingOut(ring, H1_ADDR(VIA_REG_DSTPOS), 0);
+    viaRingOut(ring, H1_ADDR(VIA_REG_DIMENSION), 0);
+    viaRingOut(ring, H1_ADDR(VIA_REG_GECMD), 0xAA000000 | 0x2000 | 0x1);
+}
+
+/*
+ * Wrap around. The jump is hooked in behind the last submission, and a
+ * second pause at the start of the ring traps a regulator that is sent
+ * over the old contents again by a pause address rewritten over MMIO.
+ */
+static void
+viaRingJump(VIAPtr pVia)
+{
+    ViaRing *ring = &pVia->ring;
+    CARD32 jumpHi, jumpLo, pauseHi, pauseLo;
+    CARD32 *pause;
+    unsigned low1, low2;
+
+    viaRingAlign(pVia, HC_HAGPBpID_JUMP, &jumpHi, &jumpLo, TRUE);
+
+    ring->low = 0;
+    viaRingWait(pVia, VIA_RING_ALIGN);
+
+    viaRingDummyBlit(ring);
+    viaRingDummyBlit(ring);
+
+    pause = viaRingAlign(pVia, HC_HAGPBpID_PAUSE, &pauseHi, &pauseLo, TRUE);
+    viaRingAlign(pVia, HC_HAGPBpID_PAUSE, &pauseHi, &pauseLo, TRUE);
+    *pause = pauseLo;
+    low1 = ring->low;
+
+    pause = viaRingAlign(pVia, HC_HAGPBpID_PAUSE, &pauseHi, &pauseLo, TRUE);
+    viaRingAlign(pVia, HC_HAGPBpID_PAUSE, &pauseHi, &pauseLo, TRUE);
+    *pause = pauseLo;
+    low2 = ring->low;
+
+    ring->low = low1;
+    viaRingHook(pVia, jumpHi, jumpLo);
+    ring->low = low2;
+    viaRingHook(pVia, pauseHi, pauseLo);
+}
+
+/*
+ * Make room for size bytes plus the closing pause.
+ */
+static Bool
+viaRingSpace(VIAPtr pVia, unsigned size)
+{
+    ViaRing *ring = &pVia->ring;
+
+    if (ring->low + size + 4 * VIA_RING_ALIGN > ring->size)
+        viaRingJump(pVia);
+    return viaRingWait(pVia, size);
+}
+
+/*
+ * Program the ring and let the regulator run into its first pause.
+ */
+static void
+viaRingStart(VIAPtr pVia)
+{
+    ViaRing *ring = &pVia->ring;
+    CARD32 start = ring->base;
+    CARD32 end = ring->base + ring->size;
+    CARD32 command, hi, lo;
+    unsigned loop = 0;
+
+    ring->low = 0;
+    ring->lastPause = viaRingAlign(pVia, HC_HAGPBpID_PAUSE, &hi, &lo,
+                                   FALSE);
+    mem_barrier();
+    (void) *(volatile CARD32 *) ring->lastPause;
+
+    command = (HC_SubA_HAGPCMNT << 24) | (start >> 24) |
+              ((end & 0xFF000000) >> 16);
+
+    VIASETREG(VIA_REG_TRANSET, HC_ParaType_PreCR << 16);
+    VIASETREG(VIA_REG_TRANSPACE, command);
+    VIASETREG(VIA_REG_TRANSPACE,
+              (HC_SubA_HAGPBstL << 24) | (start & 0xFFFFFF));
+    VIASETREG(VIA_REG_TRANSPACE,
+              (HC_SubA_HAGPBendL << 24) | (end & 0xFFFFFF));
+    VIASETREG(VIA_REG_TRANSPACE, hi);
+    VIASETREG(VIA_REG_TRANSPACE, lo);
+    mem_barrier();
+    VIASETREG(VIA_REG_TRANSPACE, command | HC_HAGPCMNT_MASK);
+    (void) VIAGETREG(VIA_REG_TRANSPACE);
+
+    /*
+     * The reader register runs a fixed distance from the pause address,
+     * which differs between chipsets.
+     */
+    while (!viaRingPaused(pVia) && (loop++ < VIA_RING_TIMEOUT)) ;
+    ring->diff = viaRingPauseAddr(ring, ring->lastPause) -
+                 viaRingReader(pVia);
+
+    ring->running = TRUE;
+    pVia->agpDMA = TRUE;
+}
+
+/*
+ * Turn the ring off without relying on the regulator, for when it does
+ * not fetch at all.
+ */
+static void
+viaRingDisable(VIAPtr pVia)
+{
+    VIASETREG(VIA_REG_TRANSET, HC_ParaType_PreCR << 16);
+    VIASETREG(VIA_REG_TRANSPACE, HC_SubA_HAGPCMNT << 24);
+    (void) VIAGETREG(VIA_REG_TRANSPACE);
+
+    pVia->ring.running = FALSE;
+    pVia->agpDMA = FALSE;
+}
+
+/*
+ * Stop the regulator at the end of what was submitted and wait for the
+ * engines. Whatever is emitted afterwards goes over MMIO.
+ */
+static void
+viaRingStop(ScrnInfoPtr pScrn)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    CARD32 hi, lo;
+
+    if (!pVia->ring.running)
+        return;
+
+    viaRingWaitIdle(pVia);
+    viaRingAlign(pVia, HC_HAGPBpID_STOP, &hi, &lo, TRUE);
+    viaRingHook(pVia, hi, lo);
+
+    pVia->ring.running = FALSE;
+    pVia->agpDMA = FALSE;
+    viaAccelSync(pScrn);
+    pVia->lastMarkerRead = pVia->curMarker;
+}
+
+/*
+ * Wait until the regulator has fetched everything up to the last pause.
+ * viaAccelSync only sees the engines, which may run dry before it does.
+ */
+Bool
+viaRingWaitIdle(VIAPtr pVia)
+{
+    ViaRing *ring = &pVia->ring;
+    CARD32 ptr = viaRingPauseAddr(ring, ring->lastPause);
+    unsigned loop = 0;
+
+    while (loop++ < VIA_RING_TIMEOUT) {
+        if (viaRingPaused(pVia) && (ptr - viaRingReader(pVia) == ring->diff))
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/*
+ * Flush function of the command buffer while the ring is set up.
+ */
+void
+viaRingFlush(VIAPtr pVia, ViaCommandBuffer *cb)
+{
+    ViaRing *ring = &pVia->ring;
+    unsigned size = cb->pos << 2;
+    CARD64 start;
+    CARD32 hi, lo;
+    CARD32 *vb;
+    int pad;
+
+    if (!ring->running) {
+        viaFlushPCI(pVia, cb);
+        return;
+    }
+
+    if (!cb->pos)
+        return;
+
+    start = viaCostTime();
+    if (!viaRingSpace(pVia, size + 2 * VIA_RING_ALIGN)) {
+        ErrorF("Command ring stalled, falling back to MMIO.\n");
+        viaRingDisable(pVia);
+        ring->enabled = FALSE;
+        viaFlushPCI(pVia, cb);
+        return;
+    }
+
+    vb = ring->virt + (ring->low >> 2);
+    memcpy(vb, cb->buf, size);
+    vb += cb->pos;
+
+    /* End on a 2D register write, in quadwords, as the DRM path does. */
+    *vb++ = H1_ADDR(0x2f8);
+    *vb++ = 0x67676767;
+    if (cb->pos & 1)
+        *vb++ = HC_DUMMY;
+    ring->low = (vb - ring->virt) << 2;
+
+    /* Keep short submissions from sharing a fetch with the pause. */
+    if (size < VIA_RING_ALIGN) {
+        viaRingOut(ring, HALCYON_HEADER2, HC_ParaType_NotTex << 16);
+        for (pad = (VIA_RING_ALIGN - size) >> 3; pad > 0; pad--)
+            viaRingOut(ring, HC_DUMMY, HC_DUMMY);
+    }
+
+    viaRingAlign(pVia, HC_HAGPBpID_PAUSE, &hi, &lo, TRUE);
+    viaRingHook(pVia, hi, lo);
+
+    cb->pos = 0;
+    cb->mode = 0;
+    cb->has3dState = FALSE;
+    viaMarkerSubmitted(pVia);
+    VIA_COUNT(pVia, VIA_COUNTER_SUBMITS, 1);
+    VIA_COUNT(pVia, VIA_COUNTER_DWORDS, size >> 2);
+    viaCostSample(pVia, &pVia->cost.submit, size >> 2, start);
+}
+
+/*
+ * Set up the ring after the engines have been initialized, and see that
+ * a marker comes back through it.
+ */
+void
+viaRingInit(ScrnInfoPtr pScrn)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    ViaRing *ring = &pVia->ring;
+    ExaDriverPtr pExa = pVia->exaDriverPtr;
+    int marker, i;
+
+    if ((pVia->directRenderingType != DRI_NONE) || (!pExa) ||
+        (!pVia->agpEnable) || (!pVia->dma2d))
+        return;
+
+    /* These have their regulator behind 0x41c/0x420. */
+    switch (pVia->Chipset) {
+    case VIA_K8M890:
+    case VIA_P4M900:
+    case VIA_VX800:
+    case VIA_VX855:
+    case VIA_VX900:
+        return;
+    default:
+        break;
+    }
+
+    ring->bo = drm_bo_alloc(pScrn, VIA_RING_SIZE, VIA_RING_ALIGN,
+                            TTM_PL_VRAM);
+    if (!ring->bo) {
+        xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+                   "No room for a command ring, using MMIO.\n");
+        return;
+    }
+    ring->virt = drm_bo_map(pScrn, ring->bo);
+    if (!ring->virt) {
+        viaRingFini(pScrn);
+        return;
+    }
+    ring->base = pVia->FrameBufferBase + ring->bo->offset;
+    ring->size = VIA_RING_SIZE;
+
+    switch (pVia->ChipId) {
+    case PCI_CHIP_VT3314:
+    case PCI_CHIP_VT3259:
+        ring->regPause = 0x40c;
+        break;
+    default:
+        ring->regPause = 0x418;
+        break;
+    }
+
+    viaRingStart(pVia);
+    pVia->cb.flushFunc = viaRingFlush;
+
+    viaMarkerSubmitted(pVia);
+    marker = pExa->MarkSync(pScrn->pScreen);
+    for (i = 0; i < VIA_RING_TEST_MS; i++) {
+        if (*(volatile CARD32 *) pVia->markerBuf == marker)
+            break;
+        usleep(1000);
+    }
+
+    /* A stalled ring has handed the marker to MMIO already. */
+    if ((i == VIA_RING_TEST_MS) || !ring->running ||
+        !viaRingWaitIdle(pVia)) {
+        xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+                   "The command regulator does not fetch from video "
+                   "memory, using MMIO.\n");
+        viaRingDisable(pVia);
+        viaAccelSync(pScrn);
+        viaRingFini(pScrn);
+        viaMarkerInit(pVia);
+        return;
+    }
+
+    pVia->lastMarkerRead = marker;
+    ring->enabled = TRUE;
+    xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+               "Using a %d kB command ring in video memory.\n",
+               VIA_RING_SIZE >> 10);
+}
+
+/*
+ * Around VT switches. The console does not touch the regulator, but it
+ * must not be left fetching while we are away.
+ */
+void
+viaRingSuspend(ScrnInfoPtr pScrn)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+
+    if (pVia->ring.running)
+        viaRingStop(pScrn);
+}
+
+void
+viaRingResume(ScrnInfoPtr pScrn)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+
+    if (pVia->ring.enabled && !pVia->ring.running)
+        viaRingStart(pVia);
+}
+
+void
+viaRingFini(ScrnInfoPtr pScrn)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    ViaRing *ring = &pVia->ring;
+
+    viaRingStop(pScrn);
+    if (pVia->cb.flushFunc == viaRingFlush)
+        pVia->cb.flushFunc = viaFlushPCI;
+
+    if (ring->bo) {
+        drm_bo_free(pScrn, ring->bo);
+        ring->bo = NULL;
+    }
+    ring->virt = NULL;
+    ring->enabled = FALSE;
+}
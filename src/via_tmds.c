@@ -553,7 +553,9 @@ via_tmds_detect(xf86OutputPtr output)
     }
 
     if (pI2CBus) {
+        viaTraceBegin("xf86OutputGetEDID", output->name);
         pMon = xf86OutputGetEDID(output, pI2CBus);
+        viaTraceEnd();
         if (pMon && DIGITAL(pMon->features.input_type)) {
             status = XF86OutputStatusConnected;
             xf86OutputSetEDID(output, pMon);
@@ -0,0 +1,204 @@
+/*
+ * Copyright 2026 The OpenChrome Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Phase tracer.
+ *
+ * Probe, PreInit, ScreenInit, output probing, I2C and EDID transactions,
+ * register save and restore, mode sets and VT switches are bracketed by
+ * viaTraceBegin() and viaTraceEnd(). Each records a name, an optional
+ * detail such as the output name, and a timestamp in a ring buffer that
+ * keeps the latest VIA_TRACE_EVENTS events, so a long session loses its
+ * oldest phases rather than its newest. Probe runs before there is a
+ * screen, so the buffer belongs to the module and is shared by all
+ * screens. Recording is always on; it costs
+ * a clock read per event, next to phases that take milliseconds.
+ *
+ * With Option "TraceFile" the buffer is written there in the Chrome
+ * trace event format, which chrome://tracing and Perfetto load, at the
+ * end of ScreenInit, when the screen closes and whenever a client sets
+ * the root window property _OPENCHROME_TRACE_DUMP.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <unistd.h>
+
+#include "via_driver.h"
+
+#define VIA_TRACE_EVENTS    4096
+#define VIA_TRACE_DEPTH     32
+#define VIA_TRACE_DETAIL    16
+
+typedef struct _ViaTraceEvent {
+    const char *name;
+    CARD64 ts;
+    char ph;
+    char detail[VIA_TRACE_DETAIL];
+} ViaTraceEvent;
+
+static ViaTraceEvent viaTraceEvents[VIA_TRACE_EVENTS];
+static CARD64 viaTraceCount;
+static unsigned viaTraceDropped;
+
+/* Names of the open phases, NULL for those that were not recorded. */
+static const char *viaTraceStack[VIA_TRACE_DEPTH];
+static unsigned viaTraceDepth;
+
+static void
+viaTraceRecord(char ph, const char *name, const char *detail)
+{
+    ViaTraceEvent *e = &viaTraceEvents[viaTraceCount++ % VIA_TRACE_EVENTS];
+
+    e->name = name;
+    e->ts = GetTimeInMicros();
+    e->ph = ph;
+    if (detail)
+        snprintf(e->detail, sizeof(e->detail), "%s", detail);
+    else
+        e->detail[0] = '\0';
+}
+
+/*
+ * Open a phase. The name must be a string constant; the detail is
+ * copied.
+ */
+void
+viaTraceBegin(const char *name, const char *detail)
+{
+    /* Phases nested deeper than the stack are not recorded. */
+    Bool keep = viaTraceDepth < VIA_TRACE_DEPTH;
+
+    if (viaTraceDepth < VIA_TRACE_DEPTH)
+        viaTraceStack[viaTraceDepth] = keep ? name : NULL;
+    viaTraceDepth++;
+
+    if (keep)
+        viaTraceRecord('B', name, detail);
+    else
+        viaTraceDropped++;
+}
+
+/*
+ * Close the innermost open phase.
+ */
+void
+viaTraceEnd(void)
+{
+    if (!viaTraceDepth)
+        return;
+
+    viaTraceDepth--;
+    if (viaTraceDepth < VIA_TRACE_DEPTH && viaTraceStack[viaTraceDepth])
+        viaTraceRecord('E', viaTraceStack[viaTraceDepth], NULL);
+}
+
+/*
+ * Write a JSON string, escaping what JSON does not allow in one.
+ */
+static void
+viaTraceString(FILE *f, const char *str)
+{
+    const unsigned char *p;
+
+    fputc('"', f);
+    for (p = (const unsigned char *)str; *p; p++) {
+        if (*p == '"' || *p == '\\')
+            fprintf(f, "\\%c", *p);
+        else if (*p < 0x20)
+            fprintf(f, "\\u%04x", *p);
+        else
+            fputc(*p, f);
+    }
+    fputc('"', f);
+}
+
+/*
+ * Write the buffer to the trace file, if one is configured.
+ */
+void
+viaTraceWrite(ScrnInfoPtr pScrn)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    CARD64 first = (viaTraceCount > VIA_TRACE_EVENTS) ?
+                   viaTraceCount - VIA_TRACE_EVENTS : 0;
+    CARD64 base = viaTraceEvents[first % VIA_TRACE_EVENTS].ts;
+    unsigned written = 0, depth = 0;
+    FILE *f;
+    CARD64 i;
+
+    if (!pVia->traceFile)
+        return;
+
+    f = fopen(pVia->traceFile, "w");
+    if (!f) {
+        xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+                   "Cannot write the trace to %s: %s.\n",
+                   pVia->traceFile, strerror(errno));
+        return;
+    }
+
+    fprintf(f, "{\"traceEvents\":[");
+    for (i = first; i < viaTraceCount; i++) {
+        ViaTraceEvent *e = &viaTraceEvents[i % VIA_TRACE_EVENTS];
+
+        /* Skip the ends of phases whose beginning was overwritten. */
+        if (e->ph == 'E') {
+            if (!depth)
+                continue;
+            depth--;
+        } else {
+            depth++;
+        }
+
+        fprintf(f, "%s\n{\"name\":", written++ ? "," : "");
+        viaTraceString(f, e->name);
+        fprintf(f, ",\"cat\":\"openchrome\",\"ph\":\"%c\",\"ts\":%llu,"
+                "\"pid\":%d,\"tid\":1", e->ph,
+                (unsigned long long)(e->ts - base), (int)getpid());
+        if (e->detail[0]) {
+            fprintf(f, ",\"args\":{\"detail\":");
+            viaTraceString(f, e->detail);
+            fprintf(f, "}");
+        }
+        fprintf(f, "}");
+    }
+    fprintf(f, "\n],\"displayTimeUnit\":\"ms\","
+            "\"otherData\":{\"dropped\":%u,\"overwritten\":%llu}}\n",
+            viaTraceDropped, (unsigned long long) first);
+
+    if (fclose(f)) {
+        xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+                   "Cannot write the trace to %s: %s.\n",
+                   pVia->traceFile, strerror(errno));
+        return;
+    }
+
+    xf86DrvMsgVerb(pScrn->scrnIndex, X_INFO, 3,
+                   "Wrote %u trace events to %s (%u dropped, "
+                   "%llu overwritten).\n", written, pVia->traceFile,
+                   viaTraceDropped, (unsigned long long) first);
+}
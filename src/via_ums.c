@@ -190,6 +190,8 @@ viaMapMMIO(ScrnInfoPtr pScrn)
 
     vgaHWGetIOBase(hwp);
 
+    viaRegShadowInit(pScrn);
+
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                         "Exiting viaMapMMIO.\n"));
     return TRUE;
@@ -235,6 +237,7 @@ viaUnmapMMIO(ScrnInfoPtr pScrn)
                         "Entered viaUnmapMMIO.\n"));
 
     viaMMIODisable(pScrn);
+    viaRegShadowFini(pScrn);
 
 #ifdef XSERVER_LIBPCIACCESS
     if (pVia->BltBase) {
@@ -686,8 +689,9 @@ viaUMSAccelInit(ScrnInfoPtr pScrn)
     pVia->markerBuf = drm_bo_map(pScrn, pVia->exa_sync_bo);
     if (!pVia->markerBuf)
         goto err;
-    pVia->curMarker = 0;
-    pVia->lastMarkerRead = 0;
+    viaMarkerInit(pVia);
+
+    viaRingInit(pScrn);
 
 #ifdef OPENCHROMEDRI
     pVia->dBounce = NULL;
@@ -898,6 +902,8 @@ viaProbeVRAM(ScrnInfoPtr pScrn)
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                         "Entered viaProbeVRAM.\n"));
 
+    viaTraceBegin("viaProbeVRAM", NULL);
+
 #ifdef XSERVER_LIBPCIACCESS
     hostBridge = pci_device_find_by_slot(0, 0, 0, 0);
     hostBridgeVendorID = VENDOR_ID(hostBridge);
@@ -1076,6 +1082,7 @@ viaProbeVRAM(ScrnInfoPtr pScrn)
     }
 
 exit:
+    viaTraceEnd();
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                         "Exiting viaProbeVRAM.\n"));
     return status;
@@ -1166,6 +1173,8 @@ viaSaveOriginalRegisters(ScrnInfoPtr pScrn)
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                         "Entered %s.\n", __func__));
 
+    viaTraceBegin("viaSaveOriginalRegisters", NULL);
+
     vgaHWSave(pScrn, &hwp->SavedReg, VGA_SR_ALL);
 
     /* Unlock extended registers. */
@@ -1312,6 +1321,8 @@ viaSaveOriginalRegisters(ScrnInfoPtr pScrn)
         }
     }
 
+    viaTraceEnd();
+
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                         "Exiting %s.\n", __func__));
 }
@@ -1338,6 +1349,8 @@ viaUMSPreInit(ScrnInfoPtr pScrn)
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                         "Entered %s.\n", __func__));
 
+    viaTraceBegin("viaUMSPreInit", NULL);
+
     /*
      * Initialize special flag registers to handle "quirky"
      * hardware.
@@ -1438,7 +1451,9 @@ viaUMSPreInit(ScrnInfoPtr pScrn)
     if (!xf86LoadSubModule(pScrn, "i2c")) {
         goto free_mmio;
     } else {
+        viaTraceBegin("ViaI2CInit", NULL);
         ViaI2CInit(pScrn);
+        viaTraceEnd();
     }
 
     if (!xf86LoadSubModule(pScrn, "ddc")) {
@@ -1530,13 +1545,19 @@ viaUMSPreInit(ScrnInfoPtr pScrn)
 
     xf86CrtcSetSizeRange(pScrn, 320, 200, max_pitch, max_height);
 
+    viaTraceBegin("viaInitDisplay", NULL);
     viaInitDisplay(pScrn);
+    viaTraceEnd();
 
+    /* Output detection and EDID reads. */
+    viaTraceBegin("xf86InitialConfiguration", NULL);
     status = xf86InitialConfiguration(pScrn, TRUE);
+    viaTraceEnd();
     goto exit;
 free_mmio:
     viaUnmapMMIO(pScrn);
 exit:
+    viaTraceEnd();
     DEBUG(xf86DrvMsg(pScrn->scrnIndex, X_INFO,
                         "Exiting %s.\n", __func__));
     return status;
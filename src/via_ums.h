@@ -1754,6 +1754,8 @@ void viaIGA2SetDisplayRegister(ScrnInfoPtr pScrn, DisplayModePtr mode);
 void viaIGA2Save(ScrnInfoPtr pScrn);
 void viaIGA2Restore(ScrnInfoPtr pScrn);
 void ViaShadowCRTCSetMode(ScrnInfoPtr pScrn, DisplayModePtr mode);
+void viaCursorCacheReset(xf86CrtcPtr crtc);
+void viaLUTShadowReset(xf86CrtcPtr crtc);
 extern const xf86CrtcFuncsRec via_crtc_funcs;
 
 /* via_analog.c */
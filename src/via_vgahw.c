@@ -24,6 +24,15 @@
 /*
  * Wrappers around xf86 vgaHW functions.
  * And some generic IO calls lacking in the current vgaHW implementation.
+ *
+ * The extended CR, SR and GR registers are shadowed. Every indexed
+ * access costs an index write plus a data read or write, and mode
+ * setting, DPMS and output code mostly do masked updates of registers
+ * the driver wrote itself. With the shadow, reads of those registers
+ * are served from memory and writes of the value already there are
+ * dropped. Only registers known to hold plain configuration are
+ * shadowed; status, sense, strobe and bank select registers, and any
+ * register not listed, are always passed through.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -34,6 +43,221 @@
 #include "xf86.h"
 #include "via_driver.h" /* for HAVE_DEBUG */
 
+/* An indexed access is an index write and a data cycle. */
+#define VIA_REG_CYCLES  2
+
+#define VIA_REG_VALID(bank, index) \
+    ((bank)->valid[(index) >> 5] & (1U << ((index) & 31)))
+
+static Bool
+viaShadowedCR(CARD8 index)
+{
+    /*
+     * CR00-CR2F are VGA and attribute controller state. CR3B-CR3F are
+     * scratch pads the BIOS also writes, e.g. from its SMI handlers on
+     * lid and hotkey events.
+     */
+    return index >= 0x30 && (index < 0x3B || index > 0x3F);
+}
+
+static Bool
+viaShadowedSR(CARD8 index)
+{
+    /*
+     * Only the display, memory and PLL configuration the driver programs
+     * is shadowed. Left out are the lock and bank selects (SR10, SR5A),
+     * strapping (SR12, SR13), registers with sense or RW1C status bits
+     * (SR1A, SR2B), GPIO and I2C (SR25, SR26, SR2C, SR31, SR3D) and the
+     * CRT sense and PLL reset strobes (SR40).
+     */
+    return (index >= 0x14 && index <= 0x19) ||
+           (index >= 0x1B && index <= 0x24) ||
+           (index >= 0x27 && index <= 0x2A) ||
+           (index >= 0x2D && index <= 0x30) ||
+           (index == 0x3F) ||
+           (index >= 0x44 && index <= 0x4F) ||
+           (index >= 0x68 && index <= 0x6F);
+}
+
+static Bool
+viaShadowedGR(CARD8 index)
+{
+    return index >= 0x20;
+}
+
+static CARD8
+viaShadowRead(vgaHWPtr hwp, ViaRegBank *bank, Bool shadowed, CARD8 index,
+              CARD8 (*read) (vgaHWPtr, CARD8))
+{
+    VIAPtr pVia = VIAPTR(hwp->pScrn);
+    ViaRegShadow *shadow = &pVia->regShadow;
+    CARD8 value;
+
+    if (shadowed && VIA_REG_VALID(bank, index)) {
+        shadow->saved += VIA_REG_CYCLES;
+        VIA_COUNT(pVia, VIA_COUNTER_REG_CYCLES_SAVED, VIA_REG_CYCLES);
+        return bank->val[index];
+    }
+
+    value = read(hwp, index);
+    shadow->cycles += VIA_REG_CYCLES;
+    if (shadowed) {
+        bank->val[index] = value;
+        bank->valid[index >> 5] |= 1U << (index & 31);
+    }
+    return value;
+}
+
+static void
+viaShadowWrite(vgaHWPtr hwp, ViaRegBank *bank, Bool shadowed, CARD8 index,
+               CARD8 value, void (*write) (vgaHWPtr, CARD8, CARD8))
+{
+    VIAPtr pVia = VIAPTR(hwp->pScrn);
+    ViaRegShadow *shadow = &pVia->regShadow;
+
+    if (shadowed && VIA_REG_VALID(bank, index) &&
+        bank->val[index] == value) {
+        shadow->saved += VIA_REG_CYCLES;
+        VIA_COUNT(pVia, VIA_COUNTER_REG_CYCLES_SAVED, VIA_REG_CYCLES);
+        return;
+    }
+
+    write(hwp, index, value);
+    shadow->cycles += VIA_REG_CYCLES;
+    if (shadowed) {
+        bank->val[index] = value;
+        bank->valid[index >> 5] |= 1U << (index & 31);
+    }
+}
+
+static CARD8
+viaShadowReadCrtc(vgaHWPtr hwp, CARD8 index)
+{
+    ViaRegShadow *shadow = &VIAPTR(hwp->pScrn)->regShadow;
+
+    return viaShadowRead(hwp, &shadow->cr, viaShadowedCR(index), index,
+                         shadow->readCrtc);
+}
+
+static void
+viaShadowWriteCrtc(vgaHWPtr hwp, CARD8 index, CARD8 value)
+{
+    ViaRegShadow *shadow = &VIAPTR(hwp->pScrn)->regShadow;
+
+    viaShadowWrite(hwp, &shadow->cr, viaShadowedCR(index), index, value,
+                   shadow->writeCrtc);
+}
+
+static CARD8
+viaShadowReadSeq(vgaHWPtr hwp, CARD8 index)
+{
+    ViaRegShadow *shadow = &VIAPTR(hwp->pScrn)->regShadow;
+
+    return viaShadowRead(hwp, &shadow->sr, viaShadowedSR(index), index,
+                         shadow->readSeq);
+}
+
+static void
+viaShadowWriteSeq(vgaHWPtr hwp, CARD8 index, CARD8 value)
+{
+    ViaRegShadow *shadow = &VIAPTR(hwp->pScrn)->regShadow;
+
+    viaShadowWrite(hwp, &shadow->sr, viaShadowedSR(index), index, value,
+                   shadow->writeSeq);
+
+    /* SR5A switches some SR registers to another bank. */
+    if (index == 0x5A)
+        memset(shadow->sr.valid, 0, sizeof(shadow->sr.valid));
+}
+
+static CARD8
+viaShadowReadGr(vgaHWPtr hwp, CARD8 index)
+{
+    ViaRegShadow *shadow = &VIAPTR(hwp->pScrn)->regShadow;
+
+    return viaShadowRead(hwp, &shadow->gr, viaShadowedGR(index), index,
+                         shadow->readGr);
+}
+
+static void
+viaShadowWriteGr(vgaHWPtr hwp, CARD8 index, CARD8 value)
+{
+    ViaRegShadow *shadow = &VIAPTR(hwp->pScrn)->regShadow;
+
+    viaShadowWrite(hwp, &shadow->gr, viaShadowedGR(index), index, value,
+                   shadow->writeGr);
+}
+
+/*
+ * Forgets the shadowed values. Needed whenever something else may have
+ * programmed the hardware, e.g. the console after a VT switch.
+ */
+void
+viaRegShadowReset(ScrnInfoPtr pScrn)
+{
+    ViaRegShadow *shadow = &VIAPTR(pScrn)->regShadow;
+
+    memset(shadow->cr.valid, 0, sizeof(shadow->cr.valid));
+    memset(shadow->sr.valid, 0, sizeof(shadow->sr.valid));
+    memset(shadow->gr.valid, 0, sizeof(shadow->gr.valid));
+}
+
+/*
+ * Route the indexed register accesses through the shadow. Called once
+ * vgaHW has its MMIO functions. A shadow per screen would go stale when
+ * two screens drive the same chip, so shared entities go without.
+ */
+void
+viaRegShadowInit(ScrnInfoPtr pScrn)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    vgaHWPtr hwp = VGAHWPTR(pScrn);
+    ViaRegShadow *shadow = &pVia->regShadow;
+
+    if (!pVia->regShadowEnable || shadow->installed ||
+        xf86IsEntityShared(pScrn->entityList[0]))
+        return;
+
+    shadow->readCrtc = hwp->readCrtc;
+    shadow->writeCrtc = hwp->writeCrtc;
+    shadow->readSeq = hwp->readSeq;
+    shadow->writeSeq = hwp->writeSeq;
+    shadow->readGr = hwp->readGr;
+    shadow->writeGr = hwp->writeGr;
+    viaRegShadowReset(pScrn);
+
+    hwp->readCrtc = viaShadowReadCrtc;
+    hwp->writeCrtc = viaShadowWriteCrtc;
+    hwp->readSeq = viaShadowReadSeq;
+    hwp->writeSeq = viaShadowWriteSeq;
+    hwp->readGr = viaShadowReadGr;
+    hwp->writeGr = viaShadowWriteGr;
+    shadow->installed = TRUE;
+}
+
+void
+viaRegShadowFini(ScrnInfoPtr pScrn)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    vgaHWPtr hwp = VGAHWPTR(pScrn);
+    ViaRegShadow *shadow = &pVia->regShadow;
+
+    if (!shadow->installed)
+        return;
+
+    hwp->readCrtc = shadow->readCrtc;
+    hwp->writeCrtc = shadow->writeCrtc;
+    hwp->readSeq = shadow->readSeq;
+    hwp->writeSeq = shadow->writeSeq;
+    hwp->readGr = shadow->readGr;
+    hwp->writeGr = shadow->writeGr;
+    shadow->installed = FALSE;
+
+    xf86DrvMsgVerb(pScrn->scrnIndex, X_INFO, 3,
+                   "Register shadow saved %lu of %lu register cycles.\n",
+                   shadow->saved, shadow->saved + shadow->cycles);
+}
+
 void
 ViaCrtcMask(vgaHWPtr hwp, CARD8 index, CARD8 value, CARD8 mask)
 {
@@ -25,9 +25,34 @@
 
 #include "vgaHW.h"
 
+/* Cached copy of one indexed register space. */
+typedef struct _ViaRegBank {
+    CARD8 val[256];
+    CARD32 valid[256 / 32];
+} ViaRegBank;
+
+/* Shadow of the extended CR, SR and GR registers, see via_vgahw.c. */
+typedef struct _ViaRegShadow {
+    CARD8 (*readCrtc) (vgaHWPtr, CARD8);
+    void (*writeCrtc) (vgaHWPtr, CARD8, CARD8);
+    CARD8 (*readSeq) (vgaHWPtr, CARD8);
+    void (*writeSeq) (vgaHWPtr, CARD8, CARD8);
+    CARD8 (*readGr) (vgaHWPtr, CARD8);
+    void (*writeGr) (vgaHWPtr, CARD8, CARD8);
+    ViaRegBank cr;
+    ViaRegBank sr;
+    ViaRegBank gr;
+    Bool installed;
+    unsigned long cycles;
+    unsigned long saved;
+} ViaRegShadow;
+
 void ViaCrtcMask(vgaHWPtr hwp, CARD8 index, CARD8 value, CARD8 mask);
 void ViaSeqMask(vgaHWPtr hwp, CARD8 index, CARD8 value, CARD8 mask);
 void ViaGrMask(vgaHWPtr hwp, CARD8 index, CARD8 value, CARD8 mask);
+void viaRegShadowInit(ScrnInfoPtr pScrn);
+void viaRegShadowFini(ScrnInfoPtr pScrn);
+void viaRegShadowReset(ScrnInfoPtr pScrn);
 
 #ifdef HAVE_DEBUG
 void ViaVgahwPrint(vgaHWPtr hwp);
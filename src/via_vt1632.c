@@ -389,7 +389,9 @@ via_vt1632_get_modes(xf86OutputPtr output)
     }
 
     if (pI2CBus) {
+        viaTraceBegin("xf86OutputGetEDID", output->name);
         pMon = xf86OutputGetEDID(output, pI2CBus);
+        viaTraceEnd();
 
         /* Is the interface type digital? */
         if (pMon && DIGITAL(pMon->features.input_type)) {
@@ -62,6 +62,11 @@
 #define LOW_BAND 0x0CB0
 #define MID_BAND 0x1f10
 
+/* Words sampled to recognise a resubmitted frame. */
+#define VIA_XV_HASH_SAMPLES 4096
+/* Resubmitted frames skipped before one is uploaded regardless. */
+#define VIA_XV_MAX_REPEATS  30
+
 #define  XV_IMAGE          0
 #define MAKE_ATOM(a) MakeAtom(a, sizeof(a) - 1, TRUE)
 #ifndef XvExtension
@@ -105,13 +110,15 @@ static int viaSetPortAttribute(ScrnInfoPtr, Atom, INT32, pointer);
 static int viaPutImage(ScrnInfoPtr, short, short, short, short, short, short,
     short, short, int, unsigned char *, short, short, Bool,
     RegionPtr, pointer, DrawablePtr);
+static int viaReputImage(ScrnInfoPtr, short, short, short, short, short, short,
+    short, short, RegionPtr, pointer, DrawablePtr);
 static void nv12Blit(unsigned char *nv12Chroma,
     const unsigned char *uBuffer,
     const unsigned char *vBuffer,
     unsigned width, unsigned srcPitch, unsigned dstPitch, unsigned lines);
 
 static Atom xvBrightness, xvContrast, xvColorKey, xvHue, xvSaturation,
-    xvAutoPaint;
+    xvAutoPaint, xvDeinterlace, xvDeblock;
 
 /*
  *  S T R U C T S
@@ -135,7 +142,7 @@ static XF86VideoFormatRec FormatsG[NUM_FORMATS_G] = {
     {24, DirectColor}
 };
 
-#define NUM_ATTRIBUTES_G 6
+#define NUM_ATTRIBUTES_G 8
 
 static char attributeXvColorkey[] = { "XV_COLORKEY" };
 static char attributeXvBrightness[] = { "XV_BRIGHTNESS" };
@@ -144,6 +151,8 @@ static char attributeXvSaturation[] = { "XV_SATURATION" };
 static char attributeXvHue[] = { "XV_HUE" };
 static char attributeXvAutopaintColorkey[] =
                                         { "XV_AUTOPAINT_COLORKEY" };
+static char attributeXvDeinterlace[] = { "XV_DEINTERLACE" };
+static char attributeXvDeblock[] = { "XV_DEBLOCK" };
 
 static XF86AttributeRec AttributesG[NUM_ATTRIBUTES_G] = {
     {XvSettable | XvGettable,      0,  (1 << 24) - 1,          attributeXvColorkey},
@@ -151,10 +160,13 @@ static XF86AttributeRec AttributesG[NUM_ATTRIBUTES_G] = {
     {XvSettable | XvGettable,      0,          20000,          attributeXvContrast},
     {XvSettable | XvGettable,      0,          20000,          attributeXvSaturation},
     {XvSettable | XvGettable,   -180,            180,                 attributeXvHue},
-    {XvSettable | XvGettable,      0,              1,   attributeXvAutopaintColorkey}
+    {XvSettable | XvGettable,      0,              1,   attributeXvAutopaintColorkey},
+    {XvSettable | XvGettable,      0,              2,         attributeXvDeinterlace},
+    {XvSettable | XvGettable,      0,              1,             attributeXvDeblock}
 };
 
-#define NUM_IMAGES_G 7
+/* The last image, NV12, is only offered by the CME engines. */
+#define NUM_IMAGES_G 8
 
 static XF86ImageRec ImagesG[NUM_IMAGES_G] = {
     XVIMAGE_YUY2,
@@ -237,6 +249,24 @@ static XF86ImageRec ImagesG[NUM_IMAGES_G] = {
         {   'R', 'V', 'B', 0,
             0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
             0, 0, 0, 0, 0, 0, 0, 0, 0},
+        XvTopToBottom},
+    { /* NV12, scanned by the CME engines as it is */
+        FOURCC_NV12,
+        XvYUV,
+        LSBFirst,
+        {   'N', 'V', '1', '2',
+            0x00, 0x00, 0x00, 0x10, 0x80, 0x00, 0x00, 0xAA, 0x00,
+            0x38, 0x9B, 0x71},
+        12,
+        XvPlanar,
+        2,
+        0, 0, 0, 0,
+        8, 8, 8,
+        1, 2, 2,
+        1, 2, 2,
+        {   'Y', 'U', 'V',
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
         XvTopToBottom}
 
 };
@@ -623,6 +653,9 @@ viaExitVideo(ScrnInfoPtr pScrn)
     }
     if (allAdaptors)
         free(allAdaptors);
+
+    TimerFree(pVia->swov.fieldTimer);
+    pVia->swov.fieldTimer = NULL;
 }
 
 void
@@ -664,8 +697,11 @@ viaInitVideo(ScreenPtr pScreen)
         xf86DrvMsg(pScrn->scrnIndex, X_INFO,
             "[Xv] Using PCI DMA for Xv image transfer.\n");
 
-    if (!viaFastVidCpy)
+    if (!viaFastVidCpy) {
+        viaTraceBegin("viaVidCopyInit", "video");
         viaFastVidCpy = viaVidCopyInit("video", pScreen);
+        viaTraceEnd();
+    }
 
     if ((pVia->Chipset == VIA_CLE266) || (pVia->Chipset == VIA_KM400) ||
         (pVia->Chipset == VIA_K8M800) || (pVia->Chipset == VIA_PM800) ||
@@ -713,6 +749,7 @@ static unsigned
 viaSetupAdaptors(ScreenPtr pScreen, XF86VideoAdaptorPtr ** adaptors)
 {
     ScrnInfoPtr pScrn = xf86ScreenToScrn(pScreen);
+    VIAPtr pVia = VIAPTR(pScrn);
     int i, j, usedPorts, numPorts;
     viaPortPrivPtr pPriv;
     DevUnion *pdevUnion;
@@ -725,6 +762,8 @@ viaSetupAdaptors(ScreenPtr pScreen, XF86VideoAdaptorPtr ** adaptors)
     xvHue = MAKE_ATOM("XV_HUE");
     xvSaturation = MAKE_ATOM("XV_SATURATION");
     xvAutoPaint = MAKE_ATOM("XV_AUTOPAINT_COLORKEY");
+    xvDeinterlace = MAKE_ATOM("XV_DEINTERLACE");
+    xvDeblock = MAKE_ATOM("XV_DEBLOCK");
 
     *adaptors = NULL;
     usedPorts = 0;
@@ -761,7 +800,8 @@ viaSetupAdaptors(ScreenPtr pScreen, XF86VideoAdaptorPtr ** adaptors)
         viaAdaptPtr[i]->nAttributes = NUM_ATTRIBUTES_G;
         viaAdaptPtr[i]->pAttributes = AttributesG;
 
-        viaAdaptPtr[i]->nImages = NUM_IMAGES_G;
+        viaAdaptPtr[i]->nImages = (pVia->VideoEngine == VIDEO_ENGINE_CME) ?
+                                  NUM_IMAGES_G : NUM_IMAGES_G - 1;
         viaAdaptPtr[i]->pImages = ImagesG;
         viaAdaptPtr[i]->PutVideo = NULL;
         viaAdaptPtr[i]->StopVideo = viaStopVideo;
@@ -769,7 +809,7 @@ viaSetupAdaptors(ScreenPtr pScreen, XF86VideoAdaptorPtr ** adaptors)
         viaAdaptPtr[i]->GetPortAttribute = viaGetPortAttribute;
         viaAdaptPtr[i]->SetPortAttribute = viaSetPortAttribute;
         viaAdaptPtr[i]->PutImage = viaPutImage;
-        viaAdaptPtr[i]->ReputImage = NULL;
+        viaAdaptPtr[i]->ReputImage = viaReputImage;
         viaAdaptPtr[i]->QueryImageAttributes = viaQueryImageAttributes;
         for (j = 0; j < numPorts; ++j) {
             pPriv[j].dmaBounceBuffer = NULL;
@@ -777,6 +817,8 @@ viaSetupAdaptors(ScreenPtr pScreen, XF86VideoAdaptorPtr ** adaptors)
             pPriv[j].dmaBounceLines = 0;
             pPriv[j].colorKey = 0x0821;
             pPriv[j].autoPaint = TRUE;
+            pPriv[j].deinterlace = VIA_DEINTERLACE_WEAVE;
+            pPriv[j].deblock = FALSE;
             pPriv[j].brightness = 5000.;
             pPriv[j].saturation = 10000;
             pPriv[j].contrast = 10000;
@@ -812,6 +854,8 @@ viaStopVideo(ScrnInfoPtr pScrn, pointer data, Bool exit)
     DBG_DD(ErrorF(" via_xv.c : viaStopVideo: exit=%d\n", exit));
 
     REGION_EMPTY(pScrn->pScreen, &pPriv->clip);
+    TimerCancel(pVia->swov.fieldTimer);
+    pVia->swov.lastFlipTime = 0;
     ViaOverlayHide(pScrn);
     if (exit) {
         ViaSwovSurfaceDestroy(pScrn, pPriv);
@@ -820,6 +864,7 @@ viaStopVideo(ScrnInfoPtr pScrn, pointer data, Bool exit)
         pPriv->dmaBounceBuffer = 0;
         pPriv->dmaBounceStride = 0;
         pPriv->dmaBounceLines = 0;
+        pPriv->frameHashValid = FALSE;
         pVia->dwFrameNum = 0;
         pPriv->old_drw_x = 0;
         pPriv->old_drw_y = 0;
@@ -854,6 +899,15 @@ viaSetPortAttribute(ScrnInfoPtr pScrn,
     } else if (attribute == xvAutoPaint) {
         pPriv->autoPaint = value;
         DBG_DD(ErrorF("       xvAutoPaint = %08lx\n", value));
+    } else if (attribute == xvDeinterlace || attribute == xvDeblock) {
+        if (attribute == xvDeinterlace)
+            pPriv->deinterlace = value;
+        else
+            pPriv->deblock = value;
+        DBG_DD(ErrorF("     xvDeinterlace = %d, xvDeblock = %d\n",
+                      pPriv->deinterlace, pPriv->deblock));
+        /* Force an overlay update on the next frame. */
+        REGION_EMPTY(pScrn->pScreen, &pPriv->clip);
         /* Color Control */
     } else if (attribute == xvBrightness ||
             attribute == xvContrast ||
@@ -905,6 +959,12 @@ viaGetPortAttribute(ScrnInfoPtr pScrn,
     } else if (attribute == xvAutoPaint) {
         *value = (INT32) pPriv->autoPaint;
         DBG_DD(ErrorF("    AutoPaint = %08ld\n", *value));
+    } else if (attribute == xvDeinterlace) {
+        *value = pPriv->deinterlace;
+        DBG_DD(ErrorF("    xvDeinterlace = %08ld\n", *value));
+    } else if (attribute == xvDeblock) {
+        *value = pPriv->deblock;
+        DBG_DD(ErrorF("    xvDeblock = %08ld\n", *value));
         /* Color Control */
     } else if (attribute == xvBrightness ||
             attribute == xvContrast ||
@@ -976,14 +1036,17 @@ Flip(VIAPtr pVia, viaPortPrivPtr pPriv, int fourcc,
             break;
         case FOURCC_YV12:
         case FOURCC_I420:
+        case FOURCC_NV12:
         default:
             while ((VIAGETREG(HQV_CONTROL + proReg) & HQV_SW_FLIP)
                     && --count);
             VIASETREG(HQV_SRC_STARTADDR_Y + proReg,
-                pVia->swov.SWDevice.dwSWPhysicalAddr[DisplayBufferIndex]);
+                pVia->swov.SWDevice.dwSWPhysicalAddr[DisplayBufferIndex] |
+                viaOverlayDeblockParam(pVia, FALSE));
             if (pVia->VideoEngine == VIDEO_ENGINE_CME) {
                 VIASETREG(HQV_SRC_STARTADDR_U + proReg,
-                pVia->swov.SWDevice.dwSWCrPhysicalAddr[DisplayBufferIndex]);
+                    pVia->swov.SWDevice.dwSWCrPhysicalAddr[DisplayBufferIndex] |
+                    viaOverlayDeblockParam(pVia, TRUE));
             } else {
                 VIASETREG(HQV_SRC_STARTADDR_U,
                     pVia->swov.SWDevice.dwSWCbPhysicalAddr[DisplayBufferIndex]);
@@ -996,11 +1059,54 @@ Flip(VIAPtr pVia, viaPortPrivPtr pPriv, int fourcc,
 }
 
 /*
- * Slow and dirty. NV12 blit.
+ * The HQV shows one field of the interleaved frame per flip. Bob and
+ * motion adaptive deinterlacing flip to the odd field half a frame
+ * interval after each new frame.
+ */
+static CARD32
+viaFieldFlip(OsTimerPtr timer, CARD32 now, pointer arg)
+{
+    ScrnInfoPtr pScrn = (ScrnInfoPtr) arg;
+    VIAPtr pVia = VIAPTR(pScrn);
+    unsigned long proReg = 0;
+    unsigned count = 50000;
+
+    if (!pScrn->vtSema || !(pVia->VideoStatus & VIDEO_SWOV_ON))
+        return 0;
+
+    if (pVia->ChipId == PCI_CHIP_VT3259
+        && !(pVia->swov.gdwVideoFlagSW & VIDEO_1_INUSE))
+        proReg = PRO_HQV1_OFFSET;
+
+    while ((VIAGETREG(HQV_CONTROL + proReg) & HQV_SW_FLIP) && --count);
+    VIASETREG(HQV_CONTROL + proReg, VIAGETREG(HQV_CONTROL + proReg) |
+              HQV_FLIP_ODD | HQV_SW_FLIP | HQV_FLIP_STATUS);
+    return 0;
+}
+
+static void
+viaScheduleFieldFlip(ScrnInfoPtr pScrn)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    CARD32 now = GetTimeInMillis();
+    CARD32 interval = now - pVia->swov.lastFlipTime;
+    CARD32 delay = 20;
+
+    /* Without a steady frame rate assume 25 frames per second. */
+    if (pVia->swov.lastFlipTime && interval >= 2 && interval <= 80)
+        delay = interval / 2;
+    pVia->swov.lastFlipTime = now;
+
+    pVia->swov.fieldTimer = TimerSet(pVia->swov.fieldTimer, 0, delay,
+                                     viaFieldFlip, pScrn);
+}
+
+/*
+ * Slow and dirty. NV12 blit of the lines top to top + lines.
  */
 static void
 nv12cp(unsigned char *dst, const unsigned char *src, int dstPitch,
-        int w, int h, int i420)
+        int w, int h, int top, int lines, int i420)
 {
     unsigned long srcUOffset, srcVOffset;
 
@@ -1015,9 +1121,151 @@ nv12cp(unsigned char *dst, const unsigned char *src, int dstPitch,
         srcVOffset = w * h;
     }
 
-    (*viaFastVidCpy) (dst, src, dstPitch, w >> 1, h, TRUE);
-    nv12Blit(dst + dstPitch * h, src + srcUOffset,
-            src + srcVOffset, w >> 1, w >>1, dstPitch, h >> 1);
+    srcUOffset += (top >> 1) * (w >> 1);
+    srcVOffset += (top >> 1) * (w >> 1);
+
+    (*viaFastVidCpy) (dst + top * dstPitch, src + top * w, dstPitch,
+            w >> 1, lines, TRUE);
+    nv12Blit(dst + dstPitch * (h + (top >> 1)), src + srcUOffset,
+            src + srcVOffset, w >> 1, w >>1, dstPitch, lines >> 1);
+}
+
+/*
+ * Copy rows top to top + lines of a plane with rows of rowBytes, an even
+ * number, as a fake YUY2 blit.
+ */
+static void
+viaXvCopyRows(unsigned char *dst, const unsigned char *src, int dstPitch,
+        int rowBytes, int top, int lines)
+{
+    (*viaFastVidCpy) (dst + top * dstPitch, src + top * rowBytes, dstPitch,
+            rowBytes >> 1, lines, TRUE);
+}
+
+/*
+ * Copy the rows of the source rectangle into the back surface. Planar
+ * images are widened to the groups of four lines the HQV fetches them
+ * in. Returns the number of bytes read.
+ */
+static unsigned long
+viaXvCopyImage(VIAPtr pVia, int id, const unsigned char *buf,
+        unsigned size, short width, short height, short src_y, short src_h)
+{
+    unsigned char *dst =
+        pVia->swov.SWDevice.lpSWOverlaySurface[pVia->dwFrameNum & 1];
+    int dstPitch = pVia->swov.SWDevice.dwPitch;
+    int top = src_y, bottom = src_y + src_h;
+    int lumaSize = width * height;
+    int chromaSize = (width >> 1) * (height >> 1);
+
+    if (id == FOURCC_YV12 || id == FOURCC_I420 || id == FOURCC_NV12) {
+        top &= ~3;
+        bottom = ALIGN_TO(bottom, 4);
+    }
+    if (top < 0)
+        top = 0;
+    if (bottom > height)
+        bottom = height;
+    if (bottom <= top)
+        return 0;
+
+    switch (id) {
+        case FOURCC_I420:
+        case FOURCC_YV12:
+            if (pVia->VideoEngine == VIDEO_ENGINE_CME) {
+                nv12cp(dst, buf, dstPitch, width, height, top, bottom - top,
+                        id == FOURCC_I420);
+            } else if (width & 3) {
+                /* Odd chroma rows; copy all planes in one go. */
+                (*viaFastVidCpy) (dst, buf, dstPitch, width, height, 0);
+                top = 0;
+                bottom = height;
+            } else {
+                viaXvCopyRows(dst, buf, dstPitch, width, top, bottom - top);
+                viaXvCopyRows(dst + dstPitch * height, buf + lumaSize,
+                        dstPitch >> 1, width >> 1, top >> 1,
+                        (bottom - top) >> 1);
+                viaXvCopyRows(dst + dstPitch * height +
+                        (dstPitch >> 1) * (height >> 1),
+                        buf + lumaSize + chromaSize,
+                        dstPitch >> 1, width >> 1, top >> 1,
+                        (bottom - top) >> 1);
+            }
+            break;
+        case FOURCC_NV12:
+            viaXvCopyRows(dst, buf, dstPitch, width, top, bottom - top);
+            viaXvCopyRows(dst + dstPitch * height, buf + lumaSize,
+                    dstPitch, width, top >> 1, (bottom - top) >> 1);
+            break;
+        case FOURCC_RV32:
+            viaXvCopyRows(dst, buf, dstPitch, width << 2, top, bottom - top);
+            break;
+        case FOURCC_UYVY:
+        case FOURCC_YUY2:
+        case FOURCC_RV15:
+        case FOURCC_RV16:
+        default:
+            viaXvCopyRows(dst, buf, dstPitch, width << 1, top, bottom - top);
+            break;
+    }
+
+    return (CARD64) size * (bottom - top) / height;
+}
+
+/*
+ * A hash of the image format, the source rectangle and words sampled
+ * evenly across the image. Players resubmit the frame on screen while
+ * paused; those are recognised without reading the whole image.
+ */
+static CARD32
+viaXvFrameHash(const unsigned char *buf, unsigned size, int id,
+        short width, short height,
+        short src_x, short src_y, short src_w, short src_h)
+{
+    CARD32 hash = 2166136261U, word;
+    unsigned i;
+
+    hash = (hash ^ id) * 16777619U;
+    hash = (hash ^ ((CARD32) (CARD16) width << 16 | (CARD16) height)) *
+        16777619U;
+    hash = (hash ^ ((CARD32) (CARD16) src_x << 16 | (CARD16) src_y)) *
+        16777619U;
+    hash = (hash ^ ((CARD32) (CARD16) src_w << 16 | (CARD16) src_h)) *
+        16777619U;
+
+    if (size < sizeof(word))
+        return hash;
+
+    for (i = 0; i < VIA_XV_HASH_SAMPLES; i++) {
+        memcpy(&word, buf + (CARD64) i * (size - sizeof(word)) /
+               (VIA_XV_HASH_SAMPLES - 1), sizeof(word));
+        hash = (hash ^ word) * 16777619U;
+    }
+    return hash;
+}
+
+/*
+ * Whether the image is the one last uploaded. Changes that miss every
+ * sample are caught by uploading every VIA_XV_MAX_REPEATS repeats anyway.
+ */
+static Bool
+viaXvFrameUnchanged(viaPortPrivPtr pPriv, const unsigned char *buf,
+        unsigned size, int id, short width, short height,
+        short src_x, short src_y, short src_w, short src_h)
+{
+    CARD32 hash = viaXvFrameHash(buf, size, id, width, height,
+                                 src_x, src_y, src_w, src_h);
+
+    if (pPriv->frameHashValid && pPriv->frameHash == hash &&
+        pPriv->frameRepeats < VIA_XV_MAX_REPEATS) {
+        pPriv->frameRepeats++;
+        return TRUE;
+    }
+
+    pPriv->frameHashValid = TRUE;
+    pPriv->frameHash = hash;
+    pPriv->frameRepeats = 0;
+    return FALSE;
 }
 
 #ifdef OPENCHROMEDRI
@@ -1057,6 +1305,7 @@ viaDmaBlitImage(VIAPtr pVia,
 
         case FOURCC_YV12:
         case FOURCC_I420:
+        case FOURCC_NV12:
         default:
             bounceStride = ALIGN_TO(width, 16);
             bounceLines = height;
@@ -1072,7 +1321,8 @@ viaDmaBlitImage(VIAPtr pVia,
                 pPort->dmaBounceBuffer = 0;
             }
             size = bounceStride * bounceLines + 16;
-            if (id == FOURCC_YV12 || id == FOURCC_I420)
+            if (id == FOURCC_YV12 || id == FOURCC_I420 ||
+                id == FOURCC_NV12)
                 size += ALIGN_TO(bounceStride >> 1, 16) * bounceLines;
             pPort->dmaBounceBuffer = (unsigned char *)malloc(size);
             pPort->dmaBounceLines = bounceLines;
@@ -1086,8 +1336,9 @@ viaDmaBlitImage(VIAPtr pVia,
     base = (bounceBuffer) ? bounceBase : src;
 
     if (bounceBuffer) {
-        (*viaFastVidCpy) (base, src, bounceStride, bounceStride >> 1, height,
-        1);
+        /* The NV12 chroma plane follows the luma at the same stride. */
+        (*viaFastVidCpy) (base, src, bounceStride, bounceStride >> 1,
+        (id == FOURCC_NV12) ? height + (height >> 1) : height, 1);
     }
 
     blit.num_lines = height;
@@ -1110,7 +1361,7 @@ viaDmaBlitImage(VIAPtr pVia,
     if (err < 0)
         return -1;
 
-    if (id == FOURCC_YV12 || id == FOURCC_I420) {
+    if (id == FOURCC_YV12 || id == FOURCC_I420 || id == FOURCC_NV12) {
         unsigned tmp = ALIGN_TO(width >> 1, 16);
 
         if (nv12Conversion) {
@@ -1118,15 +1369,16 @@ viaDmaBlitImage(VIAPtr pVia,
                 src + bounceStride * height + tmp * (height >> 1),
                 src + bounceStride * height, width >> 1, tmp,
                 bounceStride, height >> 1);
-        } else if (bounceBuffer) {
+        } else if (bounceBuffer && id != FOURCC_NV12) {
             (*viaFastVidCpy) (base + bounceStride * height,
                     src + bounceStride * height, tmp, tmp >> 1, height, 1);
         }
 
-        if (nv12Conversion) {
+        if (nv12Conversion || id == FOURCC_NV12) {
             blit.num_lines = height >> 1;
             blit.line_length = bounceStride;
-            blit.mem_addr = bounceBase + bounceStride * height;
+            blit.mem_addr = (nv12Conversion ? bounceBase : base) +
+                            bounceStride * height;
             blit.fb_stride = lumaStride;
             blit.mem_stride = bounceStride;
         } else {
@@ -1158,6 +1410,102 @@ viaDmaBlitImage(VIAPtr pVia,
 #endif
 
 
+/*
+ * Show the surface on screen in the given rectangles. Shared by PutImage
+ * and ReputImage, which redraws the last frame on exposes and moves.
+ */
+static void
+viaXvShowOverlay(ScrnInfoPtr pScrn, viaPortPrivPtr pPriv, xf86CrtcPtr crtc,
+        short src_x, short src_y,
+        short drw_x, short drw_y,
+        short src_w, short src_h,
+        short drw_w, short drw_h,
+        RegionPtr clipBoxes, DrawablePtr pDraw)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    DDUPDATEOVERLAY UpdateOverlay_Video;
+    LPDDUPDATEOVERLAY lpUpdateOverlay = &UpdateOverlay_Video;
+    unsigned long dwUseExtendedFIFO = 0;
+
+    /*
+     *  fill video overlay parameter
+     */
+    lpUpdateOverlay->SrcLeft = src_x;
+    lpUpdateOverlay->SrcTop = src_y;
+    lpUpdateOverlay->SrcRight = src_x + src_w;
+    lpUpdateOverlay->SrcBottom = src_y + src_h;
+
+    lpUpdateOverlay->DstLeft = drw_x;
+    lpUpdateOverlay->DstTop = drw_y;
+    lpUpdateOverlay->DstRight = drw_x + drw_w;
+    lpUpdateOverlay->DstBottom = drw_y + drw_h;
+
+    lpUpdateOverlay->dwFlags = DDOVER_KEYDEST;
+    if (pVia->swov.SWDevice.dwDeinterlaceMode != VIA_DEINTERLACE_WEAVE)
+        lpUpdateOverlay->dwFlags |= DDOVER_BOB;
+
+    if (pScrn->bitsPerPixel == 8) {
+        lpUpdateOverlay->dwColorSpaceLowValue = pPriv->colorKey & 0xff;
+    } else {
+        lpUpdateOverlay->dwColorSpaceLowValue = pPriv->colorKey;
+    }
+    /* If use extend FIFO mode */
+    if (pScrn->currentMode->HDisplay > 1024) {
+        dwUseExtendedFIFO = 1;
+    }
+
+    /* If the dest rec. & extendFIFO doesn't change, don't do UpdateOverlay
+     * unless the surface clipping has changed */
+    if ((pPriv->old_drw_x == drw_x) && (pPriv->old_drw_y == drw_y)
+            && (pPriv->old_drw_w == drw_w) && (pPriv->old_drw_h == drw_h)
+            && (pPriv->old_src_x == src_x) && (pPriv->old_src_y == src_y)
+            && (pPriv->old_src_w == src_w) && (pPriv->old_src_h == src_h)
+            && (pVia->old_dwUseExtendedFIFO == dwUseExtendedFIFO)
+            && (pVia->VideoStatus & VIDEO_SWOV_ON) &&
+            REGION_EQUAL(pScrn->pScreen, &pPriv->clip, clipBoxes)) {
+        DBG_DD(ErrorF(" via_xv.c : don't do UpdateOverlay! \n"));
+        viaXvError(pScrn, pPriv, xve_none);
+        return;
+    }
+
+    pPriv->old_src_x = src_x;
+    pPriv->old_src_y = src_y;
+    pPriv->old_src_w = src_w;
+    pPriv->old_src_h = src_h;
+
+    pPriv->old_drw_x = drw_x;
+    pPriv->old_drw_y = drw_y;
+    pPriv->old_drw_w = drw_w;
+    pPriv->old_drw_h = drw_h;
+    pVia->old_dwUseExtendedFIFO = dwUseExtendedFIFO;
+    pVia->VideoStatus |= VIDEO_SWOV_ON;
+
+    /*  BitBlt: Draw the colorkey rectangle */
+    if (!REGION_EQUAL(pScrn->pScreen, &pPriv->clip, clipBoxes)) {
+        REGION_COPY(pScrn->pScreen, &pPriv->clip, clipBoxes);
+        if (pPriv->autoPaint) {
+            if (pDraw->type == DRAWABLE_WINDOW) {
+                xf86XVFillKeyHelperDrawable(pDraw, pPriv->colorKey, clipBoxes);
+                DamageDamageRegion(pDraw, clipBoxes);
+            } else {
+                xf86XVFillKeyHelper(pScrn->pScreen, pPriv->colorKey, clipBoxes);
+            }
+        }
+    } else {
+        DBG_DD(ErrorF(" via_xv.c : // No need to draw Colorkey!! \n"));
+    }
+    /*
+     *  Update video overlay
+     */
+    if (!VIAVidUpdateOverlay(crtc, lpUpdateOverlay)) {
+        DBG_DD(ErrorF
+                (" via_xv.c : call v4l updateoverlay fail. \n"));
+    } else {
+        DBG_DD(ErrorF(" via_xv.c : PutImage done OK\n"));
+    }
+    viaXvError(pScrn, pPriv, xve_none);
+}
+
 /*
  * The source rectangle of the video is defined by (src_x, src_y, src_w, src_h).
  * The dest rectangle of the video is defined by (drw_x, drw_y, drw_w, drw_h).
@@ -1209,11 +1557,9 @@ viaPutImage(ScrnInfoPtr pScrn,
     switch (pPriv->xv_adaptor) {
         case XV_ADAPT_SWOV:
         {
-            DDUPDATEOVERLAY UpdateOverlay_Video;
-            LPDDUPDATEOVERLAY lpUpdateOverlay = &UpdateOverlay_Video;
-
-            int dstPitch;
-            unsigned long dwUseExtendedFIFO = 0;
+            Bool upload = FALSE;
+            unsigned size = 0;
+            unsigned long bytes = 0;
 
             DBG_DD(ErrorF(" via_xv.c :              : S/W Overlay! \n"));
             /*  Allocate video memory(CreateSurface),
@@ -1231,60 +1577,33 @@ viaPutImage(ScrnInfoPtr pScrn,
                 return retCode;
             }
 
-            /*  Copy image data from system memory to video memory
-             *  TODO: use DRM's DMA feature to accelerate data copy
+            /*  Copy image data from system memory to video memory,
+             *  unless the client resubmitted the frame on screen.
              */
             if (id != FOURCC_XVMC) {
-                dstPitch = pVia->swov.SWDevice.dwPitch;
+                unsigned short w = width, h = height;
+
+                size = viaQueryImageAttributes(pScrn, id, &w, &h, NULL, NULL);
+                upload = !viaXvFrameUnchanged(pPriv, buf, size, id,
+                                              width, height,
+                                              src_x, src_y, src_w, src_h);
+            }
 
+            if (upload) {
                 if (pVia->useDmaBlit) {
 #ifdef OPENCHROMEDRI
                     if (viaDmaBlitImage(pVia, pPriv, buf,
                         (CARD32) pVia->swov.SWDevice.dwSWPhysicalAddr[pVia->dwFrameNum & 1],
-                        width, height, dstPitch, id)) {
+                        width, height, pVia->swov.SWDevice.dwPitch, id)) {
+                            pPriv->frameHashValid = FALSE;
                             viaXvError(pScrn, pPriv, xve_dmablit);
                         return BadAccess;
                     }
 #endif
+                    bytes = size;
                 } else {
-                    switch (id) {
-                        case FOURCC_I420:
-                            if (pVia->VideoEngine == VIDEO_ENGINE_CME) {
-                                nv12cp(pVia->swov.SWDevice.
-                                    lpSWOverlaySurface[pVia->dwFrameNum & 1],
-                                    buf, dstPitch, width, height, 1);
-                            } else {
-                                (*viaFastVidCpy)(pVia->swov.SWDevice.
-                                    lpSWOverlaySurface[pVia->dwFrameNum & 1],
-                                    buf, dstPitch, width, height, 0);
-                            }
-                            break;
-                        case FOURCC_YV12:
-                            if (pVia->VideoEngine == VIDEO_ENGINE_CME) {
-                                nv12cp(pVia->swov.SWDevice.
-                                    lpSWOverlaySurface[pVia->dwFrameNum & 1],
-                                    buf, dstPitch, width, height, 0);
-                            } else {
-                                (*viaFastVidCpy)(pVia->swov.SWDevice.
-                                    lpSWOverlaySurface[pVia->dwFrameNum & 1],
-                                    buf, dstPitch, width, height, 0);
-                            }
-                            break;
-                        case FOURCC_RV32:
-                            (*viaFastVidCpy) (pVia->swov.SWDevice.
-                                lpSWOverlaySurface[pVia->dwFrameNum & 1],
-                                buf, dstPitch, width << 1, height, 1);
-                            break;
-                        case FOURCC_UYVY:
-                        case FOURCC_YUY2:
-                        case FOURCC_RV15:
-                        case FOURCC_RV16:
-                        default:
-                            (*viaFastVidCpy) (pVia->swov.SWDevice.
-                                lpSWOverlaySurface[pVia->dwFrameNum & 1],
-                                buf, dstPitch, width, height, 1);
-                            break;
-                    }
+                    bytes = viaXvCopyImage(pVia, id, buf, size,
+                                           width, height, src_y, src_h);
                 }
             }
 
@@ -1293,99 +1612,44 @@ viaPutImage(ScrnInfoPtr pScrn,
                 DBG_DD(ErrorF
                         (" via_xv.c : Xv Overlay rejected due to insufficient "
                                 "memory bandwidth.\n"));
+                /* The frame was not flipped to; upload it again. */
+                pPriv->frameHashValid = FALSE;
                 viaXvError(pScrn, pPriv, xve_bandwidth);
                 return BadAlloc;
             }
 
-            /*
-             *  fill video overlay parameter
-             */
-            lpUpdateOverlay->SrcLeft = src_x;
-            lpUpdateOverlay->SrcTop = src_y;
-            lpUpdateOverlay->SrcRight = src_x + src_w;
-            lpUpdateOverlay->SrcBottom = src_y + src_h;
-
-            lpUpdateOverlay->DstLeft = drw_x;
-            lpUpdateOverlay->DstTop = drw_y;
-            lpUpdateOverlay->DstRight = drw_x + drw_w;
-            lpUpdateOverlay->DstBottom = drw_y + drw_h;
-
-            lpUpdateOverlay->dwFlags = DDOVER_KEYDEST;
-
-            if (pScrn->bitsPerPixel == 8) {
-                lpUpdateOverlay->dwColorSpaceLowValue = pPriv->colorKey & 0xff;
+            /* XvMC sets up its own field flips. */
+            if (id != FOURCC_XVMC) {
+                pVia->swov.SWDevice.dwDeinterlaceMode = pPriv->deinterlace;
+                pVia->swov.SWDevice.dwDeblock = pPriv->deblock;
             } else {
-                lpUpdateOverlay->dwColorSpaceLowValue = pPriv->colorKey;
-            }
-            /* If use extend FIFO mode */
-            if (pScrn->currentMode->HDisplay > 1024) {
-                dwUseExtendedFIFO = 1;
+                pVia->swov.SWDevice.dwDeinterlaceMode = VIA_DEINTERLACE_WEAVE;
+                pVia->swov.SWDevice.dwDeblock = FALSE;
             }
 
-            if (FOURCC_XVMC != id) {
-
-                /*
-                 * XvMC flipping is done in the client lib.
-                 */
-
+            if (upload) {
                 DBG_DD(ErrorF("             : Flip\n"));
                 Flip(pVia, pPriv, id, pVia->dwFrameNum & 1);
+                if (pVia->swov.SWDevice.dwDeinterlaceMode !=
+                    VIA_DEINTERLACE_WEAVE)
+                    viaScheduleFieldFlip(pScrn);
+                VIA_COUNT(pVia, VIA_COUNTER_XV_BYTES, bytes);
+            } else if (id != FOURCC_XVMC) {
+                /* The surface on screen already holds this frame. */
+                VIA_COUNT(pVia, VIA_COUNTER_XV_UNCHANGED, 1);
             }
 
-            pVia->dwFrameNum++;
-
-            /* If the dest rec. & extendFIFO doesn't change, don't do UpdateOverlay
-             * unless the surface clipping has changed */
-            if ((pPriv->old_drw_x == drw_x) && (pPriv->old_drw_y == drw_y)
-                    && (pPriv->old_drw_w == drw_w) && (pPriv->old_drw_h == drw_h)
-                    && (pPriv->old_src_x == src_x) && (pPriv->old_src_y == src_y)
-                    && (pPriv->old_src_w == src_w) && (pPriv->old_src_h == src_h)
-                    && (pVia->old_dwUseExtendedFIFO == dwUseExtendedFIFO)
-                    && (pVia->VideoStatus & VIDEO_SWOV_ON) &&
-                    REGION_EQUAL(pScrn->pScreen, &pPriv->clip, clipBoxes)) {
-                DBG_DD(ErrorF(" via_xv.c : don't do UpdateOverlay! \n"));
-                viaXvError(pScrn, pPriv, xve_none);
-                return Success;
-            }
-
-            pPriv->old_src_x = src_x;
-            pPriv->old_src_y = src_y;
-            pPriv->old_src_w = src_w;
-            pPriv->old_src_h = src_h;
-
-            pPriv->old_drw_x = drw_x;
-            pPriv->old_drw_y = drw_y;
-            pPriv->old_drw_w = drw_w;
-            pPriv->old_drw_h = drw_h;
-            pVia->old_dwUseExtendedFIFO = dwUseExtendedFIFO;
-            pVia->VideoStatus |= VIDEO_SWOV_ON;
-
-            /*  BitBlt: Draw the colorkey rectangle */
-            if (!REGION_EQUAL(pScrn->pScreen, &pPriv->clip, clipBoxes)) {
-                REGION_COPY(pScrn->pScreen, &pPriv->clip, clipBoxes);
-                if (pPriv->autoPaint) {
-                    if (pDraw->type == DRAWABLE_WINDOW) {
-                        xf86XVFillKeyHelperDrawable(pDraw, pPriv->colorKey, clipBoxes);
-                        DamageDamageRegion(pDraw, clipBoxes);
-                    } else {
-                        xf86XVFillKeyHelper(pScrn->pScreen, pPriv->colorKey, clipBoxes);
-                    }
-                }
-            } else {
-                DBG_DD(ErrorF(" via_xv.c : // No need to draw Colorkey!! \n"));
-            }
             /*
-             *  Update video overlay
+             * XvMC flipping is done in the client lib. A skipped frame
+             * leaves the back surface free for the next one.
              */
-            if (!VIAVidUpdateOverlay(crtc, lpUpdateOverlay)) {
-                DBG_DD(ErrorF
-                        (" via_xv.c : call v4l updateoverlay fail. \n"));
-            } else {
-                DBG_DD(ErrorF(" via_xv.c : PutImage done OK\n"));
-                viaXvError(pScrn, pPriv, xve_none);
-                return Success;
-            }
-            break;
+            if (upload || id == FOURCC_XVMC)
+                pVia->dwFrameNum++;
+            VIA_COUNT(pVia, VIA_COUNTER_XV_FRAMES, 1);
+
+            viaXvShowOverlay(pScrn, pPriv, crtc, src_x, src_y, drw_x, drw_y,
+                             src_w, src_h, drw_w, drw_h, clipBoxes, pDraw);
+            return Success;
         }
         default:
             DBG_DD(ErrorF(" via_xv.c : XVPort not supported\n"));
@@ -1397,6 +1661,47 @@ viaPutImage(ScrnInfoPtr pScrn,
     return Success;
 }
 
+/*
+ * Show the last frame again after an expose or a move, from the surface.
+ */
+static int
+viaReputImage(ScrnInfoPtr pScrn,
+        short src_x, short src_y,
+        short drw_x, short drw_y,
+        short src_w, short src_h,
+        short drw_w, short drw_h,
+        RegionPtr clipBoxes, pointer data, DrawablePtr pDraw)
+{
+    VIAPtr pVia = VIAPTR(pScrn);
+    viaPortPrivPtr pPriv = (viaPortPrivPtr) data;
+    xf86CrtcPtr crtc;
+
+    DBG_DD(ErrorF(" via_xv.c : viaReputImage : called\n"));
+
+    /* Only the rows of the last source rectangle were uploaded. */
+    if (pPriv->xv_adaptor != XV_ADAPT_SWOV
+        || !(pVia->VideoStatus & VIDEO_SWOV_SURFACE_CREATED)
+        || pPriv->old_src_x != src_x || pPriv->old_src_y != src_y
+        || pPriv->old_src_w != src_w || pPriv->old_src_h != src_h)
+        return BadMatch;
+
+    crtc = window_belongs_to_crtc(pScrn, drw_x, drw_y, drw_w, drw_h);
+    if (!crtc) {
+        DBG_DD(ErrorF(" via_xv.c : No usable CRTC\n"));
+        viaXvError(pScrn, pPriv, xve_adaptor);
+        return BadAlloc;
+    }
+
+    if (!(DecideOverlaySupport(crtc))) {
+        viaXvError(pScrn, pPriv, xve_bandwidth);
+        return BadAlloc;
+    }
+
+    viaXvShowOverlay(pScrn, pPriv, crtc, src_x, src_y, drw_x, drw_y,
+                     src_w, src_h, drw_w, drw_h, clipBoxes, pDraw);
+    return Success;
+}
+
 static int
 viaQueryImageAttributes(ScrnInfoPtr pScrn,
         int id, unsigned short *w, unsigned short *h, int *pitches,
@@ -1444,6 +1749,18 @@ viaQueryImageAttributes(ScrnInfoPtr pScrn,
                 offsets[2] = size;
             size += tmp;
             break;
+        case FOURCC_NV12: /*Planar format : NV12 -4:2:0, interleaved UV */
+            *h = (*h + 1) & ~1;
+            size = *w;
+            if (pVia->useDmaBlit)
+                size = (size + 15) & ~15;
+            if (pitches)
+                pitches[0] = pitches[1] = size;
+            size *= *h;
+            if (offsets)
+                offsets[1] = size;
+            size += size >> 1;
+            break;
         case FOURCC_XVMC:
             *h = (*h + 1) & ~1;
 #ifdef OPENCHROMEDRI
@@ -247,6 +247,7 @@ VIAVidHWDiffInit(ScrnInfoPtr pScrn)
                 HWDiff->dwNeedV1Prefetch = VID_HWDIFF_FALSE;
             }
             HWDiff->dwNewScaleCtl = VID_HWDIFF_FALSE;
+            HWDiff->dwHQVPostFilter = VID_HWDIFF_FALSE;
             break;
         case VIA_KM400:
             HWDiff->dwThreeHQVBuffer = VID_HWDIFF_TRUE;
@@ -256,6 +257,7 @@ VIAVidHWDiffInit(ScrnInfoPtr pScrn)
             HWDiff->dwHQVDisablePatch = VID_HWDIFF_TRUE;
             HWDiff->dwNeedV1Prefetch = VID_HWDIFF_FALSE;
             HWDiff->dwNewScaleCtl = VID_HWDIFF_FALSE;
+            HWDiff->dwHQVPostFilter = VID_HWDIFF_FALSE;
             break;
         case VIA_K8M800:
             HWDiff->dwThreeHQVBuffer = VID_HWDIFF_TRUE;
@@ -265,6 +267,7 @@ VIAVidHWDiffInit(ScrnInfoPtr pScrn)
             HWDiff->dwHQVDisablePatch = VID_HWDIFF_TRUE;
             HWDiff->dwNeedV1Prefetch = VID_HWDIFF_FALSE;
             HWDiff->dwNewScaleCtl = VID_HWDIFF_FALSE;
+            HWDiff->dwHQVPostFilter = VID_HWDIFF_FALSE;
             break;
         case VIA_PM800:
             HWDiff->dwThreeHQVBuffer = VID_HWDIFF_TRUE;
@@ -274,6 +277,7 @@ VIAVidHWDiffInit(ScrnInfoPtr pScrn)
             HWDiff->dwHQVDisablePatch = VID_HWDIFF_FALSE;
             HWDiff->dwNeedV1Prefetch = VID_HWDIFF_FALSE;
             HWDiff->dwNewScaleCtl = VID_HWDIFF_FALSE;
+            HWDiff->dwHQVPostFilter = VID_HWDIFF_TRUE;
             HWDiff->HQVCmeRegs = hqv_cme_regs;
             break;
         case VIA_P4M800PRO:
@@ -285,6 +289,10 @@ VIAVidHWDiffInit(ScrnInfoPtr pScrn)
             HWDiff->dwHQVDisablePatch = VID_HWDIFF_TRUE;
             HWDiff->dwNeedV1Prefetch = VID_HWDIFF_FALSE;
             HWDiff->dwNewScaleCtl = VID_HWDIFF_FALSE;
+            /* The P4M800 Pro uses the CLE engine and planar YV12. */
+            HWDiff->dwHQVPostFilter =
+                (pVia->VideoEngine == VIDEO_ENGINE_CME) ?
+                VID_HWDIFF_TRUE : VID_HWDIFF_FALSE;
             HWDiff->HQVCmeRegs = hqv_cme_regs;
             break;
         case VIA_K8M890:
@@ -295,6 +303,7 @@ VIAVidHWDiffInit(ScrnInfoPtr pScrn)
             HWDiff->dwHQVDisablePatch = VID_HWDIFF_TRUE;
             HWDiff->dwNeedV1Prefetch = VID_HWDIFF_TRUE;
             HWDiff->dwNewScaleCtl = VID_HWDIFF_FALSE;
+            HWDiff->dwHQVPostFilter = VID_HWDIFF_TRUE;
             HWDiff->HQVCmeRegs = hqv_cme_regs;
             break;
         case VIA_P4M890:
@@ -305,6 +314,7 @@ VIAVidHWDiffInit(ScrnInfoPtr pScrn)
             HWDiff->dwHQVDisablePatch = VID_HWDIFF_TRUE;
             HWDiff->dwNeedV1Prefetch = VID_HWDIFF_FALSE;
             HWDiff->dwNewScaleCtl = VID_HWDIFF_FALSE;
+            HWDiff->dwHQVPostFilter = VID_HWDIFF_TRUE;
             HWDiff->HQVCmeRegs = hqv_cme_regs;
             break;
         case VIA_CX700:
@@ -315,6 +325,7 @@ VIAVidHWDiffInit(ScrnInfoPtr pScrn)
             HWDiff->dwHQVDisablePatch = VID_HWDIFF_FALSE;
             HWDiff->dwNeedV1Prefetch = VID_HWDIFF_FALSE;
             HWDiff->dwNewScaleCtl = VID_HWDIFF_FALSE;
+            HWDiff->dwHQVPostFilter = VID_HWDIFF_TRUE;
             HWDiff->HQVCmeRegs = hqv_cme_regs;
             break;
         case VIA_VX800:
@@ -325,6 +336,7 @@ VIAVidHWDiffInit(ScrnInfoPtr pScrn)
             HWDiff->dwHQVDisablePatch = VID_HWDIFF_FALSE;
             HWDiff->dwNeedV1Prefetch = VID_HWDIFF_FALSE;
             HWDiff->dwNewScaleCtl = VID_HWDIFF_TRUE;
+            HWDiff->dwHQVPostFilter = VID_HWDIFF_FALSE;
             HWDiff->HQVCmeRegs = hqv_cme_regs;
             break;
         case VIA_VX855:
@@ -336,6 +348,7 @@ VIAVidHWDiffInit(ScrnInfoPtr pScrn)
             HWDiff->dwHQVDisablePatch = VID_HWDIFF_FALSE;
             HWDiff->dwNeedV1Prefetch = VID_HWDIFF_FALSE;
             HWDiff->dwNewScaleCtl = VID_HWDIFF_TRUE;
+            HWDiff->dwHQVPostFilter = VID_HWDIFF_FALSE;
             HWDiff->HQVCmeRegs = hqv_cme_regs_409;
             break;
         default:
@@ -387,6 +400,7 @@ viaOverlayGetV1V3Format(VIAPtr pVia, int vport, /* 1 or 3, as in V1 or V3 */
         switch (pVia->swov.SrcFourCC) {
             case FOURCC_YV12:
             case FOURCC_I420:
+            case FOURCC_NV12:
             case FOURCC_XVMC:
                 *pHQVCtl |= HQV_YUV420;
                 break;
@@ -500,6 +514,7 @@ viaOverlayGetSrcStartAddress(VIAPtr pVia,
 
             case FOURCC_YV12:
             case FOURCC_I420:
+            case FOURCC_NV12:
             case FOURCC_XVMC:
 
                 if (videoFlag & VIDEO_HQV_INUSE)
@@ -758,6 +773,7 @@ viaOverlayGetFetch(VIAPtr pVia, unsigned long videoFlag,
     switch (pVia->swov.SrcFourCC) {
         case FOURCC_YV12:
         case FOURCC_I420:
+        case FOURCC_NV12:
         case FOURCC_XVMC:
             n = 0; /* 2^n = 1 byte per pixel (Y channel in planar YUV) */
             break;
@@ -1141,7 +1157,7 @@ AddHQVSurface(ScrnInfoPtr pScrn, unsigned int numbuf, CARD32 fourcc)
         proReg = PRO_HQV1_OFFSET;
 
     isplanar = ((fourcc == FOURCC_YV12) || (fourcc == FOURCC_I420) ||
-                (fourcc == FOURCC_XVMC));
+                (fourcc == FOURCC_NV12) || (fourcc == FOURCC_XVMC));
 
     height = pVia->swov.SWDevice.gdwSWSrcHeight;
     pitch = pVia->swov.SWDevice.dwPitch;
@@ -1183,6 +1199,7 @@ CreateSurface(ScrnInfoPtr pScrn, CARD32 FourCC, CARD16 Width,
     switch (FourCC) {
         case FOURCC_YV12:
         case FOURCC_I420:
+        case FOURCC_NV12:
         case FOURCC_XVMC:
             isplanar = TRUE;
             pitch = ALIGN_TO(Width, 32);
@@ -1276,6 +1293,7 @@ ViaSwovSurfaceCreate(ScrnInfoPtr pScrn, viaPortPrivPtr pPriv,
 
         case FOURCC_YV12:
         case FOURCC_I420:
+        case FOURCC_NV12:
             retCode = CreateSurface(pScrn, FourCC, Width, Height, TRUE);
             if (retCode == Success)
                 retCode = AddHQVSurface(pScrn, numbuf, FourCC);
@@ -1337,6 +1355,7 @@ ViaSwovSurfaceDestroy(ScrnInfoPtr pScrn, viaPortPrivPtr pPriv)
 
             case FOURCC_YV12:
             case FOURCC_I420:
+            case FOURCC_NV12:
                 drm_bo_free(pScrn, pVia->swov.SWfbMem);
             case FOURCC_XVMC:
                 pVia->swov.SrcFourCC = 0;
@@ -1505,6 +1524,7 @@ SetupFIFOs(VIAPtr pVia, unsigned long videoFlag,
     if (miniCtl & V1_Y_INTERPOLY) {
         if (pVia->swov.SrcFourCC == FOURCC_YV12
             || pVia->swov.SrcFourCC == FOURCC_I420
+            || pVia->swov.SrcFourCC == FOURCC_NV12
             || pVia->swov.SrcFourCC == FOURCC_XVMC) {
             if (videoFlag & VIDEO_HQV_INUSE) {
                 if (videoFlag & VIDEO_1_INUSE)
@@ -1539,6 +1559,7 @@ SetupFIFOs(VIAPtr pVia, unsigned long videoFlag,
     } else {
         if (pVia->swov.SrcFourCC == FOURCC_YV12
             || pVia->swov.SrcFourCC == FOURCC_I420
+            || pVia->swov.SrcFourCC == FOURCC_NV12
             || pVia->swov.SrcFourCC == FOURCC_XVMC) {
             if (videoFlag & VIDEO_HQV_INUSE) {
                 if (videoFlag & VIDEO_1_INUSE)
@@ -1777,6 +1798,32 @@ SetVideoWindow(ScrnInfoPtr pScrn, unsigned long videoFlag,
     }
 }
 
+/*
+ * The HQV post filters work on the NV12 planes of the CME engines, where
+ * the YV12 and I420 sources are converted to NV12 on upload.
+ */
+static Bool
+viaOverlayPostFilter(VIAPtr pVia)
+{
+    return pVia->HWDiff.dwHQVPostFilter &&
+        (pVia->swov.SrcFourCC == FOURCC_YV12 ||
+         pVia->swov.SrcFourCC == FOURCC_I420 ||
+         pVia->swov.SrcFourCC == FOURCC_NV12);
+}
+
+/*
+ * Deblocking thresholds held in the top bits of the HQV start addresses.
+ * Flip() ORs them into every new address.
+ */
+CARD32
+viaOverlayDeblockParam(VIAPtr pVia, Bool chroma)
+{
+    if (!pVia->swov.SWDevice.dwDeblock || !viaOverlayPostFilter(pVia))
+        return 0;
+
+    return chroma ? HQV_DEBLOCK_UV_PARAM : HQV_DEBLOCK_Y_PARAM;
+}
+
 /*
  * Upd_Video()
  */
@@ -1806,10 +1853,15 @@ Upd_Video(xf86CrtcPtr crtc, unsigned long videoFlag,
     unsigned long hqvSrcFetch = 0, hqvOffset = 0;
     unsigned long dwOffset = 0, fetch = 0, tmp = 0;
     unsigned long proReg = 0;
+    unsigned long dwDeinterlace = pVia->swov.SWDevice.dwDeinterlaceMode;
+    Bool postFilter = viaOverlayPostFilter(pVia);
     int i;
 
     DBG_DD(ErrorF("videoflag=%ld\n", videoFlag));
 
+    if (!postFilter && dwDeinterlace == VIA_DEINTERLACE_ADAPTIVE)
+        dwDeinterlace = VIA_DEINTERLACE_BOB;
+
     if (pVia->ChipId == PCI_CHIP_VT3259 && !(videoFlag & VIDEO_1_INUSE))
         proReg = PRO_HQV1_OFFSET;
 
@@ -1878,6 +1930,7 @@ Upd_Video(xf86CrtcPtr crtc, unsigned long videoFlag,
 
     if (pVia->swov.SrcFourCC == FOURCC_YV12
         || pVia->swov.SrcFourCC == FOURCC_I420
+        || pVia->swov.SrcFourCC == FOURCC_NV12
         || pVia->swov.SrcFourCC == FOURCC_XVMC) {
 
         YCBCRREC YCbCr;
@@ -1895,9 +1948,23 @@ Upd_Video(xf86CrtcPtr crtc, unsigned long videoFlag,
                                 srcPitch, oriSrcHeight);
                 if (pVia->VideoEngine == VIDEO_ENGINE_CME) {
                     SaveVideoRegister(pVia, HQV_SRC_STARTADDR_Y + proReg,
-                                      YCbCr.dwY);
+                                      YCbCr.dwY |
+                                      viaOverlayDeblockParam(pVia, FALSE));
                     SaveVideoRegister(pVia, HQV_SRC_STARTADDR_U + proReg,
-                                      YCbCr.dwCB);
+                                      YCbCr.dwCB |
+                                      viaOverlayDeblockParam(pVia, TRUE));
+                    if (postFilter) {
+                        tmp = 0;
+                        if (pVia->swov.SWDevice.dwDeblock)
+                            tmp |= HQV_DEBLOCK_ENABLE | HQV_DEBLOCK_LOWPASS |
+                                   HQV_DEBLOCK_LEVEL_DEFAULT;
+                        /* Motion buffer size, as the XvMC code has it. */
+                        if (dwDeinterlace == VIA_DEINTERLACE_ADAPTIVE)
+                            tmp |= (srcPitch * oriSrcHeight * 3 / 2) &
+                                   HQV_MOTION_BUFFER_MASK;
+                        SaveVideoRegister(pVia, HQV_SRC_STARTADDR_V + proReg,
+                                          tmp);
+                    }
                 } else {
                     SaveVideoRegister(pVia, HQV_SRC_STARTADDR_Y, YCbCr.dwY);
                     SaveVideoRegister(pVia, HQV_SRC_STARTADDR_U, YCbCr.dwCR);
@@ -1971,6 +2038,7 @@ Upd_Video(xf86CrtcPtr crtc, unsigned long videoFlag,
 
         if (pVia->swov.SrcFourCC == FOURCC_YV12
             || pVia->swov.SrcFourCC == FOURCC_I420
+            || pVia->swov.SrcFourCC == FOURCC_NV12
             || pVia->swov.SrcFourCC == FOURCC_XVMC) {
             if (videoFlag & VIDEO_1_INUSE)
                 SaveVideoRegister(pVia, V1_STRIDE, srcPitch << 1);
@@ -2035,8 +2103,15 @@ Upd_Video(xf86CrtcPtr crtc, unsigned long videoFlag,
                 vidCtl |= V1_BOB_ENABLE | V1_FRAME_BASE;
             else
                 vidCtl |= V3_BOB_ENABLE | V3_FRAME_BASE;
-        } else
+        } else {
             hqvCtl |= HQV_FIELD_2_FRAME | HQV_FRAME_2_FIELD | HQV_DEINTERLACE;
+            if (pVia->swov.SrcFourCC == FOURCC_YV12 ||
+                pVia->swov.SrcFourCC == FOURCC_I420 ||
+                pVia->swov.SrcFourCC == FOURCC_NV12)
+                hqvCtl |= HQV_FIELD_UV;
+            if (dwDeinterlace == VIA_DEINTERLACE_ADAPTIVE)
+                hqvCtl |= HQV_MOTION_ADAPTIVE;
+        }
     } else if (deinterlaceMode & DDOVER_BOB) {
         if (videoFlag & VIDEO_HQV_INUSE) {
             srcHeight <<= 1;
@@ -2103,6 +2178,8 @@ Upd_Video(xf86CrtcPtr crtc, unsigned long videoFlag,
 	} else {
 		SaveVideoRegister(pVia, HQV_MINIFY_CONTROL + proReg, hqvMiniCtl);
 	}
+	if (postFilter && dwDeinterlace == VIA_DEINTERLACE_ADAPTIVE)
+		hqvFilterCtl = HQV_DEINTERLACE_FILTER | HQV_DEINTERLACE_MOTION;
 	SaveVideoRegister(pVia, HQV_FILTER_CONTROL + proReg, hqvFilterCtl);
     } else
         SetMiniAndZoom(pVia, videoFlag, miniCtl, zoomCtl);
@@ -2294,6 +2371,7 @@ VIAVidUpdateOverlay(xf86CrtcPtr crtc, LPDDUPDATEOVERLAY pUpdate)
         (pVia->swov.SrcFourCC == FOURCC_RV32) ||
         (pVia->swov.SrcFourCC == FOURCC_YV12) ||
         (pVia->swov.SrcFourCC == FOURCC_I420) ||
+        (pVia->swov.SrcFourCC == FOURCC_NV12) ||
         (pVia->swov.SrcFourCC == FOURCC_XVMC)) {
         videoFlag = pVia->swov.gdwVideoFlagSW;
     }
@@ -2311,6 +2389,8 @@ VIAVidUpdateOverlay(xf86CrtcPtr crtc, LPDDUPDATEOVERLAY pUpdate)
 
     /* For SW decode HW overlay use */
     startAddr = VIAGETREG(HQV_SRC_STARTADDR_Y + proReg);
+    if (pVia->HWDiff.dwHQVPostFilter)
+        startAddr &= HQV_SRC_ADDR_MASK;
 
     if (flags & DDOVER_KEYDEST) {
         haveColorKey = 1;
@@ -2369,6 +2449,7 @@ VIAVidUpdateOverlay(xf86CrtcPtr crtc, LPDDUPDATEOVERLAY pUpdate)
         (pVia->swov.SrcFourCC == FOURCC_RV32) ||
         (pVia->swov.SrcFourCC == FOURCC_YV12) ||
         (pVia->swov.SrcFourCC == FOURCC_I420) ||
+        (pVia->swov.SrcFourCC == FOURCC_NV12) ||
         (pVia->swov.SrcFourCC == FOURCC_XVMC)) {
         pVia->swov.SWDevice.gdwSWDstLeft = pUpdate->DstLeft + panDX;
         pVia->swov.SWDevice.gdwSWDstTop = pUpdate->DstTop + panDY;
@@ -2429,6 +2510,7 @@ ViaOverlayHide(ScrnInfoPtr pScrn)
         (pVia->swov.SrcFourCC == FOURCC_RV32) ||
         (pVia->swov.SrcFourCC == FOURCC_YV12) ||
         (pVia->swov.SrcFourCC == FOURCC_I420) ||
+        (pVia->swov.SrcFourCC == FOURCC_NV12) ||
         (pVia->swov.SrcFourCC == FOURCC_XVMC))
         videoFlag = pVia->swov.gdwVideoFlagSW;
 
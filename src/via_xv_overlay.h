@@ -73,6 +73,7 @@ typedef struct __VIAHWDiff
     unsigned long dwSupportTwoColorKey;	/* Support two color key */
     /* unsigned long dwCxColorSpace; *//* CLE_Cx ColorSpace */
     unsigned dwNewScaleCtl; /* Use new HQV scale engine code */
+    unsigned dwHQVPostFilter; /* HQV deblocking and motion adaptive deinterlacing on NV12 */
     const unsigned *HQVCmeRegs; /* Which set of CME regs to use for newer chipsets */
 } VIAHWDiff;
 
@@ -82,5 +83,6 @@ int ViaSwovSurfaceCreate(ScrnInfoPtr pScrn, viaPortPrivPtr pPriv,
 void ViaSwovSurfaceDestroy(ScrnInfoPtr pScrn, viaPortPrivPtr pPriv);
 Bool VIAVidUpdateOverlay(xf86CrtcPtr crtc, LPDDUPDATEOVERLAY pUpdate);
 void ViaOverlayHide(ScrnInfoPtr pScrn);
+CARD32 viaOverlayDeblockParam(VIAPtr pVia, Bool chroma);
 
 #endif /* _VIA_SWOV_H_ */
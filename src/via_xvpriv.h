@@ -43,12 +43,20 @@
 #define FOURCC_RV15     (('5' << 24) + ('1' << 16) + ('V' << 8) + 'R')
 #define FOURCC_RV16     (('6' << 24) + ('1' << 16) + ('V' << 8) + 'R')
 #define FOURCC_RV32     (('2' << 24) + ('3' << 16) + ('V' << 8) + 'R')
+#ifndef FOURCC_NV12
+#define FOURCC_NV12     (('2' << 24) + ('1' << 16) + ('V' << 8) + 'N')
+#endif
 
 /* Definition for dwFlags */
 #define DDOVER_KEYDEST     1
 #define DDOVER_INTERLEAVED 2
 #define DDOVER_BOB         4
 
+/* XV_DEINTERLACE values, see SWDevice.dwDeinterlaceMode */
+#define VIA_DEINTERLACE_WEAVE       0
+#define VIA_DEINTERLACE_BOB         1
+#define VIA_DEINTERLACE_ADAPTIVE    2
+
 #define FOURCC_HQVSW   0x34565148  /*HQV4*/
 
 #define MEM_BLOCKS      4
@@ -83,6 +91,8 @@ typedef struct
     RegionRec clip;
     CARD32 colorKey;
     Bool autoPaint;
+    int deinterlace;
+    Bool deblock;
 
     CARD32 FourCC;		       /* from old SurfaceDesc -- passed down from viaPutImageG */
 
@@ -106,6 +116,13 @@ typedef struct
     unsigned char *dmaBounceBuffer;
     unsigned dmaBounceStride;
     unsigned dmaBounceLines;
+
+    /*
+     * Sampled hash of the last uploaded image, to skip resubmitted ones.
+     */
+    Bool frameHashValid;
+    CARD32 frameHash;
+    unsigned frameRepeats;
     XvError xvErr;
 
 } viaPortPrivRec, *viaPortPrivPtr;
@@ -131,6 +148,7 @@ typedef struct _SWDEVICE
  unsigned long  gdwSWDstLeft;            /*SW Position : Left*/
  unsigned long  gdwSWDstTop;             /*SW Position : Top*/
  unsigned long  dwDeinterlaceMode;        /*BOB / WEAVE*/
+ unsigned long  dwDeblock;                /*HQV deblocking filter*/
 }SWDEVICE;
 typedef SWDEVICE * LPSWDEVICE;
 
@@ -225,6 +243,10 @@ typedef struct  {
     unsigned long maxWInterp;
     unsigned long maxHInterp;
 
+/* Second field flip for deinterlacing */
+    OsTimerPtr fieldTimer;
+    CARD32 lastFlipTime;
+
 } swovRec, *swovPtr;
 
 extern unsigned viaNumXvPorts;
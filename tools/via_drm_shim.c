@@ -0,0 +1,876 @@
+/*
+ * Copyright 2026 The OpenChrome Project
+ *                [https://www.freedesktop.org/wiki/Openchrome]
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Userspace stand-in for the VIA DRM device.
+ *
+ * This is an LD_PRELOAD library that intercepts open(), ioctl(), mmap()
+ * and munmap() on one device node and emulates the subset of the VIA and
+ * OpenChrome DRM interface that the DDX and the XvMC library use:
+ *
+ *   DRM_VIA_ALLOCMEM / DRM_VIA_FREEMEM
+ *   DRM_VIA_CMDBUFFER / DRM_VIA_PCICMD / DRM_VIA_FLUSH / DRM_VIA_CMDBUF_SIZE
+ *   DRM_VIA_DMA_BLIT / DRM_VIA_BLIT_SYNC
+ *   DRM_VIA_GEM_ALLOC / DRM_VIA_GEM_MMAP / DRM_IOCTL_GEM_CLOSE
+ *
+ * Video memory is plain host memory. Command buffers are accounted,
+ * and the 2D solid fills in them are executed; everything else in them
+ * is skipped. Fills are what the DDX uses to write its sync markers, so
+ * marker waits complete as they would on the hardware. DMA blits really
+ * copy data so that callers can verify their results. Every submission is placed on a simulated engine
+ * timeline with a fixed per-submission latency and a transfer
+ * bandwidth, and the sync ioctls sleep until the simulated engine has
+ * caught up. This keeps the pipelining behaviour of the real hardware
+ * (submit returns early, sync blocks) measurable on machines without a
+ * VIA IGP.
+ *
+ * Configuration is read from the environment:
+ *
+ *   VIA_SHIM_DEVICE     device node to emulate (default /dev/dri/card0)
+ *   VIA_SHIM_VRAM_MB    size of the emulated video memory (default 64)
+ *   VIA_SHIM_LATENCY_US per-submission engine latency (default 20)
+ *   VIA_SHIM_BW_MBPS    engine transfer bandwidth in MB/s (default 200)
+ *   VIA_SHIM_2D         2D register layout, "h2" or "h6" (default h2)
+ *   VIA_SHIM_STATS      print submission statistics at exit when set
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+
+#include "drm.h"
+#ifndef __user
+#define __user
+#endif
+#include "via_drm.h"
+#include "via_3d_reg.h"
+
+#define SHIM_PAGE_SIZE		4096
+#define SHIM_MAX_BO		1024
+#define SHIM_MAX_BLITS		64
+#define SHIM_MMAP_BASE		0x10000000ULL
+#define SHIM_CMDBUF_SPACE	(256 * 1024)
+#define SHIM_MAX_FILLS		256
+
+/* 2D engine registers and bits, as in via_regs.h. */
+#define SHIM_GEC_BLT		0x00000001
+#define SHIM_GEC_FIXCOLOR_PAT	0x00002000
+#define SHIM_ROP_PATCOPY	0xF0
+#define SHIM_GEM_BPP_MASK	0x00000300
+#define SHIM_GEM_16BPP		0x00000100
+#define SHIM_GEM_32BPP		0x00000300
+#define SHIM_2D_REGS		0x400
+
+struct shim_2d_layout {
+	unsigned gecmd;
+	unsigned gemode;
+	unsigned dstpos;
+	unsigned dimension;
+	unsigned fgcolor;
+	unsigned dstbase;
+	unsigned pitch;
+};
+
+static const struct shim_2d_layout shim_2d_h2 = {
+	0x000, 0x004, 0x00C, 0x010, 0x018, 0x034, 0x038
+};
+
+static const struct shim_2d_layout shim_2d_h6 = {
+	0x000, 0x004, 0x010, 0x00C, 0x058, 0x014, 0x008
+};
+
+/* A solid fill waiting for the simulated engine to reach it. */
+struct shim_fill {
+	unsigned long long done_ns;
+	unsigned long offset;
+	unsigned long pitch;
+	unsigned width;
+	unsigned height;
+	unsigned cpp;
+	uint32_t color;
+};
+
+struct shim_bo {
+	int used;
+	uint32_t handle;
+	unsigned long offset;
+	unsigned long size;
+};
+
+struct shim_stats {
+	unsigned long ioctls;
+	unsigned long cmdbuf_submits;
+	unsigned long long cmdbuf_bytes;
+	unsigned long flushes;
+	unsigned long blits;
+	unsigned long long blit_bytes;
+	unsigned long blit_syncs;
+	unsigned long fills;
+	unsigned long allocs;
+	unsigned long frees;
+	unsigned long long wait_ns;
+	unsigned long long busy_ns;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	int initialized;
+	int fd;
+	const char *device;
+
+	unsigned char *vram;
+	unsigned long vram_size;
+	unsigned long long latency_ns;
+	unsigned long long bytes_per_sec;
+
+	struct shim_bo bo[SHIM_MAX_BO];
+	uint32_t next_handle;
+
+	/* Simulated engine timeline. */
+	unsigned long long engine_idle_ns;
+	unsigned long long blit_done_ns[SHIM_MAX_BLITS];
+	uint32_t blit_seq;
+
+	/* 2D engine state and fills not yet retired. */
+	const struct shim_2d_layout *layout;
+	uint32_t regs_2d[SHIM_2D_REGS / 4];
+	struct shim_fill fill[SHIM_MAX_FILLS];
+	unsigned fill_head;
+	unsigned fill_count;
+	pthread_cond_t fill_cond;
+	int retire_running;
+
+	struct shim_stats stats;
+} shim = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.fd = -1,
+	.fill_cond = PTHREAD_COND_INITIALIZER,
+};
+
+static int (*real_open)(const char *, int, ...);
+static int (*real_close)(int);
+static int (*real_ioctl)(int, unsigned long, ...);
+static void *(*real_mmap)(void *, size_t, int, int, int, off_t);
+static int (*real_munmap)(void *, size_t);
+
+static unsigned long long
+shim_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned long
+shim_env_ulong(const char *name, unsigned long def)
+{
+	const char *val = getenv(name);
+
+	if (!val || !*val)
+		return def;
+	return strtoul(val, NULL, 0);
+}
+
+static void
+shim_print_stats(void)
+{
+	struct shim_stats *s = &shim.stats;
+
+	fprintf(stderr,
+		"via_drm_shim: %lu ioctls\n"
+		"via_drm_shim: %lu command buffers, %llu bytes, %lu flushes\n"
+		"via_drm_shim: %lu DMA blits, %llu bytes, %lu syncs\n"
+		"via_drm_shim: %lu 2D fills\n"
+		"via_drm_shim: %lu allocations, %lu frees\n"
+		"via_drm_shim: engine busy %llu us, callers waited %llu us\n",
+		s->ioctls, s->cmdbuf_submits, s->cmdbuf_bytes, s->flushes,
+		s->blits, s->blit_bytes, s->blit_syncs, s->fills,
+		s->allocs, s->frees,
+		s->busy_ns / 1000, s->wait_ns / 1000);
+}
+
+static void
+shim_init(void)
+{
+	const char *engine;
+
+	if (shim.initialized)
+		return;
+
+	real_open = dlsym(RTLD_NEXT, "open");
+	real_close = dlsym(RTLD_NEXT, "close");
+	real_ioctl = dlsym(RTLD_NEXT, "ioctl");
+	real_mmap = dlsym(RTLD_NEXT, "mmap");
+	real_munmap = dlsym(RTLD_NEXT, "munmap");
+
+	shim.device = getenv("VIA_SHIM_DEVICE");
+	if (!shim.device)
+		shim.device = "/dev/dri/card0";
+	engine = getenv("VIA_SHIM_2D");
+	shim.layout = (engine && !strcmp(engine, "h6")) ?
+		&shim_2d_h6 : &shim_2d_h2;
+	shim.vram_size = shim_env_ulong("VIA_SHIM_VRAM_MB", 64) << 20;
+	shim.latency_ns = shim_env_ulong("VIA_SHIM_LATENCY_US", 20) * 1000ULL;
+	shim.bytes_per_sec = shim_env_ulong("VIA_SHIM_BW_MBPS", 200) << 20;
+	if (!shim.bytes_per_sec)
+		shim.bytes_per_sec = 1;
+	shim.next_handle = 1;
+
+	if (getenv("VIA_SHIM_STATS"))
+		atexit(shim_print_stats);
+
+	shim.initialized = 1;
+}
+
+/*
+ * Queue work of the given size on the simulated engine and return the
+ * time at which it completes.
+ */
+static unsigned long long
+shim_engine_queue(unsigned long long bytes)
+{
+	unsigned long long now = shim_now_ns();
+	unsigned long long cost;
+
+	cost = shim.latency_ns + bytes * 1000000000ULL / shim.bytes_per_sec;
+	if (shim.engine_idle_ns < now)
+		shim.engine_idle_ns = now;
+	shim.engine_idle_ns += cost;
+	shim.stats.busy_ns += cost;
+	return shim.engine_idle_ns;
+}
+
+static void
+shim_wait_until(unsigned long long when)
+{
+	unsigned long long now = shim_now_ns();
+	struct timespec ts;
+
+	if (when <= now)
+		return;
+
+	shim.stats.wait_ns += when - now;
+	ts.tv_sec = (when - now) / 1000000000ULL;
+	ts.tv_nsec = (when - now) % 1000000000ULL;
+	while (nanosleep(&ts, &ts) && errno == EINTR)
+		;
+}
+
+/*
+ * Write a fill to the emulated video memory. Fills outside of it are
+ * dropped, like writes to unbacked addresses on the hardware.
+ */
+static void
+shim_fill_apply(const struct shim_fill *f)
+{
+	unsigned long end = f->offset +
+		(unsigned long)(f->height - 1) * f->pitch + f->width * f->cpp;
+	unsigned char *row;
+	unsigned x, y;
+
+	if (end > shim.vram_size)
+		return;
+
+	row = shim.vram + f->offset;
+	for (y = 0; y < f->height; y++, row += f->pitch) {
+		for (x = 0; x < f->width; x++) {
+			if (f->cpp == 4)
+				((volatile uint32_t *)row)[x] = f->color;
+			else if (f->cpp == 2)
+				((volatile uint16_t *)row)[x] = f->color;
+			else
+				((volatile uint8_t *)row)[x] = f->color;
+		}
+	}
+	shim.stats.fills++;
+}
+
+/*
+ * Apply the fills the simulated engine has finished by now, or all of
+ * them. Called with the lock held.
+ */
+static void
+shim_fill_retire(int all)
+{
+	unsigned long long now = shim_now_ns();
+	struct shim_fill *f;
+
+	while (shim.fill_count) {
+		f = &shim.fill[shim.fill_head];
+		if (!all && f->done_ns > now)
+			break;
+		shim_fill_apply(f);
+		shim.fill_head = (shim.fill_head + 1) % SHIM_MAX_FILLS;
+		shim.fill_count--;
+	}
+}
+
+/*
+ * Callers poll marker memory without entering the shim, so fills are
+ * retired in the background when their time comes.
+ */
+static void *
+shim_retire_thread(void *arg)
+{
+	unsigned long long now, when;
+	struct timespec ts;
+
+	(void)arg;
+	pthread_mutex_lock(&shim.lock);
+	for (;;) {
+		while (!shim.fill_count)
+			pthread_cond_wait(&shim.fill_cond, &shim.lock);
+
+		when = shim.fill[shim.fill_head].done_ns;
+		now = shim_now_ns();
+		if (when > now) {
+			pthread_mutex_unlock(&shim.lock);
+			ts.tv_sec = (when - now) / 1000000000ULL;
+			ts.tv_nsec = (when - now) % 1000000000ULL;
+			while (nanosleep(&ts, &ts) && errno == EINTR)
+				;
+			pthread_mutex_lock(&shim.lock);
+		}
+		shim_fill_retire(0);
+	}
+	return NULL;
+}
+
+static void
+shim_fill_queue(const struct shim_fill *f)
+{
+	pthread_t thread;
+
+	if (!shim.retire_running) {
+		if (!pthread_create(&thread, NULL, shim_retire_thread, NULL)) {
+			pthread_detach(thread);
+			shim.retire_running = 1;
+		}
+	}
+
+	/* Without a thread or room to queue, the caller waits for it. */
+	if (!shim.retire_running) {
+		shim_wait_until(f->done_ns);
+		shim_fill_apply(f);
+		return;
+	}
+	if (shim.fill_count == SHIM_MAX_FILLS) {
+		shim_wait_until(shim.fill[shim.fill_head].done_ns);
+		shim_fill_retire(0);
+	}
+
+	shim.fill[(shim.fill_head + shim.fill_count) % SHIM_MAX_FILLS] = *f;
+	shim.fill_count++;
+	pthread_cond_signal(&shim.fill_cond);
+}
+
+/*
+ * Run a GECMD write. Only pattern copies with a fixed colour, which is
+ * how the DDX does solid fills, are executed.
+ */
+static void
+shim_2d_command(uint32_t cmd, unsigned long long done_ns)
+{
+	const struct shim_2d_layout *l = shim.layout;
+	uint32_t *regs = shim.regs_2d;
+	uint32_t pos = regs[l->dstpos / 4];
+	uint32_t dim = regs[l->dimension / 4];
+	struct shim_fill f;
+
+	if (!(cmd & SHIM_GEC_BLT) || !(cmd & SHIM_GEC_FIXCOLOR_PAT) ||
+	    (cmd >> 24) != SHIM_ROP_PATCOPY)
+		return;
+
+	switch (regs[l->gemode / 4] & SHIM_GEM_BPP_MASK) {
+	case SHIM_GEM_32BPP:
+		f.cpp = 4;
+		break;
+	case SHIM_GEM_16BPP:
+		f.cpp = 2;
+		break;
+	default:
+		f.cpp = 1;
+		break;
+	}
+	f.pitch = ((regs[l->pitch / 4] >> 16) & 0x7FFF) << 3;
+	f.width = (dim & 0xFFFF) + 1;
+	f.height = (dim >> 16) + 1;
+	f.offset = ((unsigned long)regs[l->dstbase / 4] << 3) +
+		(pos >> 16) * f.pitch + (pos & 0xFFFF) * f.cpp;
+	f.color = regs[l->fgcolor / 4];
+	f.done_ns = done_ns;
+	shim_fill_queue(&f);
+}
+
+/*
+ * Walk a command buffer, tracking 2D register writes and executing the
+ * fills they start. 3D sections are skipped up to the next header.
+ */
+static void
+shim_cmdbuf_execute(const uint32_t *buf, unsigned long dwords,
+		    unsigned long long done_ns)
+{
+	unsigned long i = 0;
+	unsigned reg;
+	uint32_t dw;
+
+	while (i < dwords) {
+		dw = buf[i++];
+
+		/* Skip the parameter type that follows a 3D header. */
+		if (dw == HALCYON_HEADER2) {
+			i++;
+			continue;
+		}
+		if ((dw & HALCYON_HEADER1MASK) != HALCYON_HEADER1 ||
+		    i == dwords)
+			continue;
+
+		reg = (dw & ~HALCYON_HEADER1MASK) << 2;
+		shim.regs_2d[reg / 4] = buf[i];
+		if (reg == shim.layout->gecmd)
+			shim_2d_command(buf[i], done_ns);
+		i++;
+	}
+}
+
+/*
+ * First-fit allocator over the emulated video memory. The BO table is
+ * kept sorted by offset so that gaps can be found in a single pass.
+ */
+static struct shim_bo *
+shim_bo_alloc(unsigned long size, unsigned long alignment)
+{
+	unsigned long start = 0;
+	struct shim_bo *free_slot = NULL;
+	int i, j;
+
+	if (!size)
+		return NULL;
+	if (alignment < SHIM_PAGE_SIZE)
+		alignment = SHIM_PAGE_SIZE;
+	size = (size + SHIM_PAGE_SIZE - 1) & ~(SHIM_PAGE_SIZE - 1UL);
+
+	for (i = 0; i <= SHIM_MAX_BO; i++) {
+		unsigned long end;
+
+		start = (start + alignment - 1) / alignment * alignment;
+		end = (i < SHIM_MAX_BO && shim.bo[i].used) ?
+			shim.bo[i].offset : shim.vram_size;
+		if (start + size <= end)
+			break;
+		if (i == SHIM_MAX_BO || !shim.bo[i].used)
+			return NULL;
+		start = shim.bo[i].offset + shim.bo[i].size;
+	}
+
+	for (j = 0; j < SHIM_MAX_BO; j++) {
+		if (!shim.bo[j].used) {
+			free_slot = &shim.bo[j];
+			break;
+		}
+	}
+	if (!free_slot)
+		return NULL;
+
+	/* Shift the tail up to keep the table sorted. */
+	memmove(&shim.bo[i + 1], &shim.bo[i],
+		(j - i) * sizeof(struct shim_bo));
+	free_slot = &shim.bo[i];
+	free_slot->used = 1;
+	free_slot->handle = shim.next_handle++;
+	free_slot->offset = start;
+	free_slot->size = size;
+	shim.stats.allocs++;
+	return free_slot;
+}
+
+static struct shim_bo *
+shim_bo_lookup(uint32_t handle)
+{
+	int i;
+
+	for (i = 0; i < SHIM_MAX_BO && shim.bo[i].used; i++)
+		if (shim.bo[i].handle == handle)
+			return &shim.bo[i];
+	return NULL;
+}
+
+static void
+shim_bo_free(struct shim_bo *bo)
+{
+	int i = bo - shim.bo;
+	int n;
+
+	for (n = i; n < SHIM_MAX_BO && shim.bo[n].used; n++)
+		;
+	memmove(&shim.bo[i], &shim.bo[i + 1],
+		(n - i - 1) * sizeof(struct shim_bo));
+	memset(&shim.bo[n - 1], 0, sizeof(struct shim_bo));
+	shim.stats.frees++;
+}
+
+static int
+shim_copy_string(char *dst, size_t *len, const char *src)
+{
+	size_t srclen = strlen(src);
+
+	if (dst && *len)
+		memcpy(dst, src, (*len < srclen) ? *len : srclen);
+	*len = srclen;
+	return 0;
+}
+
+static int
+shim_via_ioctl(unsigned nr, void *arg)
+{
+	switch (nr) {
+	case DRM_VIA_ALLOCMEM: {
+		drm_via_mem_t *mem = arg;
+		struct shim_bo *bo = shim_bo_alloc(mem->size, 16);
+
+		if (!bo)
+			return -ENOMEM;
+		mem->index = bo->handle;
+		mem->offset = bo->offset;
+		return 0;
+	}
+	case DRM_VIA_FREEMEM: {
+		drm_via_mem_t *mem = arg;
+		struct shim_bo *bo = shim_bo_lookup(mem->index);
+
+		if (!bo)
+			return -EINVAL;
+		shim_bo_free(bo);
+		return 0;
+	}
+	case DRM_VIA_CMDBUFFER:
+	case DRM_VIA_PCICMD: {
+		drm_via_cmdbuffer_t *cmd = arg;
+
+		if (cmd->size & 3)
+			return -EINVAL;
+		shim.stats.cmdbuf_submits++;
+		shim.stats.cmdbuf_bytes += cmd->size;
+		shim_cmdbuf_execute((const uint32_t *)cmd->buf, cmd->size / 4,
+				    shim_engine_queue(cmd->size));
+		/* PCI command submission is synchronous on real hardware. */
+		if (nr == DRM_VIA_PCICMD) {
+			shim_wait_until(shim.engine_idle_ns);
+			shim_fill_retire(1);
+		}
+		return 0;
+	}
+	case DRM_VIA_FLUSH:
+		shim.stats.flushes++;
+		shim_wait_until(shim.engine_idle_ns);
+		shim_fill_retire(1);
+		return 0;
+	case DRM_VIA_CMDBUF_SIZE: {
+		drm_via_cmdbuf_size_t *sz = arg;
+
+		if (sz->wait) {
+			shim_wait_until(shim.engine_idle_ns);
+			shim_fill_retire(1);
+		}
+		sz->size = (sz->func == VIA_CMDBUF_SPACE) ?
+			SHIM_CMDBUF_SPACE : 0;
+		return 0;
+	}
+	case DRM_VIA_DMA_BLIT: {
+		drm_via_dmablit_t *blit = arg;
+		unsigned long long bytes;
+		unsigned char *fb;
+		uint32_t i;
+
+		if (!blit->num_lines || !blit->line_length)
+			return -EINVAL;
+		if ((unsigned long long)blit->fb_addr +
+		    (unsigned long long)(blit->num_lines - 1) * blit->fb_stride +
+		    blit->line_length > shim.vram_size)
+			return -EINVAL;
+
+		fb = shim.vram + blit->fb_addr;
+		for (i = 0; i < blit->num_lines; i++) {
+			unsigned char *mem = blit->mem_addr +
+				(unsigned long)i * blit->mem_stride;
+
+			if (blit->to_fb)
+				memcpy(fb + (unsigned long)i * blit->fb_stride,
+				       mem, blit->line_length);
+			else
+				memcpy(mem, fb + (unsigned long)i *
+				       blit->fb_stride, blit->line_length);
+		}
+
+		bytes = (unsigned long long)blit->num_lines *
+			blit->line_length;
+		shim.stats.blits++;
+		shim.stats.blit_bytes += bytes;
+
+		blit->sync.sync_handle = ++shim.blit_seq;
+		blit->sync.engine = blit->to_fb ? 0 : 1;
+		shim.blit_done_ns[shim.blit_seq % SHIM_MAX_BLITS] =
+			shim_engine_queue(bytes);
+		return 0;
+	}
+	case DRM_VIA_BLIT_SYNC: {
+		drm_via_blitsync_t *sync = arg;
+
+		shim.stats.blit_syncs++;
+		/* Handles older than the ring are long complete. */
+		if (shim.blit_seq - sync->sync_handle < SHIM_MAX_BLITS)
+			shim_wait_until(shim.blit_done_ns[sync->sync_handle %
+							  SHIM_MAX_BLITS]);
+		return 0;
+	}
+	case DRM_VIA_GEM_ALLOC: {
+		struct drm_via_gem_alloc *args = arg;
+		struct shim_bo *bo = shim_bo_alloc(args->size,
+						   args->alignment);
+
+		if (!bo)
+			return -ENOMEM;
+		args->size = bo->size;
+		args->handle = bo->handle;
+		args->offset = bo->offset;
+		return 0;
+	}
+	case DRM_VIA_GEM_MMAP: {
+		struct drm_via_gem_mmap *args = arg;
+		struct shim_bo *bo = shim_bo_lookup(args->handle);
+
+		if (!bo)
+			return -ENOENT;
+		args->offset = SHIM_MMAP_BASE + bo->offset;
+		return 0;
+	}
+	case DRM_VIA_AGP_INIT:
+	case DRM_VIA_FB_INIT:
+	case DRM_VIA_MAP_INIT:
+	case DRM_VIA_DMA_INIT:
+	case DRM_VIA_DEC_FUTEX:
+	case DRM_VIA_WAIT_IRQ:
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+static int
+shim_drm_ioctl(unsigned long request, void *arg)
+{
+	unsigned nr = _IOC_NR(request);
+
+	shim.stats.ioctls++;
+
+	if (nr >= DRM_COMMAND_BASE && nr < DRM_COMMAND_END)
+		return shim_via_ioctl(nr - DRM_COMMAND_BASE, arg);
+
+	switch (nr) {
+	case _IOC_NR(DRM_IOCTL_VERSION): {
+		struct drm_version *v = arg;
+
+		v->version_major = 3;
+		v->version_minor = 0;
+		v->version_patchlevel = 0;
+		shim_copy_string(v->name, &v->name_len, "via");
+		shim_copy_string(v->date, &v->date_len, "20261019");
+		shim_copy_string(v->desc, &v->desc_len, "VIA DRM shim");
+		return 0;
+	}
+	case _IOC_NR(DRM_IOCTL_GET_UNIQUE): {
+		struct drm_unique *u = arg;
+
+		return shim_copy_string(u->unique, &u->unique_len,
+					"pci:0000:01:00.0");
+	}
+	case _IOC_NR(DRM_IOCTL_SET_VERSION):
+	case _IOC_NR(DRM_IOCTL_GET_MAGIC):
+	case _IOC_NR(DRM_IOCTL_AUTH_MAGIC):
+	case _IOC_NR(DRM_IOCTL_SET_MASTER):
+	case _IOC_NR(DRM_IOCTL_DROP_MASTER):
+		return 0;
+	case _IOC_NR(DRM_IOCTL_GEM_CLOSE): {
+		struct drm_gem_close *close = arg;
+		struct shim_bo *bo = shim_bo_lookup(close->handle);
+
+		if (!bo)
+			return -EINVAL;
+		shim_bo_free(bo);
+		return 0;
+	}
+	default:
+		return -EINVAL;
+	}
+}
+
+int
+open(const char *path, int flags, ...)
+{
+	mode_t mode = 0;
+	int fd;
+
+	shim_init();
+
+	if (flags & O_CREAT) {
+		va_list ap;
+
+		va_start(ap, flags);
+		mode = va_arg(ap, mode_t);
+		va_end(ap);
+	}
+
+	if (strcmp(path, shim.device))
+		return real_open(path, flags, mode);
+
+	pthread_mutex_lock(&shim.lock);
+	if (shim.fd >= 0) {
+		pthread_mutex_unlock(&shim.lock);
+		errno = EBUSY;
+		return -1;
+	}
+
+	if (!shim.vram) {
+		shim.vram = real_mmap(NULL, shim.vram_size,
+				      PROT_READ | PROT_WRITE,
+				      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (shim.vram == MAP_FAILED) {
+			shim.vram = NULL;
+			pthread_mutex_unlock(&shim.lock);
+			errno = ENOMEM;
+			return -1;
+		}
+	}
+
+	/* Any real descriptor will do; it only reserves the number. */
+	fd = real_open("/dev/null", O_RDWR | O_CLOEXEC);
+	shim.fd = fd;
+	pthread_mutex_unlock(&shim.lock);
+	return fd;
+}
+
+int
+open64(const char *path, int flags, ...)
+{
+	mode_t mode = 0;
+
+	if (flags & O_CREAT) {
+		va_list ap;
+
+		va_start(ap, flags);
+		mode = va_arg(ap, mode_t);
+		va_end(ap);
+	}
+	return open(path, flags | O_LARGEFILE, mode);
+}
+
+int
+close(int fd)
+{
+	shim_init();
+
+	pthread_mutex_lock(&shim.lock);
+	if (fd >= 0 && fd == shim.fd)
+		shim.fd = -1;
+	pthread_mutex_unlock(&shim.lock);
+	return real_close(fd);
+}
+
+int
+ioctl(int fd, unsigned long request, ...)
+{
+	va_list ap;
+	void *arg;
+	int ret;
+
+	shim_init();
+
+	va_start(ap, request);
+	arg = va_arg(ap, void *);
+	va_end(ap);
+
+	if (fd < 0 || fd != shim.fd || _IOC_TYPE(request) != DRM_IOCTL_BASE)
+		return real_ioctl(fd, request, arg);
+
+	pthread_mutex_lock(&shim.lock);
+	ret = shim_drm_ioctl(request, arg);
+	pthread_mutex_unlock(&shim.lock);
+
+	if (ret) {
+		errno = -ret;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * GEM objects live inside the emulated video memory, so mapping one just
+ * hands out the matching host address. The mapping is never released
+ * because it belongs to the shared backing store.
+ */
+void *
+mmap(void *addr, size_t len, int prot, int flags, int fd, off_t offset)
+{
+	unsigned long long off = (unsigned long long)offset;
+
+	shim_init();
+
+	if (fd < 0 || fd != shim.fd)
+		return real_mmap(addr, len, prot, flags, fd, offset);
+
+	if (off < SHIM_MMAP_BASE ||
+	    off - SHIM_MMAP_BASE + len > shim.vram_size) {
+		errno = EINVAL;
+		return MAP_FAILED;
+	}
+	return shim.vram + (off - SHIM_MMAP_BASE);
+}
+
+int
+munmap(void *addr, size_t len)
+{
+	unsigned char *p = addr;
+
+	shim_init();
+
+	if (shim.vram && p >= shim.vram && p < shim.vram + shim.vram_size)
+		return 0;
+	return real_munmap(addr, len);
+}
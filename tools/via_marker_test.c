@@ -0,0 +1,128 @@
+/*
+ * Copyright 2026 The OpenChrome Project
+ *                [https://www.freedesktop.org/wiki/Openchrome]
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Checks that the shim executes the solid fills the DDX submits, and
+ * that markers written by one pixel fills, as viaAccelMarkSync_H2 emits
+ * them, land in memory without the caller entering the shim again.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "via_shim_test.h"
+
+#define FILL_PITCH	256
+#define FILL_H		16
+#define FILL_COLOR	0x11223344
+#define BACKGROUND	0x5A
+#define NUM_MARKERS	100
+#define MARKER_TIMEOUT	5
+
+const char *test_name = "via_marker_test";
+
+/*
+ * Fill a rectangle and check it, and that nothing around it changed.
+ */
+static int
+test_fill(int fd, struct test_bo *bo)
+{
+	struct test_cmdbuf cb;
+	const int x = 5, y = 3, w = 10, h = 7;
+	unsigned char *row;
+	uint32_t expect, got;
+	int i, j;
+
+	memset(bo->ptr, BACKGROUND, FILL_PITCH * FILL_H);
+	cb.pos = 0;
+	test_cmd_fill(&cb, bo->offset, FILL_PITCH, x, y, w, h, FILL_COLOR);
+	if (test_cmd_submit(fd, &cb) || test_flush(fd))
+		return 1;
+
+	for (j = 0; j < FILL_H; j++) {
+		row = bo->ptr + j * FILL_PITCH;
+		for (i = 0; i < FILL_PITCH / 4; i++) {
+			expect = (i >= x && i < x + w && j >= y && j < y + h) ?
+				FILL_COLOR : BACKGROUND * 0x01010101U;
+			memcpy(&got, row + i * 4, 4);
+			if (got != expect)
+				return test_fail("fill: pixel %d,%d is %08x, "
+						 "expected %08x", i, j, got,
+						 expect);
+		}
+	}
+	return 0;
+}
+
+/*
+ * Queue a run of markers and poll for the last one the way
+ * viaAccelWaitMarker does, by reading memory only.
+ */
+static int
+test_markers(int fd, struct test_bo *bo)
+{
+	volatile uint32_t *marker = (volatile uint32_t *)bo->ptr;
+	struct test_cmdbuf cb;
+	time_t deadline;
+	uint32_t i;
+
+	*marker = 0;
+	for (i = 1; i <= NUM_MARKERS; i++) {
+		cb.pos = 0;
+		test_cmd_fill(&cb, bo->offset, 0, 0, 0, 1, 1, i);
+		if (test_cmd_submit(fd, &cb))
+			return 1;
+	}
+
+	deadline = time(NULL) + MARKER_TIMEOUT;
+	while (*marker != NUM_MARKERS) {
+		if (time(NULL) > deadline)
+			return test_fail("markers: still at %u after %d s, "
+					 "expected %u", *marker,
+					 MARKER_TIMEOUT, NUM_MARKERS);
+		usleep(100);
+	}
+	return 0;
+}
+
+int
+main(void)
+{
+	struct test_bo bo;
+	int fd, ret;
+
+	fd = test_open();
+	if (fd < 0)
+		return 1;
+	if (test_bo_alloc(fd, FILL_PITCH * FILL_H, &bo))
+		return 1;
+
+	ret = test_fill(fd, &bo) || test_markers(fd, &bo);
+
+	test_bo_free(fd, &bo);
+	close(fd);
+	return ret;
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2026 The OpenChrome Project
+ *                [https://www.freedesktop.org/wiki/Openchrome]
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#include "drm.h"
+#ifndef __user
+#define __user
+#endif
+#include "via_drm.h"
+#include "via_3d_reg.h"
+#include "via_shim_test.h"
+
+int
+test_fail(const char *fmt, ...)
+{
+	va_list ap;
+
+	fprintf(stderr, "%s: ", test_name);
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fputc('\n', stderr);
+	return 1;
+}
+
+int
+test_open(void)
+{
+	const char *device = getenv("VIA_SHIM_DEVICE");
+	int fd;
+
+	if (!device)
+		device = "/dev/dri/card0";
+
+	fd = open(device, O_RDWR);
+	if (fd < 0)
+		test_fail("cannot open %s (is via_drm_shim.so preloaded?)",
+			  device);
+	return fd;
+}
+
+int
+test_bo_alloc(int fd, unsigned long size, struct test_bo *bo)
+{
+	struct drm_via_gem_alloc alloc;
+	struct drm_via_gem_mmap map;
+	void *ptr;
+
+	memset(&alloc, 0, sizeof(alloc));
+	alloc.size = size;
+	alloc.alignment = 16;
+	alloc.domain = TEST_DOMAIN_VRAM;
+	if (ioctl(fd, DRM_IOCTL_VIA_GEM_ALLOC, &alloc))
+		return test_fail("GEM alloc of %lu bytes failed: %s", size,
+				 strerror(errno));
+
+	memset(&map, 0, sizeof(map));
+	map.handle = alloc.handle;
+	if (ioctl(fd, DRM_IOCTL_VIA_GEM_MMAP, &map))
+		return test_fail("GEM mmap failed: %s", strerror(errno));
+
+	ptr = mmap(NULL, alloc.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+		   map.offset);
+	if (ptr == MAP_FAILED)
+		return test_fail("mmap failed: %s", strerror(errno));
+
+	bo->handle = alloc.handle;
+	bo->offset = alloc.offset;
+	bo->size = alloc.size;
+	bo->ptr = ptr;
+	return 0;
+}
+
+void
+test_bo_free(int fd, struct test_bo *bo)
+{
+	struct drm_gem_close close;
+
+	munmap(bo->ptr, bo->size);
+	memset(&close, 0, sizeof(close));
+	close.handle = bo->handle;
+	ioctl(fd, DRM_IOCTL_GEM_CLOSE, &close);
+}
+
+void
+test_cmd_reg(struct test_cmdbuf *cb, unsigned reg, uint32_t val)
+{
+	cb->buf[cb->pos++] = HALCYON_HEADER1 | (reg >> 2);
+	cb->buf[cb->pos++] = val;
+}
+
+/*
+ * A 32 bpp solid fill, programmed the way viaExaSolid_H2 does it.
+ */
+void
+test_cmd_fill(struct test_cmdbuf *cb, unsigned long offset, unsigned pitch,
+	      int x, int y, int w, int h, uint32_t color)
+{
+	test_cmd_reg(cb, TEST_REG_GEMODE, TEST_GEM_32BPP);
+	test_cmd_reg(cb, TEST_REG_DSTBASE, offset >> 3);
+	test_cmd_reg(cb, TEST_REG_PITCH,
+		     TEST_PITCH_ENABLE | ((pitch >> 3) << 16));
+	test_cmd_reg(cb, TEST_REG_DSTPOS, (y << 16) | (x & 0xFFFF));
+	test_cmd_reg(cb, TEST_REG_DIMENSION, ((h - 1) << 16) | (w - 1));
+	test_cmd_reg(cb, TEST_REG_FGCOLOR, color);
+	test_cmd_reg(cb, TEST_REG_GECMD,
+		     (0xF0 << 24) | TEST_GEC_BLT | TEST_GEC_FIXCOLOR_PAT);
+}
+
+int
+test_cmd_submit(int fd, struct test_cmdbuf *cb)
+{
+	drm_via_cmdbuffer_t cmd;
+
+	cmd.buf = (char *)cb->buf;
+	cmd.size = cb->pos * 4;
+	cb->pos = 0;
+	if (ioctl(fd, DRM_IOCTL_VIA_CMDBUFFER, &cmd))
+		return test_fail("command submission failed: %s",
+				 strerror(errno));
+	return 0;
+}
+
+int
+test_flush(int fd)
+{
+	if (ioctl(fd, DRM_IOCTL_VIA_FLUSH, NULL))
+		return test_fail("flush failed: %s", strerror(errno));
+	return 0;
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2026 The OpenChrome Project
+ *                [https://www.freedesktop.org/wiki/Openchrome]
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Helpers for the tests that run against via_drm_shim.so, see
+ * via_drm_shim.c. The tests are run with the shim preloaded and
+ * VIA_SHIM_DEVICE pointing at a node that does not exist, so they never
+ * touch real hardware.
+ */
+
+#ifndef _VIA_SHIM_TEST_H_
+#define _VIA_SHIM_TEST_H_
+
+#include <stdint.h>
+
+/* 2D engine registers and bits, as in via_regs.h. */
+#define TEST_REG_GECMD		0x000
+#define TEST_REG_GEMODE		0x004
+#define TEST_REG_DSTPOS		0x00C
+#define TEST_REG_DIMENSION	0x010
+#define TEST_REG_FGCOLOR	0x018
+#define TEST_REG_DSTBASE	0x034
+#define TEST_REG_PITCH		0x038
+#define TEST_GEC_BLT		0x00000001
+#define TEST_GEC_FIXCOLOR_PAT	0x00002000
+#define TEST_GEM_32BPP		0x00000300
+#define TEST_PITCH_ENABLE	0x80000000
+
+/* TTM_PL_VRAM, as in via_memmgr.h. */
+#define TEST_DOMAIN_VRAM	2
+
+struct test_bo {
+	uint32_t handle;
+	unsigned long offset;
+	unsigned long size;
+	unsigned char *ptr;
+};
+
+struct test_cmdbuf {
+	uint32_t buf[256];
+	unsigned pos;
+};
+
+extern const char *test_name;
+
+int test_fail(const char *fmt, ...);
+int test_open(void);
+int test_bo_alloc(int fd, unsigned long size, struct test_bo *bo);
+void test_bo_free(int fd, struct test_bo *bo);
+void test_cmd_reg(struct test_cmdbuf *cb, unsigned reg, uint32_t val);
+void test_cmd_fill(struct test_cmdbuf *cb, unsigned long offset,
+		   unsigned pitch, int x, int y, int w, int h,
+		   uint32_t color);
+int test_cmd_submit(int fd, struct test_cmdbuf *cb);
+int test_flush(int fd);
+
+#endif
@@ -0,0 +1,186 @@
+/*
+ * Copyright 2026 The OpenChrome Project
+ *                [https://www.freedesktop.org/wiki/Openchrome]
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Checks how EXA picks its upload path, viaUploadPathsInit() and
+ * viaUploadPaths(), and the PCI DMA upload path, viaDMAUploadBlits(),
+ * against what the memcpy path writes, including the pixels around the
+ * uploaded rectangle. The bounce buffer is kept small so that a
+ * misaligned upload takes several chunks and both of its halves.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "via_dma_upload.h"
+#include "via_shim_test.h"
+
+/* The starting thresholds, as in via_driver.h. */
+#define MIN_UPLOAD	4000
+#define MIN_TEX_UPLOAD	200
+
+#define PIX_W		128
+#define PIX_H		64
+#define PIX_CPP		4
+#define PIX_PITCH	(PIX_W * PIX_CPP)
+#define PIX_SIZE	(PIX_PITCH * PIX_H)
+#define BOUNCE_SIZE	4096
+#define BACKGROUND	0x5A
+
+const char *test_name = "via_upload_test";
+
+static unsigned char ref[PIX_SIZE];
+static unsigned char bounce[BOUNCE_SIZE * 2 + 16];
+
+static int
+test_paths(const char *name, unsigned paths, unsigned expected)
+{
+	if (paths != expected)
+		return test_fail("%s: paths are %#x, expected %#x", name,
+				 paths, expected);
+	return 0;
+}
+
+/*
+ * The paths viaInitExa sets up for each chipset group and board, and
+ * those viaExaUploadToScreen tries for each size.
+ */
+static int
+test_dispatch(void)
+{
+	unsigned both = VIA_UPLOAD_AGP | VIA_UPLOAD_DMA;
+
+	return test_paths("AGP chip", viaUploadPathsInit(1, 0, 0), 0) ||
+	       test_paths("AGP chip, opted in",
+			  viaUploadPathsInit(1, 0, 1), VIA_UPLOAD_AGP) ||
+	       test_paths("AGP chip on PCI, opted in",
+			  viaUploadPathsInit(1, 1, 1), 0) ||
+	       test_paths("DMA chip", viaUploadPathsInit(0, 0, 0),
+			  VIA_UPLOAD_DMA) ||
+	       test_paths("DMA chip on PCI, opted in",
+			  viaUploadPathsInit(0, 1, 1), VIA_UPLOAD_DMA) ||
+	       test_paths("below both",
+			  viaUploadPaths(both, MIN_TEX_UPLOAD - 1,
+					 MIN_TEX_UPLOAD, MIN_UPLOAD), 0) ||
+	       test_paths("texture size",
+			  viaUploadPaths(both, MIN_TEX_UPLOAD,
+					 MIN_TEX_UPLOAD, MIN_UPLOAD),
+			  VIA_UPLOAD_AGP) ||
+	       test_paths("DMA size",
+			  viaUploadPaths(both, MIN_UPLOAD,
+					 MIN_TEX_UPLOAD, MIN_UPLOAD), both) ||
+	       test_paths("texture size, DMA only",
+			  viaUploadPaths(VIA_UPLOAD_DMA, MIN_UPLOAD - 1,
+					 MIN_TEX_UPLOAD, MIN_UPLOAD), 0);
+}
+
+/*
+ * Upload a w x h rectangle to x, y the way viaExaUploadToScreen does on
+ * a PCI DMA chipset, check that it took the expected path, and compare
+ * the pixmap with the memcpy result.
+ */
+static int
+test_upload(int fd, struct test_bo *bo, const char *name,
+	    unsigned char *src, int srcPitch, int x, int y, int w, int h,
+	    unsigned expected)
+{
+	unsigned long dstOffset = y * PIX_PITCH + x * PIX_CPP;
+	unsigned paths;
+	int i, err;
+
+	memset(ref, BACKGROUND, PIX_SIZE);
+	for (i = 0; i < h; i++)
+		memcpy(ref + dstOffset + i * PIX_PITCH, src + i * srcPitch,
+		       w * PIX_CPP);
+
+	paths = viaUploadPaths(viaUploadPathsInit(0, 1, 0), w * PIX_CPP * h,
+			       MIN_TEX_UPLOAD, MIN_UPLOAD);
+	if (test_paths(name, paths, expected))
+		return 1;
+
+	memset(bo->ptr, BACKGROUND, PIX_SIZE);
+	if (paths & VIA_UPLOAD_DMA) {
+		err = viaDMAUploadBlits(fd, bounce, BOUNCE_SIZE,
+					bo->offset + dstOffset, PIX_PITCH,
+					src, srcPitch, w * PIX_CPP, h);
+		if (err)
+			return test_fail("%s: upload failed: %s", name,
+					 strerror(-err));
+	} else {
+		for (i = 0; i < h; i++)
+			memcpy(bo->ptr + dstOffset + i * PIX_PITCH,
+			       src + i * srcPitch, w * PIX_CPP);
+	}
+
+	for (i = 0; i < PIX_SIZE; i++) {
+		if (bo->ptr[i] != ref[i])
+			return test_fail("%s: byte %d of line %d is %02x, "
+					 "expected %02x", name,
+					 i % PIX_PITCH, i / PIX_PITCH,
+					 bo->ptr[i], ref[i]);
+	}
+	return 0;
+}
+
+int
+main(void)
+{
+	unsigned char *src;
+	struct test_bo bo;
+	int fd, ret, i;
+
+	if (posix_memalign((void **)&src, 16, PIX_SIZE + 16))
+		return test_fail("out of memory");
+	for (i = 0; i < PIX_SIZE + 16; i++)
+		src[i] = (i * 7 + (i >> 8)) & 0xFF;
+
+	if (test_dispatch())
+		return 1;
+
+	fd = test_open();
+	if (fd < 0)
+		return 1;
+	if (test_bo_alloc(fd, PIX_SIZE, &bo))
+		return 1;
+
+	/* Aligned, blitted straight from the source. */
+	ret = test_upload(fd, &bo, "aligned", src, PIX_PITCH,
+			  0, 0, PIX_W, PIX_H, VIA_UPLOAD_DMA) ||
+	/* Misaligned source at an odd position, through the bounce buffer. */
+	      test_upload(fd, &bo, "misaligned", src + 4, PIX_PITCH - 4,
+			  3, 5, 37, 41, VIA_UPLOAD_DMA) ||
+	/* Aligned source with a pitch that isn't. */
+	      test_upload(fd, &bo, "odd pitch", src, PIX_PITCH - 12,
+			  1, 2, 61, 59, VIA_UPLOAD_DMA) ||
+	/* Too small for the DMA, written through the CPU. */
+	      test_upload(fd, &bo, "small", src, PIX_PITCH,
+			  7, 9, 31, 31, 0);
+
+	test_bo_free(fd, &bo);
+	close(fd);
+	free(src);
+	return ret;
+}
@@ -0,0 +1,10 @@
+#!/bin/sh
+#
+# Replays the hand-written sample trace through viatop -R and compares
+# the report with the expected one. The trace has two one-second
+# intervals with known engine, HQV, fetch and CPU activity.
+
+srcdir=${srcdir:-.}
+
+./viatop -R "$srcdir/viatop-sample.trace" |
+    diff -u "$srcdir/viatop-sample.out" -
@@ -0,0 +1,751 @@
+/*
+ * Copyright 2026 The OpenChrome Project
+ *                [https://www.freedesktop.org/wiki/Openchrome]
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Engine utilisation sampler.
+ *
+ * viatop maps the MMIO BAR of the IGP through sysfs and polls the engine
+ * status, the HQV and the command regulator registers at a fixed rate.
+ * Once per interval it prints how often the 2D engine, the 3D engine and
+ * the command regulator were busy, how often the virtual queue held
+ * commands, how many bytes the regulator fetched, how many times each
+ * HQV flipped to a new source buffer, and how busy the CPUs were. An
+ * engine near 100% with idle CPUs is the bottleneck; idle engines next
+ * to busy CPUs point at software rendering or at the X server itself.
+ *
+ * The regulator has no readable queue depth. Its reader address is
+ * sampled instead, so "fetch" shows how much command data went through
+ * it, which only moves when the driver submits through a ring.
+ *
+ * Samples can be written to a file with -w and analysed later with -R,
+ * which runs the same reporting code on the recorded stream. The format
+ * is text: a header line, then one line per sample
+ *
+ *   s <ns> <status> <hqv0 ctl> <hqv0 src> <hqv1 ctl> <hqv1 src> <reader>
+ *
+ * with the registers in hex, and one line per interval
+ *
+ *   c <ns> <busy jiffies> <total jiffies>
+ *
+ * from /proc/stat, so traces can also be written by hand.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/types.h>
+
+#define TOP_VENDOR_VIA		0x1106
+#define TOP_TRACE_MAGIC		"# viatop 1"
+
+/* Registers, see via_regs.h and via_eng_regs.h. */
+#define TOP_REG_STATUS		0x400
+#define TOP_REG_HQV_CONTROL	0x3D0
+#define TOP_REG_HQV_SRC_Y	0x3D4
+#define TOP_HQV1_OFFSET		0x1000
+#define TOP_MMIO_SIZE		0x2000
+
+#define TOP_HQV_ENABLE		0x08000000
+
+enum {
+	TOP_STATUS,
+	TOP_HQV0_CTL,
+	TOP_HQV0_SRC,
+	TOP_HQV1_CTL,
+	TOP_HQV1_SRC,
+	TOP_READER,
+	TOP_NREGS
+};
+
+/* Engine status bits of one chipset family. */
+struct top_bits {
+	uint32_t busy_2d;
+	uint32_t busy_3d;
+	uint32_t busy_cr;
+	uint32_t vq_busy;	/* set while the VQ holds commands */
+	uint32_t vq_empty;	/* set while it does not */
+};
+
+static const struct top_bits top_bits_h2 = {
+	.busy_2d = 0x00000002,
+	.busy_3d = 0x00000001,
+	.busy_cr = 0x00000080,
+	.vq_empty = 0x00020000,
+};
+
+static const struct top_bits top_bits_h5 = {
+	.busy_2d = 0x00000002,
+	.busy_3d = 0x00001FE1,
+	.busy_cr = 0x00000010,
+	.vq_busy = 0x00000004,
+};
+
+struct top_device {
+	char path[512];
+	uint16_t device;
+	volatile uint8_t *mmio;
+	int fd;
+	uint32_t reader_reg;
+	const struct top_bits *bits;
+};
+
+struct top_event {
+	int type;		/* 's' or 'c' */
+	uint64_t ns;
+	uint32_t reg[TOP_NREGS];
+	uint64_t cpu_busy;
+	uint64_t cpu_total;
+};
+
+/* Accumulated over one interval. */
+struct top_stats {
+	uint64_t start_ns;
+	uint64_t last_ns;
+	unsigned long samples;
+	unsigned long busy_2d;
+	unsigned long busy_3d;
+	unsigned long busy_cr;
+	unsigned long vq_busy;
+	unsigned long idle;
+	unsigned long flips[2];
+	uint64_t fetched;
+	int cpu_valid;
+	uint64_t cpu_busy;
+	uint64_t cpu_total;
+};
+
+struct top_state {
+	const struct top_bits *bits;
+	int have_prev;
+	uint32_t prev[TOP_NREGS];
+	int have_cpu;
+	uint64_t prev_cpu_busy;
+	uint64_t prev_cpu_total;
+	uint64_t interval_ns;
+	uint64_t origin_ns;
+	int rows;
+	struct top_stats cur;
+	struct top_stats total;
+};
+
+static volatile sig_atomic_t top_quit;
+
+static void
+top_sigint(int sig)
+{
+	(void)sig;
+	top_quit = 1;
+}
+
+static uint64_t
+top_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static const struct top_bits *
+top_bits_for(uint16_t device)
+{
+	switch (device) {
+	case 0x1122:	/* VX800 */
+	case 0x5122:	/* VX855/VX875 */
+	case 0x7122:	/* VX900 */
+		return &top_bits_h5;
+	default:
+		return &top_bits_h2;
+	}
+}
+
+/* The reader address register moved on the PM800 and P4M800 Pro. */
+static uint32_t
+top_reader_for(uint16_t device)
+{
+	switch (device) {
+	case 0x3118:
+	case 0x3344:
+		return 0x40c;
+	default:
+		return 0x418;
+	}
+}
+
+static int
+top_read_hex(const char *dir, const char *name, unsigned long *val)
+{
+	char path[640], buf[32];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	f = fopen(path, "r");
+	if (!f)
+		return -errno;
+	if (!fgets(buf, sizeof(buf), f)) {
+		fclose(f);
+		return -EIO;
+	}
+	fclose(f);
+	*val = strtoul(buf, NULL, 16);
+	return 0;
+}
+
+/*
+ * Find the VIA display controller, or check the one given with -d.
+ */
+static int
+top_find_device(struct top_device *dev, const char *slot)
+{
+	const char *base = "/sys/bus/pci/devices";
+	unsigned long vendor, class, device;
+	struct dirent *de;
+	DIR *dir;
+
+	if (slot) {
+		snprintf(dev->path, sizeof(dev->path), "%s/%s", base, slot);
+		if (top_read_hex(dev->path, "vendor", &vendor) ||
+		    top_read_hex(dev->path, "device", &device) ||
+		    vendor != TOP_VENDOR_VIA)
+			return -ENODEV;
+		dev->device = device;
+		return 0;
+	}
+
+	dir = opendir(base);
+	if (!dir)
+		return -errno;
+
+	while ((de = readdir(dir))) {
+		if (de->d_name[0] == '.')
+			continue;
+		snprintf(dev->path, sizeof(dev->path), "%s/%s", base,
+			 de->d_name);
+		if (top_read_hex(dev->path, "vendor", &vendor) ||
+		    top_read_hex(dev->path, "class", &class) ||
+		    top_read_hex(dev->path, "device", &device))
+			continue;
+		if (vendor == TOP_VENDOR_VIA && (class >> 16) == 0x03) {
+			dev->device = device;
+			closedir(dir);
+			return 0;
+		}
+	}
+	closedir(dir);
+	return -ENODEV;
+}
+
+/*
+ * The MMIO registers are BAR 1 on all chipsets.
+ */
+static int
+top_map_device(struct top_device *dev)
+{
+	char path[640];
+	void *map;
+
+	snprintf(path, sizeof(path), "%s/resource1", dev->path);
+	dev->fd = open(path, O_RDONLY | O_SYNC);
+	if (dev->fd < 0)
+		return -errno;
+
+	map = mmap(NULL, TOP_MMIO_SIZE, PROT_READ, MAP_SHARED, dev->fd, 0);
+	if (map == MAP_FAILED) {
+		close(dev->fd);
+		return -errno;
+	}
+
+	dev->mmio = map;
+	dev->bits = top_bits_for(dev->device);
+	dev->reader_reg = top_reader_for(dev->device);
+	return 0;
+}
+
+static uint32_t
+top_readl(struct top_device *dev, uint32_t reg)
+{
+	return *(volatile uint32_t *)(dev->mmio + reg);
+}
+
+static void
+top_sample(struct top_device *dev, struct top_event *ev)
+{
+	ev->type = 's';
+	ev->ns = top_now_ns();
+	ev->reg[TOP_STATUS] = top_readl(dev, TOP_REG_STATUS);
+	ev->reg[TOP_HQV0_CTL] = top_readl(dev, TOP_REG_HQV_CONTROL);
+	ev->reg[TOP_HQV0_SRC] = top_readl(dev, TOP_REG_HQV_SRC_Y);
+	ev->reg[TOP_HQV1_CTL] = top_readl(dev, TOP_REG_HQV_CONTROL +
+					  TOP_HQV1_OFFSET);
+	ev->reg[TOP_HQV1_SRC] = top_readl(dev, TOP_REG_HQV_SRC_Y +
+					  TOP_HQV1_OFFSET);
+	ev->reg[TOP_READER] = top_readl(dev, dev->reader_reg);
+}
+
+/*
+ * Busy and total jiffies of all CPUs.
+ */
+static int
+top_cpu(struct top_event *ev)
+{
+	unsigned long long v[8] = { 0 };
+	FILE *f;
+	int i, n;
+
+	f = fopen("/proc/stat", "r");
+	if (!f)
+		return -errno;
+	n = fscanf(f, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+		   &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]);
+	fclose(f);
+	if (n < 4)
+		return -EIO;
+
+	ev->type = 'c';
+	ev->ns = top_now_ns();
+	ev->cpu_total = 0;
+	for (i = 0; i < 8; i++)
+		ev->cpu_total += v[i];
+	/* idle and iowait */
+	ev->cpu_busy = ev->cpu_total - v[3] - v[4];
+	return 0;
+}
+
+static void
+top_record(FILE *f, const struct top_event *ev)
+{
+	if (ev->type == 's')
+		fprintf(f, "s %" PRIu64 " %08x %08x %08x %08x %08x %08x\n",
+			ev->ns, ev->reg[TOP_STATUS],
+			ev->reg[TOP_HQV0_CTL], ev->reg[TOP_HQV0_SRC],
+			ev->reg[TOP_HQV1_CTL], ev->reg[TOP_HQV1_SRC],
+			ev->reg[TOP_READER]);
+	else
+		fprintf(f, "c %" PRIu64 " %" PRIu64 " %" PRIu64 "\n",
+			ev->ns, ev->cpu_busy, ev->cpu_total);
+}
+
+/*
+ * Read the next event of a trace. Returns 1 on success, 0 at the end.
+ */
+static int
+top_replay(FILE *f, struct top_event *ev)
+{
+	char line[256];
+
+	while (fgets(line, sizeof(line), f)) {
+		if (line[0] == 's' &&
+		    sscanf(line + 1, "%" SCNu64 " %x %x %x %x %x %x", &ev->ns,
+			   &ev->reg[TOP_STATUS],
+			   &ev->reg[TOP_HQV0_CTL], &ev->reg[TOP_HQV0_SRC],
+			   &ev->reg[TOP_HQV1_CTL], &ev->reg[TOP_HQV1_SRC],
+			   &ev->reg[TOP_READER]) == 7) {
+			ev->type = 's';
+			return 1;
+		}
+		if (line[0] == 'c' &&
+		    sscanf(line + 1, "%" SCNu64 " %" SCNu64 " %" SCNu64,
+			   &ev->ns, &ev->cpu_busy, &ev->cpu_total) == 3) {
+			ev->type = 'c';
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Parse the trace header, which names the PCI device the trace was
+ * taken on so that the status bits are decoded the same way.
+ */
+static int
+top_replay_header(FILE *f, uint16_t *device)
+{
+	char line[256];
+	unsigned int id;
+
+	if (!fgets(line, sizeof(line), f) ||
+	    strncmp(line, TOP_TRACE_MAGIC, strlen(TOP_TRACE_MAGIC)))
+		return -EINVAL;
+	if (sscanf(line + strlen(TOP_TRACE_MAGIC), " device=%x", &id) != 1)
+		return -EINVAL;
+	*device = id;
+	return 0;
+}
+
+static void
+top_stats_add(struct top_stats *to, const struct top_stats *from)
+{
+	if (!to->samples)
+		to->start_ns = from->start_ns;
+	to->last_ns = from->last_ns;
+	to->samples += from->samples;
+	to->busy_2d += from->busy_2d;
+	to->busy_3d += from->busy_3d;
+	to->busy_cr += from->busy_cr;
+	to->vq_busy += from->vq_busy;
+	to->idle += from->idle;
+	to->flips[0] += from->flips[0];
+	to->flips[1] += from->flips[1];
+	to->fetched += from->fetched;
+	if (from->cpu_valid) {
+		to->cpu_valid = 1;
+		to->cpu_busy += from->cpu_busy;
+		to->cpu_total += from->cpu_total;
+	}
+}
+
+static double
+top_pct(unsigned long n, unsigned long d)
+{
+	return d ? 100. * n / d : 0.;
+}
+
+static void
+top_print_header(void)
+{
+	printf("%9s %6s %6s %6s %6s %6s %8s %8s %10s %6s\n",
+	       "time", "2D%", "3D%", "CR%", "VQ%", "idle%",
+	       "hqv0/s", "hqv1/s", "fetch kB/s", "cpu%");
+}
+
+static void
+top_print(const char *label, const struct top_stats *s)
+{
+	double secs = (s->last_ns - s->start_ns) / 1e9;
+
+	if (secs <= 0.)
+		secs = 1e-9;
+
+	printf("%9s %6.1f %6.1f %6.1f %6.1f %6.1f %8.1f %8.1f %10.1f ",
+	       label,
+	       top_pct(s->busy_2d, s->samples),
+	       top_pct(s->busy_3d, s->samples),
+	       top_pct(s->busy_cr, s->samples),
+	       top_pct(s->vq_busy, s->samples),
+	       top_pct(s->idle, s->samples),
+	       s->flips[0] / secs, s->flips[1] / secs,
+	       s->fetched / 1024. / secs);
+	if (s->cpu_valid)
+		printf("%6.1f\n", top_pct(s->cpu_busy, s->cpu_total));
+	else
+		printf("%6s\n", "-");
+}
+
+static void
+top_report(struct top_state *st)
+{
+	char label[32];
+
+	if (!st->cur.samples)
+		return;
+
+	if (!(st->rows++ % 20))
+		top_print_header();
+
+	snprintf(label, sizeof(label), "%.2f",
+		 (st->cur.last_ns - st->origin_ns) / 1e9);
+	top_print(label, &st->cur);
+
+	top_stats_add(&st->total, &st->cur);
+	memset(&st->cur, 0, sizeof(st->cur));
+}
+
+/*
+ * Account one sample. A flip shows as a new HQV source address while the
+ * HQV is enabled, a fetch as the reader address moving forward. A reader
+ * that moved back has wrapped or was restarted and is not counted.
+ */
+static void
+top_account(struct top_state *st, const struct top_event *ev)
+{
+	const struct top_bits *b = st->bits;
+	struct top_stats *s = &st->cur;
+	uint32_t status = ev->reg[TOP_STATUS];
+	int busy = 0;
+
+	/* Hand-written traces may well start at 0. */
+	if (!st->have_prev)
+		st->origin_ns = ev->ns;
+	if (!s->samples)
+		s->start_ns = ev->ns;
+	s->last_ns = ev->ns;
+	s->samples++;
+
+	if (status & b->busy_2d) {
+		s->busy_2d++;
+		busy = 1;
+	}
+	if (status & b->busy_3d) {
+		s->busy_3d++;
+		busy = 1;
+	}
+	if (status & b->busy_cr) {
+		s->busy_cr++;
+		busy = 1;
+	}
+	if ((b->vq_busy && (status & b->vq_busy)) ||
+	    (b->vq_empty && !(status & b->vq_empty))) {
+		s->vq_busy++;
+		busy = 1;
+	}
+	if (!busy)
+		s->idle++;
+
+	if (st->have_prev) {
+		if ((ev->reg[TOP_HQV0_CTL] & TOP_HQV_ENABLE) &&
+		    ev->reg[TOP_HQV0_SRC] != st->prev[TOP_HQV0_SRC])
+			s->flips[0]++;
+		if ((ev->reg[TOP_HQV1_CTL] & TOP_HQV_ENABLE) &&
+		    ev->reg[TOP_HQV1_SRC] != st->prev[TOP_HQV1_SRC])
+			s->flips[1]++;
+		if (ev->reg[TOP_READER] > st->prev[TOP_READER])
+			s->fetched += ev->reg[TOP_READER] -
+				      st->prev[TOP_READER];
+	}
+	memcpy(st->prev, ev->reg, sizeof(st->prev));
+	st->have_prev = 1;
+}
+
+static void
+top_account_cpu(struct top_state *st, const struct top_event *ev)
+{
+	if (st->have_cpu) {
+		st->cur.cpu_valid = 1;
+		st->cur.cpu_busy += ev->cpu_busy - st->prev_cpu_busy;
+		st->cur.cpu_total += ev->cpu_total - st->prev_cpu_total;
+	}
+	st->prev_cpu_busy = ev->cpu_busy;
+	st->prev_cpu_total = ev->cpu_total;
+	st->have_cpu = 1;
+}
+
+/*
+ * Feed one event to the analysis. An interval ends with the first
+ * sample past it; the CPU line written at the boundary belongs to the
+ * interval that it closes.
+ */
+static void
+top_feed(struct top_state *st, const struct top_event *ev)
+{
+	if (ev->type == 'c') {
+		top_account_cpu(st, ev);
+		return;
+	}
+
+	if (st->cur.samples && ev->ns - st->cur.start_ns >= st->interval_ns)
+		top_report(st);
+	top_account(st, ev);
+}
+
+static void
+top_finish(struct top_state *st)
+{
+	top_report(st);
+	if (st->rows > 1) {
+		printf("\n");
+		top_print("total", &st->total);
+	}
+}
+
+static void
+usage(void)
+{
+	printf("Usage: viatop [options]\n");
+	printf("-d | --device   : PCI slot of the IGP, e.g. 0000:01:00.0.\n");
+	printf("-r | --rate     : Samples per second (default 1000).\n");
+	printf("-i | --interval : Report interval in seconds (default 1).\n");
+	printf("-n | --count    : Stop after this many intervals.\n");
+	printf("-w | --write    : Record samples to a file.\n");
+	printf("-R | --replay   : Analyse a recorded file instead of "
+	       "sampling.\n");
+	printf("-h | --help     : Display this usage message.\n");
+}
+
+int
+main(int argc, char **argv)
+{
+	struct top_device dev;
+	struct top_state st;
+	struct top_event ev;
+	struct timespec next;
+	const char *slot = NULL, *record = NULL, *replay = NULL;
+	unsigned long rate = 1000, count = 0, intervals = 0;
+	double interval = 1.;
+	uint64_t period, boundary;
+	FILE *out = NULL, *in;
+	uint16_t device;
+	int c, rc;
+	static struct option long_options[] = {
+		{ "device", 1, 0, 'd' },
+		{ "rate", 1, 0, 'r' },
+		{ "interval", 1, 0, 'i' },
+		{ "count", 1, 0, 'n' },
+		{ "write", 1, 0, 'w' },
+		{ "replay", 1, 0, 'R' },
+		{ "help", 0, 0, 'h' },
+		{ 0, 0, 0, 0 },
+	};
+
+	while ((c = getopt_long(argc, argv, "d:r:i:n:w:R:h", long_options,
+				NULL)) != -1) {
+		switch (c) {
+		case 'd':
+			slot = optarg;
+			break;
+		case 'r':
+			rate = strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			interval = strtod(optarg, NULL);
+			break;
+		case 'n':
+			count = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			record = optarg;
+			break;
+		case 'R':
+			replay = optarg;
+			break;
+		case 'h':
+		default:
+			usage();
+			exit(1);
+		}
+	}
+
+	if (!rate || interval <= 0.) {
+		usage();
+		exit(1);
+	}
+
+	memset(&st, 0, sizeof(st));
+	st.interval_ns = interval * 1e9;
+
+	if (replay) {
+		in = fopen(replay, "r");
+		if (!in) {
+			perror(replay);
+			exit(1);
+		}
+		if (top_replay_header(in, &device)) {
+			fprintf(stderr, "%s: not a viatop trace\n", replay);
+			exit(1);
+		}
+		st.bits = top_bits_for(device);
+		while (top_replay(in, &ev))
+			top_feed(&st, &ev);
+		fclose(in);
+		top_finish(&st);
+		exit(0);
+	}
+
+	memset(&dev, 0, sizeof(dev));
+	rc = top_find_device(&dev, slot);
+	if (rc) {
+		fprintf(stderr, "No VIA display controller found.\n");
+		exit(1);
+	}
+	rc = top_map_device(&dev);
+	if (rc) {
+		fprintf(stderr, "Cannot map %s/resource1: %s\n", dev.path,
+			strerror(-rc));
+		printf("Need root privileges.\n");
+		exit(1);
+	}
+	st.bits = dev.bits;
+
+	if (record) {
+		out = fopen(record, "w");
+		if (!out) {
+			perror(record);
+			exit(1);
+		}
+		fprintf(out, "%s device=%04x rate=%lu\n", TOP_TRACE_MAGIC,
+			dev.device, rate);
+	}
+
+	signal(SIGINT, top_sigint);
+	signal(SIGTERM, top_sigint);
+
+	period = 1000000000ULL / rate;
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	boundary = top_now_ns();
+
+	if (!top_cpu(&ev)) {
+		top_feed(&st, &ev);
+		if (out)
+			top_record(out, &ev);
+	}
+
+	while (!top_quit) {
+		top_sample(&dev, &ev);
+
+		/* Close the interval with the CPU load before its last sample. */
+		if (ev.ns - boundary >= st.interval_ns) {
+			struct top_event cpu;
+
+			boundary += st.interval_ns;
+			if (!top_cpu(&cpu)) {
+				top_feed(&st, &cpu);
+				if (out)
+					top_record(out, &cpu);
+			}
+			if (count && ++intervals >= count)
+				break;
+		}
+
+		top_feed(&st, &ev);
+		if (out)
+			top_record(out, &ev);
+		fflush(stdout);
+
+		next.tv_nsec += period;
+		while (next.tv_nsec >= 1000000000L) {
+			next.tv_nsec -= 1000000000L;
+			next.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+	}
+
+	top_finish(&st);
+	if (out)
+		fclose(out);
+	munmap((void *)dev.mmio, TOP_MMIO_SIZE);
+	close(dev.fd);
+	exit(0);
+}